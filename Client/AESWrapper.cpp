@@ -1,10 +1,12 @@
 #include "AESWrapper.h"
 
-#include <modes.h>
-#include <aes.h>
-#include <filters.h>
+#include <cryptlib.h>
+#include <osrng.h>
 
 #include <stdexcept>
+#include <vector>
+#include <algorithm>
+#include <cstring>
 #include <immintrin.h>	// _rdrand32_step
 
 
@@ -18,6 +20,7 @@ unsigned char* AESWrapper::GenerateKey(unsigned char* buffer, unsigned int lengt
 AESWrapper::AESWrapper()
 {
 	GenerateKey(_key, DEFAULT_KEYLENGTH);
+	initCiphers();
 }
 
 AESWrapper::AESWrapper(const unsigned char* key, unsigned int length)
@@ -25,12 +28,25 @@ AESWrapper::AESWrapper(const unsigned char* key, unsigned int length)
 	if (length != DEFAULT_KEYLENGTH)
 		throw std::length_error("key length must be 16 bytes");
 	memcpy_s(_key, DEFAULT_KEYLENGTH, key, length);
+	initCiphers();
 }
 
 AESWrapper::~AESWrapper()
 {
 }
 
+void AESWrapper::initCiphers()
+{
+	CryptoPP::byte iv[CryptoPP::AES::BLOCKSIZE] = { 0 };	// for practical use iv should never be a fixed value!
+	_encryption.SetKeyWithIV(_key, DEFAULT_KEYLENGTH, iv);
+	_decryption.SetKeyWithIV(_key, DEFAULT_KEYLENGTH, iv);
+	// GCM expands its key and hash table here; every message then brings its own nonce
+	_gcmEncryption.SetKeyWithIV(_key, DEFAULT_KEYLENGTH, iv, GCM_NONCE_LENGTH);
+	_gcmDecryption.SetKeyWithIV(_key, DEFAULT_KEYLENGTH, iv, GCM_NONCE_LENGTH);
+	_encryptCarryLength = 0;
+	_decryptCarryLength = 0;
+}
+
 const unsigned char* AESWrapper::getKey() const 
 { 
 	return _key; 
@@ -40,13 +56,14 @@ std::string AESWrapper::encrypt(const char* plain, unsigned int length)
 {
 	CryptoPP::byte iv[CryptoPP::AES::BLOCKSIZE] = { 0 };	// for practical use iv should never be a fixed value!
 
-	CryptoPP::AES::Encryption aesEncryption(_key, DEFAULT_KEYLENGTH);
-	CryptoPP::CBC_Mode_ExternalCipher::Encryption cbcEncryption(aesEncryption, iv);
+	// PKCS #7 padding, as StreamTransformationFilter would add
+	const size_t padding = CryptoPP::AES::BLOCKSIZE - length % CryptoPP::AES::BLOCKSIZE;
+	std::string cipher(length + padding, static_cast<char>(padding));
+	memcpy_s(&cipher[0], cipher.size(), plain, length);
 
-	std::string cipher;
-	CryptoPP::StreamTransformationFilter stfEncryptor(cbcEncryption, new CryptoPP::StringSink(cipher));
-	stfEncryptor.Put(reinterpret_cast<const CryptoPP::byte*>(plain), length);
-	stfEncryptor.MessageEnd();
+	CryptoPP::byte* data = reinterpret_cast<CryptoPP::byte*>(&cipher[0]);
+	_encryption.Resynchronize(iv);
+	_encryption.ProcessData(data, data, cipher.size());
 
 	return cipher;
 }
@@ -56,13 +73,232 @@ std::string AESWrapper::decrypt(const char* cipher, unsigned int length)
 {
 	CryptoPP::byte iv[CryptoPP::AES::BLOCKSIZE] = { 0 };	// for practical use iv should never be a fixed value!
 
-	CryptoPP::AES::Decryption aesDecryption(_key, DEFAULT_KEYLENGTH);
-	CryptoPP::CBC_Mode_ExternalCipher::Decryption cbcDecryption(aesDecryption, iv);
+	if (length == 0 || length % CryptoPP::AES::BLOCKSIZE != 0)
+		throw CryptoPP::InvalidCiphertext("AESWrapper: ciphertext length is not a multiple of block size");
+
+	std::string decrypted(length, '\0');
+	CryptoPP::byte* data = reinterpret_cast<CryptoPP::byte*>(&decrypted[0]);
+	_decryption.Resynchronize(iv);
+	_decryption.ProcessData(data, reinterpret_cast<const CryptoPP::byte*>(cipher), length);
 
-	std::string decrypted;
-	CryptoPP::StreamTransformationFilter stfDecryptor(cbcDecryption, new CryptoPP::StringSink(decrypted));
-	stfDecryptor.Put(reinterpret_cast<const CryptoPP::byte*>(cipher), length);
-	stfDecryptor.MessageEnd();
+	const size_t padding = data[length - 1];
+	bool validPadding = padding != 0 && padding <= CryptoPP::AES::BLOCKSIZE;
+	for (size_t i = length - padding; validPadding && i < length; ++i)
+		validPadding = data[i] == padding;
+	if (!validPadding)
+		throw CryptoPP::InvalidCiphertext("AESWrapper: invalid PKCS #7 block padding found");
+	decrypted.resize(length - padding);
 
 	return decrypted;
 }
+
+
+std::string AESWrapper::encryptAuthenticated(const char* plain, unsigned int length)
+{
+	static thread_local CryptoPP::AutoSeededRandomPool rng;
+
+	std::string sealed(GCM_NONCE_LENGTH + length + GCM_TAG_LENGTH, '\0');
+	CryptoPP::byte* nonce = reinterpret_cast<CryptoPP::byte*>(&sealed[0]);
+	CryptoPP::byte* cipher = nonce + GCM_NONCE_LENGTH;
+	rng.GenerateBlock(nonce, GCM_NONCE_LENGTH);
+	_gcmEncryption.EncryptAndAuthenticate(cipher, cipher + length, GCM_TAG_LENGTH, nonce, GCM_NONCE_LENGTH,
+		nullptr, 0, reinterpret_cast<const CryptoPP::byte*>(plain), length);
+	return sealed;
+}
+
+std::string AESWrapper::decryptAuthenticated(const char* cipher, unsigned int length)
+{
+	if (length < GCM_NONCE_LENGTH + GCM_TAG_LENGTH)
+		throw CryptoPP::InvalidCiphertext("AESWrapper: authenticated ciphertext is too short");
+
+	const size_t plainLength = length - GCM_NONCE_LENGTH - GCM_TAG_LENGTH;
+	const CryptoPP::byte* nonce = reinterpret_cast<const CryptoPP::byte*>(cipher);
+	const CryptoPP::byte* data = nonce + GCM_NONCE_LENGTH;
+	std::string plain(plainLength, '\0');
+	if (!_gcmDecryption.DecryptAndVerify(reinterpret_cast<CryptoPP::byte*>(&plain[0]), data + plainLength, GCM_TAG_LENGTH,
+		nonce, GCM_NONCE_LENGTH, nullptr, 0, data, plainLength))
+		throw CryptoPP::InvalidCiphertext("AESWrapper: message authentication failed");
+	return plain;
+}
+
+std::string AESWrapper::encryptAuthenticated(const char* plain, unsigned int length, const unsigned char* nonce,
+	const unsigned char* aad, size_t aadLength)
+{
+	std::string sealed(length + GCM_TAG_LENGTH, '\0');
+	CryptoPP::byte* cipher = reinterpret_cast<CryptoPP::byte*>(&sealed[0]);
+	_gcmEncryption.EncryptAndAuthenticate(cipher, cipher + length, GCM_TAG_LENGTH, nonce, GCM_NONCE_LENGTH,
+		aad, aadLength, reinterpret_cast<const CryptoPP::byte*>(plain), length);
+	return sealed;
+}
+
+std::string AESWrapper::decryptAuthenticated(const char* cipher, unsigned int length, const unsigned char* nonce,
+	const unsigned char* aad, size_t aadLength)
+{
+	if (length < GCM_TAG_LENGTH)
+		throw CryptoPP::InvalidCiphertext("AESWrapper: authenticated ciphertext is too short");
+
+	const size_t plainLength = length - GCM_TAG_LENGTH;
+	const CryptoPP::byte* data = reinterpret_cast<const CryptoPP::byte*>(cipher);
+	std::string plain(plainLength, '\0');
+	if (!_gcmDecryption.DecryptAndVerify(reinterpret_cast<CryptoPP::byte*>(&plain[0]), data + plainLength, GCM_TAG_LENGTH,
+		nonce, GCM_NONCE_LENGTH, aad, aadLength, data, plainLength))
+		throw CryptoPP::InvalidCiphertext("AESWrapper: message authentication failed");
+	return plain;
+}
+
+void AESWrapper::encryptInit()
+{
+	CryptoPP::byte iv[CryptoPP::AES::BLOCKSIZE] = { 0 };	// for practical use iv should never be a fixed value!
+	_encryption.Resynchronize(iv);
+	_encryptCarryLength = 0;
+}
+
+void AESWrapper::encryptUpdate(const char* plain, size_t length, std::string& out)
+{
+	const size_t blockSize = CryptoPP::AES::BLOCKSIZE;
+	const CryptoPP::byte* in = reinterpret_cast<const CryptoPP::byte*>(plain);
+	const size_t whole = (_encryptCarryLength + length) / blockSize * blockSize;
+	if (whole == 0)
+	{
+		memcpy_s(_encryptCarry + _encryptCarryLength, blockSize - _encryptCarryLength, in, length);
+		_encryptCarryLength += length;
+		return;
+	}
+	size_t start = out.size();
+	out.resize(start + whole);
+	CryptoPP::byte* dst = reinterpret_cast<CryptoPP::byte*>(&out[start]);
+
+	// Complete the carried block first, then encrypt straight from the input
+	if (_encryptCarryLength > 0)
+	{
+		size_t fill = blockSize - _encryptCarryLength;
+		memcpy_s(_encryptCarry + _encryptCarryLength, fill, in, fill);
+		_encryption.ProcessData(dst, _encryptCarry, blockSize);
+		dst += blockSize;
+		in += fill;
+		length -= fill;
+	}
+	size_t direct = length / blockSize * blockSize;
+	_encryption.ProcessData(dst, in, direct);
+	_encryptCarryLength = length - direct;
+	memcpy_s(_encryptCarry, blockSize, in + direct, _encryptCarryLength);
+}
+
+void AESWrapper::encryptFinal(std::string& out)
+{
+	const size_t blockSize = CryptoPP::AES::BLOCKSIZE;
+	const size_t padding = blockSize - _encryptCarryLength;	// PKCS #7
+	memset(_encryptCarry + _encryptCarryLength, static_cast<int>(padding), padding);
+
+	size_t start = out.size();
+	out.resize(start + blockSize);
+	_encryption.ProcessData(reinterpret_cast<CryptoPP::byte*>(&out[start]), _encryptCarry, blockSize);
+	_encryptCarryLength = 0;
+}
+
+void AESWrapper::decryptInit()
+{
+	CryptoPP::byte iv[CryptoPP::AES::BLOCKSIZE] = { 0 };	// for practical use iv should never be a fixed value!
+	_decryption.Resynchronize(iv);
+	_decryptCarryLength = 0;
+}
+
+void AESWrapper::decryptUpdate(const char* cipher, size_t length, std::string& out)
+{
+	const size_t blockSize = CryptoPP::AES::BLOCKSIZE;
+	const CryptoPP::byte* in = reinterpret_cast<const CryptoPP::byte*>(cipher);
+
+	// Fill the carried block; it is held back while it may be the last one
+	size_t fill = std::min(blockSize - _decryptCarryLength, length);
+	memcpy_s(_decryptCarry + _decryptCarryLength, blockSize - _decryptCarryLength, in, fill);
+	_decryptCarryLength += fill;
+	in += fill;
+	length -= fill;
+	if (length == 0)
+		return;
+
+	// More input follows, so the carried block and all but the input's last block are not the last one
+	size_t direct = (length - 1) / blockSize * blockSize;
+	size_t start = out.size();
+	out.resize(start + blockSize + direct);
+	CryptoPP::byte* dst = reinterpret_cast<CryptoPP::byte*>(&out[start]);
+	_decryption.ProcessData(dst, _decryptCarry, blockSize);
+	_decryption.ProcessData(dst + blockSize, in, direct);
+	_decryptCarryLength = length - direct;
+	memcpy_s(_decryptCarry, blockSize, in + direct, _decryptCarryLength);
+}
+
+void AESWrapper::decryptFinal(std::string& out)
+{
+	const size_t blockSize = CryptoPP::AES::BLOCKSIZE;
+	if (_decryptCarryLength != blockSize)
+		throw CryptoPP::InvalidCiphertext("AESWrapper: ciphertext length is not a multiple of block size");
+	_decryptCarryLength = 0;
+
+	CryptoPP::byte block[CryptoPP::AES::BLOCKSIZE];
+	_decryption.ProcessData(block, _decryptCarry, blockSize);
+	const size_t padding = block[blockSize - 1];
+	bool validPadding = padding != 0 && padding <= blockSize;
+	for (size_t i = blockSize - padding; validPadding && i < blockSize; ++i)
+		validPadding = block[i] == padding;
+	if (!validPadding)
+		throw CryptoPP::InvalidCiphertext("AESWrapper: invalid PKCS #7 block padding found");
+	out.append(reinterpret_cast<const char*>(block), blockSize - padding);
+}
+
+void AESWrapper::encrypt(std::istream& in, std::ostream& out)
+{
+	std::vector<char> buffer(STREAM_BUFFER_SIZE);
+	std::string cipher;
+	cipher.reserve(STREAM_BUFFER_SIZE + CryptoPP::AES::BLOCKSIZE);
+	encryptInit();
+	while (in.read(buffer.data(), buffer.size()) || in.gcount() > 0)
+	{
+		cipher.clear();
+		encryptUpdate(buffer.data(), static_cast<size_t>(in.gcount()), cipher);
+		out.write(cipher.data(), cipher.size());
+	}
+	if (in.bad())
+		throw std::runtime_error("AESWrapper: reading the input stream failed");
+	cipher.clear();
+	encryptFinal(cipher);
+	if (!out.write(cipher.data(), cipher.size()))
+		throw std::runtime_error("AESWrapper: writing the output stream failed");
+}
+
+void AESWrapper::decrypt(std::istream& in, std::ostream& out)
+{
+	std::vector<char> buffer(STREAM_BUFFER_SIZE);
+	std::string plain;
+	plain.reserve(STREAM_BUFFER_SIZE + CryptoPP::AES::BLOCKSIZE);
+	decryptInit();
+	while (in.read(buffer.data(), buffer.size()) || in.gcount() > 0)
+	{
+		plain.clear();
+		decryptUpdate(buffer.data(), static_cast<size_t>(in.gcount()), plain);
+		out.write(plain.data(), plain.size());
+	}
+	if (in.bad())
+		throw std::runtime_error("AESWrapper: reading the input stream failed");
+	plain.clear();
+	decryptFinal(plain);
+	if (!out.write(plain.data(), plain.size()))
+		throw std::runtime_error("AESWrapper: writing the output stream failed");
+}
+
+void AESWrapper::decrypt(const char* cipher, size_t length, std::ostream& out)
+{
+	std::string plain;
+	plain.reserve(STREAM_BUFFER_SIZE + CryptoPP::AES::BLOCKSIZE);
+	decryptInit();
+	for (size_t offset = 0; offset < length; offset += STREAM_BUFFER_SIZE)
+	{
+		plain.clear();
+		decryptUpdate(cipher + offset, std::min<size_t>(STREAM_BUFFER_SIZE, length - offset), plain);
+		out.write(plain.data(), plain.size());
+	}
+	plain.clear();
+	decryptFinal(plain);
+	if (!out.write(plain.data(), plain.size()))
+		throw std::runtime_error("AESWrapper: writing the output stream failed");
+}
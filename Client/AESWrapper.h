@@ -1,15 +1,35 @@
 #pragma once
 
+#include <modes.h>
+#include <aes.h>
+#include <gcm.h>
+
 #include <string>
+#include <istream>
+#include <ostream>
 
 
 class AESWrapper
 {
 public:
 	static const unsigned int DEFAULT_KEYLENGTH = 16;
+	static const unsigned int STREAM_BUFFER_SIZE = 64 * 1024;	// read size of the stream overloads
+	static const unsigned int GCM_NONCE_LENGTH = 12;
+	static const unsigned int GCM_TAG_LENGTH = 16;
 private:
 	unsigned char _key[DEFAULT_KEYLENGTH];
+	// Keyed once per wrapper (key schedules expanded), only the IV is reset for every message
+	CryptoPP::CBC_Mode<CryptoPP::AES>::Encryption _encryption;
+	CryptoPP::CBC_Mode<CryptoPP::AES>::Decryption _decryption;
+	CryptoPP::GCM<CryptoPP::AES>::Encryption _gcmEncryption;
+	CryptoPP::GCM<CryptoPP::AES>::Decryption _gcmDecryption;
+	// Incremental state: input not yet processed, less than a block (the last whole block too, when decrypting)
+	CryptoPP::byte _encryptCarry[CryptoPP::AES::BLOCKSIZE];
+	size_t _encryptCarryLength;
+	CryptoPP::byte _decryptCarry[CryptoPP::AES::BLOCKSIZE];
+	size_t _decryptCarryLength;
 	AESWrapper(const AESWrapper& aes);
+	void initCiphers();
 public:
 	static unsigned char* GenerateKey(unsigned char* buffer, unsigned int length);
 
@@ -21,4 +41,30 @@ public:
 
 	std::string encrypt(const char* plain, unsigned int length);
 	std::string decrypt(const char* cipher, unsigned int length);
+
+	// AES-GCM: a random nonce per message, encrypted and authenticated in one pass.
+	// Layout: nonce (GCM_NONCE_LENGTH) + ciphertext (same length as the plaintext) + tag (GCM_TAG_LENGTH).
+	// decryptAuthenticated throws CryptoPP::InvalidCiphertext if the message was altered or is too short.
+	std::string encryptAuthenticated(const char* plain, unsigned int length);
+	std::string decryptAuthenticated(const char* cipher, unsigned int length);
+	// AES-GCM with a nonce the caller derives (it must never repeat under the key) and associated data that
+	// is authenticated but not encrypted. Layout: ciphertext (same length as the plaintext) + tag (GCM_TAG_LENGTH).
+	std::string encryptAuthenticated(const char* plain, unsigned int length, const unsigned char* nonce,
+		const unsigned char* aad, size_t aadLength);
+	std::string decryptAuthenticated(const char* cipher, unsigned int length, const unsigned char* nonce,
+		const unsigned char* aad, size_t aadLength);
+
+	// Incremental interface, one message at a time per direction: Init, any number of Updates, Final.
+	// The output is the same as encrypt/decrypt on the whole message; Update and Final append to `out`.
+	void encryptInit();
+	void encryptUpdate(const char* plain, size_t length, std::string& out);
+	void encryptFinal(std::string& out);
+	void decryptInit();
+	void decryptUpdate(const char* cipher, size_t length, std::string& out);
+	void decryptFinal(std::string& out);
+
+	// Whole messages through a STREAM_BUFFER_SIZE buffer, written to `out` as they are processed
+	void encrypt(std::istream& in, std::ostream& out);
+	void decrypt(std::istream& in, std::ostream& out);
+	void decrypt(const char* cipher, size_t length, std::ostream& out);
 };
\ No newline at end of file
@@ -5,18 +5,33 @@
 #include "RSAWrapper.h"
 #include "Base64Wrapper.h"
 #include "AESWrapper.h"
+#include "DeflateWrapper.h"
+#include "FileSender.h"
+#include "PendingMessageParser.h"
+#include "MessageSchema.h"
 #include <ctime>
+#include <cstdio>
 #include <random>
 //
+#define PROBE_RTT_SAMPLES      (10U)
+#define PROBE_THROUGHPUT_BYTES (4U * 1024U * 1024U)   // 4 MB
+//
 static bool                 isRegistered = false;
-static std::vector<uint8_t> emptyPayload;
+//
+// The capabilities this client announces to peers, as sent in the symmetric key exchange
+static std::array<uint8_t, PEER_CAPABILITIES_LEN> encodePeerCapabilities()
+{
+    std::array<uint8_t, PEER_CAPABILITIES_LEN> encoded;
+    ByteWriter(encoded).writeU32(PEER_CAPABILITIES);
+    return encoded;
+}
 //
 //
 Application::Application() : m_appRunning(true)
 {
     m_ui      = std::make_unique<UI>();
     m_config  = std::make_unique<ConfigManager>();
-    m_network = std::make_unique<NetworkManager>();
+    m_connections = std::make_unique<ConnectionPool>(m_config->getConnectionCount());
     //
     m_commandMap =
     {
@@ -39,26 +54,45 @@ void Application::run()
 {
     try
     {
-        auto serverInfo = m_config->getServerInfo();
-        if (!serverInfo)
+        std::vector<NetworkManager::Endpoint> endpoints;
+        for (const std::pair<std::string, uint16_t>& endpoint : m_config->getServerEndpoints())
+            endpoints.push_back({ endpoint.first, endpoint.second });
+        //
+        TransportProfile profile = m_config->getTransportProfile();
+        m_connections->setTransportProfile(profile);
+        // Metrics start before connecting, so connect latencies are recorded too
+        std::optional<std::pair<std::string, std::chrono::seconds>> metricsDump = m_config->getMetricsDump();
+        if (metricsDump)
+            m_connections->startMetricsDump(metricsDump->first, metricsDump->second);
+        std::optional<uint32_t> compressionThreshold = m_config->getCompressionThreshold();
+        ReqHello hello{ CAP_SEGMENTED_CTR | CAP_CHUNKED_FILES, DEFAULT_COMPRESSION_THRESHOLD };
+        if (m_config->getAuthenticatedEncryption())
+            hello.capabilities |= CAP_AEAD_GCM;
+        if (compressionThreshold)
         {
-            m_ui->displayError("Failed to load server info.\n");
-            return;
+            hello.capabilities |= CAP_COMPRESSION_DEFLATE;
+            hello.compressionThreshold = *compressionThreshold;
         }
-        //
-        if (!m_network->ConnectToServer(serverInfo->first, serverInfo->second))
+        m_connections->control().setHello(hello);
+        if (!m_connections->connect(endpoints))
         {
             m_ui->displayError("Failed to connect to the server.\n");
             return;
         }
+        if (profile.autoTune)
+            tuneTransport(profile);
         //
         // Load client info and check if registered
         isRegistered = m_client.loadFromFile(m_config->getConfigFilePath());
         if (isRegistered)
+        {
             m_ui->displayMessage("Client info loaded: " + m_client.getUsername());
+            startSubscription();
+        }
         //
         while (m_appRunning)
         {
+            m_connections->dispatchCompleted(); // Report background uploads and show messages that arrived
             m_ui->displayMenu();
             int choice = m_ui->getUserInput();
             processUserInput(choice);
@@ -99,42 +133,24 @@ void Application::registerUser()
             return;
         }        
         //
-        // Prepare payload: username (255 bytes) and public key (160 bytes).
-        std::vector<uint8_t> payload;
-        payload.insert(payload.end(), username.begin(), username.end());
-        payload.resize(REGISTER_USERNAME_LEN, '\0'); // ensure username size 255
-        payload.insert(payload.end(), publicKeyStr.begin(), publicKeyStr.end());
-        //
-        // Create default client id
+        // Register with the default (all zero) client id
         std::array<uint8_t, CLIENT_ID_LENGTH> emptyClientId = {};
-        emptyClientId.fill(0);
-        //
-        if(!sendClientPacket(CODE_REGISTER_USER, payload, emptyClientId))
+        ReqRegister request{ username, asBytes(publicKeyStr) };
+        MessageReply<ReqRegister> reply = m_connections->control().call(request, emptyClientId);
+        if (!checkReply(reply.status))
             return;
         //
-        receiveAndHandleResponse(RESP_CODE_REGISTER_SUCCCESS, [this, username, privateKeyBase64, publicKeyStr](std::vector<uint8_t> payload) 
-        {
-            if (payload.size() < CLIENT_ID_LENGTH)
-            {
-                m_ui->displayError("Invalid response payload.");
-                return;
-            }
-            //
-            // Extract client ID from response payload
-            std::array<uint8_t, CLIENT_ID_LENGTH> clientId;
-            std::memcpy(clientId.data(), payload.data(), CLIENT_ID_LENGTH);
-            //
-            // Store user info in memory and save to file
-            m_client.setUsername(username);
-            m_client.setClientId(clientId);
-            m_client.setPrivateKey(privateKeyBase64);
-            m_client.setPublicKey(publicKeyStr);
-            //
-            m_client.saveToFile(m_config->getConfigFilePath());
-            //
-            m_ui->displayMessage("Registration successful.");
-            isRegistered = true;
-        });
+        // Store user info in memory and save to file
+        m_client.setUsername(username);
+        m_client.setClientId(reply->clientId);
+        m_client.setPrivateKey(privateKeyBase64);
+        m_client.setPublicKey(publicKeyStr);
+        //
+        m_client.saveToFile(m_config->getConfigFilePath());
+        //
+        m_ui->displayMessage("Registration successful.");
+        isRegistered = true;
+        startSubscription();
     }
     catch (const std::runtime_error& e)
     {
@@ -147,40 +163,15 @@ void Application::requestClientList()
 {
     try
     {
-        if (!sendClientPacket(CODE_REQ_USER_LIST, emptyPayload, m_client.getClientId()))
+        // Only clients registered since the last sync are downloaded
+        MessageReply<ReqClientListSync> reply = m_connections->control().call(
+            ReqClientListSync{ m_clientList.getVersion() }, m_client.getClientId());
+        if (!checkReply(reply.status))
             return;
         //
-        receiveAndHandleResponse(RESP_CODE_GET_CLIENT_LIST, [this](const std::vector<uint8_t>& payload) 
-        {
-            if (payload.empty())
-            {
-                m_ui->displayMessage("No other clients found.");
-                return;
-            }
-            //
-            // Extract client IDs and usernames
-            std::vector<std::pair<std::string, std::array<uint8_t, CLIENT_ID_LENGTH>>> clients;
-            size_t offset = 0;
-            //
-            while (offset + CLIENT_ID_LENGTH + REGISTER_USERNAME_LEN <= payload.size())
-            {
-                // Extract client ID
-                std::array<uint8_t, CLIENT_ID_LENGTH> clientId;
-                std::memcpy(clientId.data(), &payload[offset], CLIENT_ID_LENGTH);
-                offset += CLIENT_ID_LENGTH;
-                //
-                // Extract username (trimming trailing null characters)
-                std::string username(reinterpret_cast<const char*>(&payload[offset]), REGISTER_USERNAME_LEN);
-                username.erase(std::find(username.begin(), username.end(), '\0'), username.end());
-                offset += REGISTER_USERNAME_LEN;
-                //
-                clients.emplace_back(username, clientId);
-            }
-            //
-            // Update local client list and print results
-            m_clientList.updateClientList(clients);
-            m_clientList.printClientList();
-        });
+        // Update local client list in place and print results
+        m_clientList.mergeClientList(reply->clients, reply->version);
+        m_clientList.printClientList();
     }
     catch (const std::runtime_error& e)
     {
@@ -192,37 +183,36 @@ void Application::requestPublicKey()
 {
     try
     {
-        std::string targetUsername = m_ui->getTargetUsername();
+        std::vector<std::string> targetUsernames = m_ui->getTargetUsernames();
         //
-        // Look up the client ID for the target username
-        auto targetClientIdOpt = m_clientList.getClientId(targetUsername);
-        if (!targetClientIdOpt)
+        // Look up the client IDs for the target usernames
+        std::vector<std::array<uint8_t, CLIENT_ID_LENGTH>> targetClientIds;
+        targetClientIds.reserve(targetUsernames.size());
+        for (const std::string& targetUsername : targetUsernames)
         {
-            m_ui->displayError("User " + targetUsername + " not found in the client list");
-            return;
+            auto targetClientIdOpt = m_clientList.getClientId(targetUsername);
+            if (!targetClientIdOpt)
+            {
+                m_ui->displayError("User " + targetUsername + " not found in the client list");
+                return;
+            }
+            if (std::find(targetClientIds.begin(), targetClientIds.end(), *targetClientIdOpt) == targetClientIds.end())
+                targetClientIds.push_back(*targetClientIdOpt);
         }
-        std::array<uint8_t, CLIENT_ID_LENGTH> targetClientId = targetClientIdOpt.value();
         //
-        std::vector<uint8_t> payload(targetClientId.begin(), targetClientId.end());
-        if (!sendClientPacket(CODE_REQ_USER_PUBLIC_KEY, payload, m_client.getClientId()))
+        // All keys arrive in a single response
+        MessageReply<ReqPublicKeys> reply = m_connections->control().call(ReqPublicKeys{ targetClientIds }, m_client.getClientId());
+        if (!checkReply(reply.status))
             return;
         //
-        receiveAndHandleResponse(RESP_CODE_GET_PUBLIC_KEY, [this, targetClientId, targetUsername](const std::vector<uint8_t>& payload) 
-        {
-            if (payload.size() < CLIENT_ID_LENGTH)
-            {
-                m_ui->displayError("Error: Response payload too short to extract public key.");
-                return;
-            }
-            //
-            // Extract public key from payload
-            std::string publicKeyStr(payload.begin() + CLIENT_ID_LENGTH, payload.end());
-            //
-            // Store the retrieved public key
-            m_clientList.storePublicKey(targetClientId, publicKeyStr);
-            //
-            m_ui->displayMessage("Received public key.");
-        });
+        // Store the retrieved public keys
+        m_clientList.storePublicKeys(reply->keys);
+        //
+        if (reply->keys.size() < targetClientIds.size())
+            m_ui->displayError("Received " + std::to_string(reply->keys.size()) + " of " +
+                std::to_string(targetClientIds.size()) + " public keys.");
+        else
+            m_ui->displayMessage(reply->keys.size() == 1 ? "Received public key." : "Received public keys.");
     }
     catch (const std::runtime_error& e)
     {
@@ -231,63 +221,92 @@ void Application::requestPublicKey()
 }
 //
 void Application::requestPendingMessages()
+{
+    // Subscribed clients get new messages pushed, and the menu loop has already shown what arrived
+    if (m_connections->subscribed())
+    {
+        if (m_connections->dispatchCompleted() == 0)
+            m_ui->displayMessage("No new messages.");
+        return;
+    }
+    fetchPendingMessages();
+}
+//
+void Application::fetchPendingMessages()
 {
     try
     {
-        if (!sendClientPacket(CODE_REQ_PENDING_MESSAGES, emptyPayload, m_client.getClientId()))
-            return;
+        NetworkManager& network = m_connections->control();
+        //
+        // Messages are parsed and handled while each page streams in, one at a time
+        uint32_t cursor = 0; // ID of the last handled message, acknowledged by the next request
+        IncomingMessage incoming;
+        PendingMessageParser parser({
+            [this, &incoming](const PendingMessage& header, uint32_t contentSize) { beginIncomingMessage(incoming, header, contentSize); },
+            [this, &incoming](std::span<const uint8_t> piece) { appendIncomingMessage(incoming, piece); },
+            [this, &incoming, &cursor]
+            {
+                endIncomingMessage(incoming);
+                cursor = incoming.header.messageId;
+            } });
         //
-        receiveAndHandleResponse(RESP_CODE_GET_PENDING_MSGS, [this](const std::vector<uint8_t>& payload) 
+        bool hasMore = true;
+        while (hasMore)
         {
-            if (payload.empty())
+            if (!network.sendPacket(encodeRequest(ReqPendingPage{ cursor }, m_client.getClientId())))
             {
-                m_ui->displayMessage("No pending messages.");
+                m_ui->displayError("Failed to send pending messages request.");
                 return;
             }
             //
-            size_t pos = 0;
-            while (pos < payload.size())
+            // The page starts with the has-more flag, followed by the message records
+            bool flagRead = false;
+            ServerPacketHeader header;
+            bool received = network.receivePacketStreaming(header,
+                [&](const ServerPacketHeader& hdr, std::span<const uint8_t> chunk)
+                {
+                    if (hdr.code != RESP_CODE_GET_PENDING_PAGE)
+                        return false;
+                    if (!flagRead && !chunk.empty())
+                    {
+                        parser.setProtocolVersion(hdr.version); // record encoding the server chose
+                        hasMore = chunk[0] != 0;
+                        chunk = chunk.subspan(PAGE_HAS_MORE_LEN);
+                        flagRead = true;
+                    }
+                    return parser.feed(chunk);
+                });
+            //
+            if (!received)
             {
-                if (pos + CLIENT_ID_LENGTH + MSG_ID_LEN + MESSAGE_TYPE_LEN + MESSAGE_CONTENT_LEN > payload.size())
-                    break; // Prevent out-of-bounds read
-                //
-                // Extract sender client ID
-                std::array<uint8_t, CLIENT_ID_LENGTH> senderId;
-                std::memcpy(senderId.data(), payload.data() + pos, CLIENT_ID_LENGTH);
-                pos += CLIENT_ID_LENGTH;
-                //
-                // Extract message ID
-                uint32_t messageId;
-                std::memcpy(&messageId, payload.data() + pos, MSG_ID_LEN);
-                messageId = ntohl(messageId);
-                pos += MSG_ID_LEN;
-                //
-                // Extract message type
-                uint8_t messageType = payload[pos++];
-                //
-                // Extract message content size
-                uint32_t messageSize;
-                std::memcpy(&messageSize, payload.data() + pos, MESSAGE_CONTENT_LEN);
-                messageSize = ntohl(messageSize);
-                pos += MESSAGE_CONTENT_LEN;
-                //
-                // Extract message content
-                std::vector<uint8_t> messageContent(payload.begin() + pos, payload.begin() + pos + messageSize);
-                pos += messageSize;
-                //
-                // Lookup sender username
-                std::optional<std::string> senderUsername = m_clientList.getUsername(senderId);
-                std::string sender = senderUsername ? *senderUsername : toHex(senderId);
-                //
-                // Process message content
-                std::string content = processMessage(senderId, messageType, messageContent);
-                //
-                // Display message
-                m_ui->displayMessage("From " + sender);
-                m_ui->displayMessage("Content:\n" + content);
-                m_ui->displayMessage("---<EOM>---\n");
+                m_ui->displayError("Failed to receive pending messages from server.");
+                return;
             }
-        });
+            if (header.code == RESP_CODE_ERROR)
+            {
+                m_ui->displayMessage("Server responded with an error.");
+                return;
+            }
+            if (header.code != RESP_CODE_GET_PENDING_PAGE || !flagRead)
+            {
+                m_ui->displayError("Unexpected response from server.");
+                return;
+            }
+            if (!parser.atMessageBoundary())
+            {
+                m_ui->displayError("Pending messages response ended in the middle of a message.");
+                return;
+            }
+        }
+        //
+        // Acknowledge the last page so the server can delete it
+        if (cursor != 0)
+        {
+            MessageReply<ReqPendingPage> ack = network.call(ReqPendingPage{ cursor, 0, 0 }, m_client.getClientId());
+            checkReply(ack.status);
+        }
+        else
+            m_ui->displayMessage("No pending messages.");
     }
     catch (const std::runtime_error& e)
     {
@@ -306,40 +325,39 @@ void Application::requestSymmetricKey()
             return;
         }
         //
-        // Get the recipient username and validate client ID
-        std::string recipientUsername = m_ui->getTargetUsername();
-        auto recipientIdOpt = m_clientList.getClientId(recipientUsername);
-        if (!recipientIdOpt)
+        // Get the recipient usernames and validate their client IDs
+        std::vector<std::string> recipientUsernames = m_ui->getTargetUsernames();
+        std::vector<std::pair<std::string, std::array<uint8_t, CLIENT_ID_LENGTH>>> recipients;
+        for (const std::string& recipientUsername : recipientUsernames)
         {
-            m_ui->displayError("User not found in client list.");
-            return;
+            auto recipientIdOpt = m_clientList.getClientId(recipientUsername);
+            if (!recipientIdOpt)
+            {
+                m_ui->displayError("User " + recipientUsername + " not found in client list.");
+                return;
+            }
+            if (std::find_if(recipients.begin(), recipients.end(),
+                [&](const auto& recipient) { return recipient.second == *recipientIdOpt; }) == recipients.end())
+                recipients.emplace_back(recipientUsername, *recipientIdOpt);
         }
         //
-        // Create and send the request packet
-        std::array<uint8_t, CLIENT_ID_LENGTH> recipientId = recipientIdOpt.value();
-        std::vector<uint8_t> payload;
-        payload.insert(payload.end(), recipientId.begin(), recipientId.end()); // target client id
-        payload.push_back(MSG_TYPE_SYMM_KEY_REQ);
-        payload.insert(payload.end(), MESSAGE_CONTENT_LEN, 0); 
-        //
-        if (!sendClientPacket(CODE_SEND_MESSAGE_TO_USER, payload, m_client.getClientId()))
-            return;
-        //
-        receiveAndHandleResponse(RESP_CODE_SEND_MSG_SUCCESS, [this](std::vector<uint8_t> payload)
+        // One request per recipient, pipelined so they all cost about one round trip.
+        // Each announces which message formats this client reads
+        std::array<uint8_t, PEER_CAPABILITIES_LEN> capabilities = encodePeerCapabilities();
+        NetworkManager& network = m_connections->control();
+        for (const auto& recipient : recipients)
         {
-            if (payload.size() < MSG_ID_LEN)
+            ReqSendMessage request{ recipient.second, MSG_TYPE_SYMM_KEY_REQ, capabilities };
+            network.queueRequest(encodeRequest(request, m_client.getClientId()), [this, recipientUsername = recipient.first](ServerPacket& response)
             {
-                m_ui->displayError("Invalid response: missing message ID.");
-                return;
-            }
-            //
-            // Extract and print message ID
-            uint32_t messageId;
-            std::memcpy(&messageId, payload.data() + CLIENT_ID_LENGTH, sizeof(messageId));
-            messageId = ntohl(messageId);  // Convert from network byte order
-            //
-            m_ui->displayMessage("Successfully sent symmetric key request. Message ID: " + std::to_string(messageId));
-        });
+                RespSendMessage sent;
+                if (checkReply(decodePayload<ReqSendMessage>(response.getCode(), response.getVersion(), response.getPayload(), sent)))
+                    m_ui->displayMessage("Successfully sent symmetric key request to " + recipientUsername +
+                        ". Message ID: " + std::to_string(sent.messageId));
+            });
+        }
+        if (!network.flushPipeline())
+            m_ui->displayError("Failed to send the symmetric key requests.");
     }
     catch (const std::runtime_error& e)
     {
@@ -362,14 +380,13 @@ void Application::sendTextMessage()
         }
         std::array<uint8_t, CLIENT_ID_LENGTH> recipientId = recipientIdOpt.value();
         //
-        // Get symmetric key for recipient
-        std::optional<std::vector<uint8_t>> symmetricKeyOpt = m_clientList.getSymmetricKey(recipientId);
-        if (!symmetricKeyOpt)
+        // Get the cipher keyed with the recipient's symmetric key
+        AESWrapper* aes = m_clientList.getCipher(recipientId);
+        if (!aes)
         {
             m_ui->displayError("No symmetric key found for this recipient.");
             return;
         }
-        std::vector<uint8_t> symmetricKey = symmetricKeyOpt.value();
         //
         // Get message from user
         std::string msg = m_ui->getMesssage();
@@ -379,32 +396,38 @@ void Application::sendTextMessage()
             return;
         }
         //
-        // Encrypt message
-        AESWrapper aes(symmetricKey.data(), AESWrapper::DEFAULT_KEYLENGTH);
-        std::string encryptedMsg = aes.encrypt(msg.c_str(), msg.size());
+        // Compress (if worthwhile and the recipient reads it) and encrypt message, authenticated if the recipient reads that
+        uint32_t capabilities = sharedCapabilities(recipientId);
+        std::optional<std::string> compressed = compressContent(asBytes(msg), capabilities);
+        const std::string& plain = compressed ? *compressed : msg;
+        bool authenticated = (capabilities & CAP_AEAD_GCM) != 0;
+        std::string encryptedMsg = authenticated ? aes->encryptAuthenticated(plain.c_str(), plain.size())
+            : aes->encrypt(plain.c_str(), plain.size());
         //
-        // Prepare payload 
-        std::vector<uint8_t> payload = constructMessagePayload(recipientId, MSG_TYPE_TEXT_MSG,
-            std::vector<uint8_t>(encryptedMsg.begin(), encryptedMsg.end()));
+        uint8_t messageType = MSG_TYPE_TEXT_MSG | (compressed ? MSG_FLAG_COMPRESSED : 0) | (authenticated ? MSG_FLAG_AEAD : 0);
+        ReqSendMessage request{ recipientId, messageType, asBytes(encryptedMsg) };
+        if (m_connections->subscribed())
+        {
+            MessageReply<ReqSendMessage> reply = m_connections->control().call(request, m_client.getClientId());
+            if (!checkReply(reply.status))
+                return;
+            m_ui->displayMessage("Message sent successfully. Message ID: " + std::to_string(reply->messageId));
+            return;
+        }
         //
-        if (!sendClientPacket(CODE_SEND_MESSAGE_TO_USER, payload, m_client.getClientId()))
+        // Without a subscription, check for new messages in the same round trip: a page of at most 0 messages
+        // only tells whether any are waiting, so the batch response stays small however large they are
+        BatchReply<ReqSendMessage, ReqPendingPage> reply = m_connections->control().callBatch(m_client.getClientId(),
+            request, ReqPendingPage{ 0, 0, 0 });
+        if (!checkReply(reply.status) || !checkReply(reply.get<0>().status))
             return;
+        m_ui->displayMessage("Message sent successfully. Message ID: " + std::to_string(reply.get<0>()->messageId));
         //
-        receiveAndHandleResponse(RESP_CODE_SEND_MSG_SUCCESS, [this](std::vector<uint8_t> payload)
+        if (reply.get<1>() && reply.get<1>()->hasMore)
         {
-            if (payload.size() < MSG_ID_LEN)
-            {
-                m_ui->displayError("Invalid response: missing message ID.");
-                return;
-            }
-            //
-            // Extract message ID from response
-            uint32_t messageId;
-            std::memcpy(&messageId, payload.data() + CLIENT_ID_LENGTH, sizeof(messageId));
-            messageId = ntohl(messageId);
-            //
-            m_ui->displayMessage("Message sent successfully. Message ID: " + std::to_string(messageId));
-        });
+            m_ui->displayMessage("You have new messages.");
+            fetchPendingMessages();
+        }
     }
     catch (const std::runtime_error& e)
     {
@@ -443,22 +466,22 @@ void Application::sendSymmetricKey()
             // Encrypt symmetric key using recipient's public key
             std::string encryptedSymmetricKey = recipientRSAPublicKey.encrypt(symmetricKey);
             //
-            // Create payload (target client ID + message type + encrypted key)
-            std::vector<uint8_t> payload = constructMessagePayload(recipientId, MSG_TYPE_SYMM_KEY_RESP,
-                std::vector<uint8_t>(encryptedSymmetricKey.begin(), encryptedSymmetricKey.end()));
-            //
-            if (!sendClientPacket(CODE_SEND_MESSAGE_TO_USER, payload, m_client.getClientId()))
+            // Recipients that announced their capabilities get ours back; older ones expect the key alone
+            if (m_clientList.getPeerCapabilities(recipientId))
+            {
+                std::array<uint8_t, PEER_CAPABILITIES_LEN> capabilities = encodePeerCapabilities();
+                encryptedSymmetricKey.append(capabilities.begin(), capabilities.end());
+            }
+            ReqSendMessage request{ recipientId, MSG_TYPE_SYMM_KEY_RESP, asBytes(encryptedSymmetricKey) };
+            MessageReply<ReqSendMessage> reply = m_connections->control().call(request, m_client.getClientId());
+            if (!checkReply(reply.status))
                 return;
             //
-            // Receive response from server
-            receiveAndHandleResponse(RESP_CODE_SEND_MSG_SUCCESS, [this, recipientId, symmetricKey](std::vector<uint8_t> payload)
-            {
-                // Convert key to vector and store in the client list
-                std::vector<uint8_t> symmetricKeyVector(symmetricKey.begin(), symmetricKey.end());
-                m_clientList.storeSymmetricKey(recipientId, symmetricKeyVector);
-                //
-                m_ui->displayMessage("Symmetric key sent successfully.");
-            });
+            // Convert key to vector and store in the client list
+            std::vector<uint8_t> symmetricKeyVector(symmetricKey.begin(), symmetricKey.end());
+            m_clientList.storeSymmetricKey(recipientId, symmetricKeyVector);
+            //
+            m_ui->displayMessage("Symmetric key sent successfully.");
         }
         catch (const std::exception& e)
         {
@@ -487,13 +510,12 @@ void Application::sendFile()
         std::array<uint8_t, CLIENT_ID_LENGTH> recipientId = recipientIdOpt.value();
         //
         // verify symmetric key exists
-        std::optional<std::vector<uint8_t>> symmetricKeyOpt = m_clientList.getSymmetricKey(recipientId);
-        if (!symmetricKeyOpt)
+        AESWrapper* aes = m_clientList.getCipher(recipientId);
+        if (!aes)
         {
             m_ui->displayError("No symmetric key available for recipient. Request or exchange one first.");
             return;
         }
-        std::vector<uint8_t> symmetricKey = symmetricKeyOpt.value();
         //
         // Get file path
         std::string filePath = m_ui->getFilePath();
@@ -511,6 +533,15 @@ void Application::sendFile()
             m_ui->displayError("Error reading file.");
             return;
         }
+        // Files larger than a chunk go as a resumable transfer, unless the recipient can only read them whole
+        uint32_t capabilities = sharedCapabilities(recipientId);
+        if (static_cast<uint64_t>(fileSize) > FILE_CHUNK_SIZE && (capabilities & CAP_CHUNKED_FILES))
+        {
+            file.close();
+            std::vector<uint8_t> symmetricKey(aes->getKey(), aes->getKey() + AESWrapper::DEFAULT_KEYLENGTH);
+            sendFileChunked(filePath, static_cast<uint64_t>(fileSize), recipientId, symmetricKey, capabilities);
+            return;
+        }
         file.seekg(0, std::ios::beg);
         //
         std::vector<uint8_t> fileData(fileSize);
@@ -521,20 +552,24 @@ void Application::sendFile()
         }
         file.close();
         //
-        // Encrypt file with symmetric key
-        AESWrapper aes(symmetricKey.data(), AESWrapper::DEFAULT_KEYLENGTH);
-        std::string encryptedFile = aes.encrypt(reinterpret_cast<const char*>(fileData.data()), fileData.size());
-        //
-        // Construct payload
-        std::vector<uint8_t> payload = constructMessagePayload(recipientId, MSG_TYPE_SEND_FILE,
-            std::vector<uint8_t>(encryptedFile.begin(), encryptedFile.end()));
-        //
-        if (!sendClientPacket(CODE_SEND_MESSAGE_TO_USER, payload, m_client.getClientId()))
-            return;
+        // Compress (if worthwhile) and encrypt file with symmetric key
+        std::optional<std::string> compressed = compressContent(fileData, capabilities);
+        std::span<const uint8_t> plain = compressed ? asBytes(*compressed) : std::span<const uint8_t>(fileData);
+        bool authenticated = (capabilities & CAP_AEAD_GCM) != 0;
+        const char* plainData = reinterpret_cast<const char*>(plain.data());
+        std::string encryptedFile = authenticated ? aes->encryptAuthenticated(plainData, plain.size())
+            : aes->encrypt(plainData, plain.size());
         //
-        receiveAndHandleResponse(RESP_CODE_SEND_MSG_SUCCESS, [&](std::vector<uint8_t> payload) 
+        // Upload on a bulk connection, so commands are not stuck behind a large file
+        uint8_t messageType = MSG_TYPE_SEND_FILE | (compressed ? MSG_FLAG_COMPRESSED : 0) | (authenticated ? MSG_FLAG_AEAD : 0);
+        ClientPacket packet = encodeRequest(ReqSendMessage{ recipientId, messageType, asBytes(encryptedFile) },
+            m_client.getClientId());
+        m_ui->displayMessage("Sending file in the background...");
+        m_connections->submitBulk(std::move(packet), [this, filePath](const std::optional<ServerPacket>& resp)
         {
-            m_ui->displayMessage("File sent successfully.");
+            RespSendMessage response;
+            if (checkReply(decodeResponse<ReqSendMessage>(resp, response)))
+                m_ui->displayMessage("File sent successfully: " + filePath);
         });
     }
     catch (const std::runtime_error& e)
@@ -543,8 +578,33 @@ void Application::sendFile()
     }
 }
 //
+void Application::sendFileChunked(const std::string& filePath, uint64_t fileSize,
+    const std::array<uint8_t, CLIENT_ID_LENGTH>& recipientId, const std::vector<uint8_t>& symmetricKey, uint32_t capabilities)
+{
+    // Upload on a bulk connection in windows of chunks sealed in parallel, resuming after reconnects
+    // Encrypt with the best cipher both the server and the recipient handle the flag of: AES-GCM, AES-CTR, else AES-CBC
+    FileSender::ChunkCipher chunkCipher = (capabilities & CAP_AEAD_GCM) ? FileSender::ChunkCipher::Gcm
+        : (capabilities & CAP_SEGMENTED_CTR) ? FileSender::ChunkCipher::SegmentedCtr : FileSender::ChunkCipher::Cbc;
+    std::shared_ptr<FileSender> sender = std::make_shared<FileSender>(filePath, fileSize, recipientId,
+        m_client.getClientId(), symmetricKey, compressionThreshold(capabilities), segmentedCipher(), chunkCipher);
+    m_ui->displayMessage("Sending file in " + std::to_string((fileSize + FILE_CHUNK_SIZE - 1) / FILE_CHUNK_SIZE) +
+        " chunks in the background...");
+    m_connections->submitBulkTask([sender](NetworkManager& network) { return sender->run(network); },
+        [this, filePath](const std::optional<ServerPacket>& lastAck)
+    {
+        if (lastAck)
+            m_ui->displayMessage("File sent successfully: " + filePath);
+        else
+            m_ui->displayError("Failed to send file: " + filePath);
+    });
+}
+//
 void Application::exitProgram()
 {
+    size_t pendingUploads = m_connections->pendingBulk();
+    if (pendingUploads > 0)
+        m_ui->displayMessage("Waiting for " + std::to_string(pendingUploads) + " file upload(s) to finish...");
+    m_connections->waitForBulk();
     m_ui->displayMessage("Exiting application...\n");
     m_appRunning = false;
 }
@@ -565,15 +625,35 @@ void Application::processUserInput(int choice)
         m_ui->displayError("Invalid option. Try again.\n");
 }
 
+std::string Application::handleSymmetricKeyRequest(
+    const std::array<uint8_t, CLIENT_ID_LENGTH>& senderId,
+    std::span<const uint8_t> content)
+{
+    // Newer clients announce their capabilities with the request; an empty request comes from an older client
+    std::optional<uint32_t> capabilities;
+    if (content.size() == PEER_CAPABILITIES_LEN)
+        capabilities = ByteReader(content).readU32();
+    m_clientList.setPeerCapabilities(senderId, capabilities);
+    return "Request for symmetric key";
+}
+
 std::string Application::handleSymmetricKeyResponse(
     const std::array<uint8_t, CLIENT_ID_LENGTH>& senderId,
-    const std::vector<uint8_t>& encryptedKey)
+    std::span<const uint8_t> encryptedKey)
 {
     try
     {
         if (encryptedKey.empty())
             return "Received empty symmetric key.";
         //
+        // Newer senders follow the key with their capabilities (only if our request announced ours)
+        std::optional<uint32_t> capabilities;
+        if (encryptedKey.size() == ENCRYPTED_SYMM_KEY_LEN + PEER_CAPABILITIES_LEN)
+        {
+            ByteReader reader(encryptedKey.subspan(ENCRYPTED_SYMM_KEY_LEN));
+            capabilities = reader.readU32();
+            encryptedKey = encryptedKey.first(ENCRYPTED_SYMM_KEY_LEN);
+        }
         std::string encryptedSymmetricKey(encryptedKey.begin(), encryptedKey.end());
         //
         std::string decryptedKey = m_client.decryptWithPrivateKey(encryptedSymmetricKey);
@@ -585,6 +665,7 @@ std::string Application::handleSymmetricKeyResponse(
         // Convert key to vector and store it
         std::vector<uint8_t> symmetricKeyVector(decryptedKey.begin(), decryptedKey.end());
         m_clientList.storeSymmetricKey(senderId, symmetricKeyVector);
+        m_clientList.setPeerCapabilities(senderId, capabilities);
         //
         return "Symmetric key received.";
     }
@@ -595,44 +676,43 @@ std::string Application::handleSymmetricKeyResponse(
 }
 
 std::string Application::handleIncomingFile(const std::array<uint8_t, CLIENT_ID_LENGTH>& senderId,
-    const std::vector<uint8_t>& encryptedFile)
+    std::span<const uint8_t> encryptedFile, bool compressed, bool authenticated)
 {
     try
     {
-        std::optional<std::vector<uint8_t>> symmetricKeyOpt = m_clientList.getSymmetricKey(senderId);
-        if (!symmetricKeyOpt)
+        AESWrapper* aes = m_clientList.getCipher(senderId);
+        if (!aes)
             return "No symmetric key available for this sender.";
         //
-        std::vector<uint8_t> symmetricKey = symmetricKeyOpt.value();
-        //
-        AESWrapper aes(symmetricKey.data(), AESWrapper::DEFAULT_KEYLENGTH);
-        std::string decryptedFile = aes.decrypt(reinterpret_cast<const char*>(encryptedFile.data()), encryptedFile.size());
-        //
-        // Generate unique filename - recieved_<senderId>_<timestamp>
-        std::stringstream filenameStream;
-        filenameStream << toHex(senderId) << "_";
-        //
-        // Generate random 4-digit sequence
-        std::random_device rd;
-        std::mt19937 gen(rd());
-        std::uniform_int_distribution<> dis(1000, 9999);
-        int randomSuffix = dis(gen);
-        filenameStream << std::to_string(randomSuffix) + "_";
-        // Get current timestamp
-        std::time_t now = std::time(nullptr);
-        std::tm localTime;
-        localtime_s(&localTime, &now);
-        filenameStream << std::put_time(&localTime, "%Y%m%d_%H%M%S");
-        //
-        std::string filePath = getTempDirectory() + filenameStream.str();
+        std::string filePath = incomingFilePath(senderId);
         //
         // Save the decrypted content to the file
         std::ofstream outFile(filePath, std::ios::binary);
         if (!outFile)
             return "Failed to save decrypted file.";
         //
-        outFile.write(decryptedFile.data(), decryptedFile.size());
-        outFile.close();
+        try
+        {
+            const char* cipher = reinterpret_cast<const char*>(encryptedFile.data());
+            if (!compressed && !authenticated)
+                aes->decrypt(cipher, encryptedFile.size(), outFile); // straight to disk, no plaintext copy in memory
+            else
+            {
+                // Authenticated content is verified as a whole before any of it is written
+                std::string decryptedFile = authenticated ? aes->decryptAuthenticated(cipher, encryptedFile.size())
+                    : aes->decrypt(cipher, encryptedFile.size());
+                if (compressed)
+                    decryptedFile = DeflateWrapper::decompress(asBytes(decryptedFile), MAX_DECOMPRESSED_SIZE);
+                outFile.write(decryptedFile.data(), decryptedFile.size());
+            }
+            outFile.close();
+        }
+        catch (...)
+        {
+            outFile.close();
+            std::remove(filePath.c_str());
+            throw;
+        }
         //
         return filePath;
     }
@@ -642,88 +722,355 @@ std::string Application::handleIncomingFile(const std::array<uint8_t, CLIENT_ID_
     }
 }
 //
-std::string Application::handleTextMessage(
-    const std::array<uint8_t, CLIENT_ID_LENGTH>& senderId,
-    const std::vector<uint8_t>& encryptedMessage)
+std::string Application::handleFileChunk(const std::array<uint8_t, CLIENT_ID_LENGTH>& senderId,
+    std::span<const uint8_t> chunkMessage, bool compressed, bool segmented, bool authenticated)
 {
-    // Retrieve the symmetric key for the sender
-    std::optional<std::vector<uint8_t>> symmetricKeyOpt = m_clientList.getSymmetricKey(senderId);
-    if (!symmetricKeyOpt)
-        return "Can't decrypt message (No symmetric key)";
-    //
     try
     {
-        AESWrapper aes(symmetricKeyOpt->data(), AESWrapper::DEFAULT_KEYLENGTH);
+        AESWrapper* aes = m_clientList.getCipher(senderId);
+        if (!aes)
+            return "No symmetric key available for this sender.";
+        //
+        ByteReader reader(chunkMessage);
+        FileChunkHeader header = FileChunkHeader::decode(reader);
+        std::span<const uint8_t> encryptedChunk = reader.readRest();
+        const char* cipher = reinterpret_cast<const char*>(encryptedChunk.data());
+        //
+        // Chunks arrive in order (the server enforces it): the first one creates the partial file, the others extend it
+        std::stringstream nameStream;
+        nameStream << toHex(senderId) << "_" << std::hex << std::setw(16) << std::setfill('0') << header.fileId;
+        std::string filePath = getTempDirectory() + nameStream.str();
+        std::string partPath = filePath + ".part";
         //
-        return aes.decrypt(reinterpret_cast<const char*>(encryptedMessage.data()), encryptedMessage.size());
+        // A chunk delivered again after its file was completed and renamed (the page acknowledgement got lost)
+        // finds no partial file but the whole one: a duplicate, not a broken transfer
+        std::ifstream completeFile(filePath, std::ios::binary | std::ios::ate);
+        if (header.offset != 0 && !std::ifstream(partPath) && completeFile &&
+            static_cast<uint64_t>(completeFile.tellg()) == header.totalSize)
+            return "File chunk already received: " + filePath;
+        completeFile.close();
+        std::ios::openmode mode = std::ios::binary | std::ios::out | (header.offset == 0 ? std::ios::trunc : std::ios::in);
+        std::fstream outFile(partPath, mode);
+        if (!outFile)
+            return "Failed to open partial file " + partPath;
+        outFile.seekp(static_cast<std::streamoff>(header.offset));
+        if (authenticated)
+        {
+            // Verified against the header as received before any of it is written
+            std::string chunk = aes->decryptAuthenticated(cipher, static_cast<unsigned int>(encryptedChunk.size()),
+                header.gcmNonce().data(), chunkMessage.data(), FILE_CHUNK_HEADER_LEN);
+            if (compressed)
+                chunk = DeflateWrapper::decompress(asBytes(chunk), header.length);
+            outFile.write(chunk.data(), chunk.size());
+        }
+        else if (segmented)
+        {
+            std::vector<uint8_t> chunk(encryptedChunk.begin(), encryptedChunk.end());
+            segmentedCipher().apply(aes->getKey(), header.fileId, header.offset, chunk);
+            if (compressed)
+            {
+                std::string inflated = DeflateWrapper::decompress(chunk, header.length);
+                outFile.write(inflated.data(), inflated.size());
+            }
+            else
+                outFile.write(reinterpret_cast<const char*>(chunk.data()), chunk.size());
+        }
+        else if (compressed)
+        {
+            std::string chunk = DeflateWrapper::decompress(asBytes(aes->decrypt(cipher, encryptedChunk.size())), header.length);
+            outFile.write(chunk.data(), chunk.size());
+        }
+        else
+            aes->decrypt(cipher, encryptedChunk.size(), outFile); // straight to disk, no plaintext copy in memory
+        std::streamoff written = outFile.tellp() - static_cast<std::streamoff>(header.offset);
+        outFile.close();
+        if (!outFile)
+            return "Failed to write partial file " + partPath;
+        if (written != static_cast<std::streamoff>(header.length))
+            return "File chunk size mismatch.";
+        //
+        uint64_t received = header.offset + header.length;
+        if (received < header.totalSize)
+            return "File chunk saved to " + partPath + " (" + std::to_string(received) + " of " +
+                std::to_string(header.totalSize) + " bytes)";
+        //
+        std::remove(filePath.c_str());
+        if (std::rename(partPath.c_str(), filePath.c_str()) != 0)
+            return "File complete, but renaming " + partPath + " failed.";
+        return filePath;
     }
-    catch (...)
+    catch (const std::exception& e)
     {
-        return "Can't decrypt message (Decryption failed)";
+        return "Error processing file chunk: " + std::string(e.what());
     }
 }
 //
-void Application::receiveAndHandleResponse(uint16_t expectedCode, std::function<void(std::vector<uint8_t>)> handler)
+std::string Application::handleTextMessage(
+    const std::array<uint8_t, CLIENT_ID_LENGTH>& senderId,
+    std::span<const uint8_t> encryptedMessage, bool compressed, bool authenticated)
 {
-    ServerPacket resp;
-    if (!m_network->receivePacket(resp))
-    {
-        m_ui->displayError("No response from server.");
-        return;
-    }
-    //
-    uint16_t receivedCode = resp.getCode();
+    // Retrieve the cipher keyed with the sender's symmetric key
+    AESWrapper* aes = m_clientList.getCipher(senderId);
+    if (!aes)
+        return "Can't decrypt message (No symmetric key)";
     //
-    if (receivedCode == RESP_CODE_ERROR)
+    try
     {
-        m_ui->displayMessage("Server responded with an error.");
-        return;
+        const char* cipher = reinterpret_cast<const char*>(encryptedMessage.data());
+        std::string text = authenticated ? aes->decryptAuthenticated(cipher, encryptedMessage.size())
+            : aes->decrypt(cipher, encryptedMessage.size());
+        if (compressed)
+            text = DeflateWrapper::decompress(asBytes(text), MAX_DECOMPRESSED_SIZE);
+        return text;
     }
-    //
-    if (receivedCode != expectedCode)
+    catch (...)
     {
-        m_ui->displayError("Unexpected response code from server.");
-        return;
+        return "Can't decrypt message (Decryption failed)";
     }
-    //
-    handler(resp.getPayload());  // Call handler with the response payload
 }
 //
-bool Application::sendClientPacket(uint16_t code, const std::vector<uint8_t>& payload, const std::array<uint8_t, CLIENT_ID_LENGTH>& senderId)
+bool Application::checkReply(CallStatus status)
 {
-    ClientPacket packet(code, payload, senderId);
-    //
-    if (!m_network->sendPacket(packet))
+    switch (status)
     {
-        m_ui->displayError("Failed to send packet with code: " + std::to_string(code));
-        return false;
+    case CallStatus::Ok:
+        return true;
+    case CallStatus::SendFailed:
+        m_ui->displayError("Failed to send request.");
+        break;
+    case CallStatus::NoResponse:
+        m_ui->displayError("No response from server.");
+        break;
+    case CallStatus::ServerError:
+        m_ui->displayMessage("Server responded with an error.");
+        break;
+    case CallStatus::UnexpectedCode:
+        m_ui->displayError("Unexpected response code from server.");
+        break;
+    case CallStatus::Malformed:
+        m_ui->displayError("Invalid response payload.");
+        break;
     }
-    return true;
+    return false;
 }
 //
 std::string Application::processMessage(
     const std::array<uint8_t, CLIENT_ID_LENGTH>& senderId,
     uint8_t messageType,
-    const std::vector<uint8_t>& messageContent)
+    std::span<const uint8_t> messageContent)
     {
-    switch (messageType)
+    bool compressed = (messageType & MSG_FLAG_COMPRESSED) != 0;
+    bool chunked = (messageType & MSG_FLAG_CHUNKED) != 0;
+    bool segmented = (messageType & MSG_FLAG_SEGMENTED) != 0;
+    bool authenticated = (messageType & MSG_FLAG_AEAD) != 0;
+    switch (messageType & MSG_TYPE_MASK)
     {
     case MSG_TYPE_SYMM_KEY_REQ:
-        return "Request for symmetric key";
+        return handleSymmetricKeyRequest(senderId, messageContent);
     //
     case MSG_TYPE_SYMM_KEY_RESP:
         return handleSymmetricKeyResponse(senderId, messageContent);
     //
     case MSG_TYPE_TEXT_MSG:
-        return handleTextMessage(senderId, messageContent);
+        return handleTextMessage(senderId, messageContent, compressed, authenticated);
         //
     case MSG_TYPE_SEND_FILE:
-        return handleIncomingFile(senderId, messageContent);
+        if (chunked)
+            return handleFileChunk(senderId, messageContent, compressed, segmented, authenticated);
+        return handleIncomingFile(senderId, messageContent, compressed, authenticated);
     //
     default:
         return "Unknown message type";
     }
 }
+//
+// Measures the link to the server and sizes every connection's socket buffers to match
+void Application::tuneTransport(TransportProfile profile)
+{
+    std::optional<TransportProbeResult> probe = m_connections->control().probeTransport(PROBE_RTT_SAMPLES, PROBE_THROUGHPUT_BYTES);
+    if (!probe)
+    {
+        m_ui->displayError("Transport probe failed, keeping the configured socket options.");
+        return;
+    }
+    //
+    std::ostringstream report;
+    probe->print(report);
+    m_ui->displayMessage(report.str());
+    //
+    profile.sendBufferSize = probe->suggestedBufferSize;
+    profile.receiveBufferSize = probe->suggestedBufferSize;
+    m_connections->setTransportProfile(profile);
+}
+//
+void Application::displayPendingMessage(const PendingMessage& msg)
+{
+    displayReceived(msg.senderId, processMessage(msg.senderId, msg.messageType, msg.content));
+}
+//
+void Application::displayReceived(const std::array<uint8_t, CLIENT_ID_LENGTH>& senderId, const std::string& content)
+{
+    // Lookup sender username
+    std::optional<std::string> senderUsername = m_clientList.getUsername(senderId);
+    std::string sender = senderUsername ? *senderUsername : toHex(senderId);
+    //
+    // Display message
+    m_ui->displayMessage("From " + sender);
+    m_ui->displayMessage("Content:\n" + content);
+    m_ui->displayMessage("---<EOM>---\n");
+}
+//
+void Application::beginIncomingMessage(IncomingMessage& incoming, const PendingMessage& header, uint32_t contentSize)
+{
+    incoming.header = header;
+    incoming.content.clear();
+    incoming.failure.clear();
+    incoming.fileCipher = nullptr;
+    //
+    // A file in one plain CBC message may be of any size, so it is decrypted to disk piece by piece
+    AESWrapper* aes = m_clientList.getCipher(header.senderId);
+    if (header.messageType == MSG_TYPE_SEND_FILE && aes)
+    {
+        incoming.filePath = incomingFilePath(header.senderId);
+        incoming.file.open(incoming.filePath, std::ios::binary | std::ios::trunc);
+        if (!incoming.file)
+        {
+            incoming.failure = "Failed to save decrypted file.";
+            return;
+        }
+        incoming.fileCipher = aes;
+        aes->decryptInit();
+        return;
+    }
+    // Everything else is processed as a whole
+    if (contentSize > MAX_BUFFERED_MESSAGE_SIZE)
+        incoming.failure = "Message of " + std::to_string(contentSize) + " bytes is too large, skipped.";
+    else
+        incoming.content.reserve(contentSize);
+}
+//
+void Application::appendIncomingMessage(IncomingMessage& incoming, std::span<const uint8_t> piece)
+{
+    if (!incoming.failure.empty())
+        return;
+    if (!incoming.fileCipher)
+    {
+        incoming.content.insert(incoming.content.end(), piece.begin(), piece.end());
+        return;
+    }
+    try
+    {
+        incoming.plain.clear();
+        incoming.fileCipher->decryptUpdate(reinterpret_cast<const char*>(piece.data()), piece.size(), incoming.plain);
+        if (!incoming.file.write(incoming.plain.data(), incoming.plain.size()))
+            throw std::runtime_error("writing " + incoming.filePath + " failed");
+    }
+    catch (const std::exception& e)
+    {
+        incoming.failure = "Error processing file: " + std::string(e.what());
+        incoming.file.close();
+        std::remove(incoming.filePath.c_str());
+    }
+}
+//
+void Application::endIncomingMessage(IncomingMessage& incoming)
+{
+    const PendingMessage& header = incoming.header;
+    if (!incoming.failure.empty())
+    {
+        displayReceived(header.senderId, incoming.failure);
+        return;
+    }
+    if (!incoming.fileCipher)
+    {
+        PendingMessage msg = header;
+        msg.content = incoming.content;
+        displayPendingMessage(msg);
+        return;
+    }
+    try
+    {
+        incoming.plain.clear();
+        incoming.fileCipher->decryptFinal(incoming.plain);
+        incoming.file.write(incoming.plain.data(), incoming.plain.size());
+        incoming.file.close();
+        if (!incoming.file)
+            throw std::runtime_error("writing " + incoming.filePath + " failed");
+        displayReceived(header.senderId, incoming.filePath);
+    }
+    catch (const std::exception& e)
+    {
+        incoming.file.close();
+        std::remove(incoming.filePath.c_str());
+        displayReceived(header.senderId, "Error processing file: " + std::string(e.what()));
+    }
+}
+//
+std::string Application::incomingFilePath(const std::array<uint8_t, CLIENT_ID_LENGTH>& senderId)
+{
+    // Generate unique filename - recieved_<senderId>_<timestamp>
+    std::stringstream filenameStream;
+    filenameStream << toHex(senderId) << "_";
+    //
+    // Generate random 4-digit sequence
+    std::random_device rd;
+    std::mt19937 gen(rd());
+    std::uniform_int_distribution<> dis(1000, 9999);
+    int randomSuffix = dis(gen);
+    filenameStream << std::to_string(randomSuffix) + "_";
+    // Get current timestamp
+    std::time_t now = std::time(nullptr);
+    std::tm localTime;
+    localtime_s(&localTime, &now);
+    filenameStream << std::put_time(&localTime, "%Y%m%d_%H%M%S");
+    //
+    return getTempDirectory() + filenameStream.str();
+}
+//
+void Application::startSubscription()
+{
+    if (!m_config->getPushDelivery())
+        return;
+    // What the subscription can't buffer is streamed in page by page, as without one
+    m_connections->subscribe(m_client.getClientId(), [this](const RespPendingPage& page)
+    {
+        for (const PendingMessage& msg : page.messages)
+            displayPendingMessage(msg);
+    }, [this]() { fetchPendingMessages(); });
+}
+//
+std::optional<uint32_t> Application::compressionThreshold(uint32_t capabilities)
+{
+    if (!(capabilities & CAP_COMPRESSION_DEFLATE))
+        return std::nullopt;
+    return m_connections->control().negotiated().compressionThreshold;
+}
+//
+uint32_t Application::sharedCapabilities(const std::array<uint8_t, CLIENT_ID_LENGTH>& peerId)
+{
+    // Bulk connections are opened to the control connection's server, so its hello covers file uploads too
+    uint32_t server = m_connections->control().negotiated().capabilities;
+    return server & m_clientList.getPeerCapabilities(peerId).value_or(0);
+}
+//
+SegmentedCipher& Application::segmentedCipher()
+{
+    if (!m_segmentedCipher)
+        m_segmentedCipher = std::make_unique<SegmentedCipher>();
+    return *m_segmentedCipher;
+}
+//
+std::optional<std::string> Application::compressContent(std::span<const uint8_t> content, uint32_t capabilities)
+{
+    std::optional<uint32_t> threshold = compressionThreshold(capabilities);
+    if (!threshold || content.size() < *threshold)
+        return std::nullopt;
+    //
+    std::string compressed = DeflateWrapper::compress(content);
+    if (compressed.size() >= content.size())
+        return std::nullopt; // already compressed or random data
+    return compressed;
+}
 // 
 // Helper function that returns the temporary file path
 std::string Application::getTempDirectory()
@@ -747,21 +1094,3 @@ std::string Application::getTempDirectory()
     return "/tmp";
 #endif // _WIN32
 }
-//
-std::vector<uint8_t> Application::constructMessagePayload(
-    const std::array<uint8_t, CLIENT_ID_LENGTH>& recipientId,
-    uint8_t messageType,
-    const std::vector<uint8_t>& messageContent)
-{
-    std::vector<uint8_t> payload;
-    payload.insert(payload.end(), recipientId.begin(), recipientId.end());
-    payload.push_back(messageType);
-    //
-    uint32_t contentSize = htonl(messageContent.size());
-    payload.insert(payload.end(), reinterpret_cast<uint8_t*>(&contentSize),
-        reinterpret_cast<uint8_t*>(&contentSize) + sizeof(contentSize));
-    //
-    payload.insert(payload.end(), messageContent.begin(), messageContent.end());
-    //
-    return payload;
-}
\ No newline at end of file
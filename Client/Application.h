@@ -10,18 +10,24 @@
 #pragma once
 #include <unordered_map>
 #include <functional>
+#include <span>
+#include <fstream>
+#include <cstdio>
 #include "UI.h"
 #include "ConfigManager.h"
-#include "NetworkManager.h"
+#include "ConnectionPool.h"
 #include "ClientInfo.h"
 #include "ClientListManager.h"
+#include "SegmentedCipher.h"
+#include "PendingMessageParser.h"
 //
 class Application
 {
 private:
     std::unique_ptr<UI>                            m_ui;
     std::unique_ptr<ConfigManager>                 m_config;
-    std::unique_ptr<NetworkManager>                m_network;
+    std::unique_ptr<SegmentedCipher>               m_segmentedCipher; //< Created on first use; outlives the bulk uploads using it
+    std::unique_ptr<ConnectionPool>                m_connections;
     //
     bool                                           m_appRunning;
     ClientInfo                                     m_client;
@@ -29,6 +35,31 @@ private:
     //
     std::unordered_map<uint16_t, std::function<void()>> m_commandMap;
     //
+    /**
+     * @brief A pending message while its content streams in (see requestPendingMessages). The content is buffered,
+     * up to MAX_BUFFERED_MESSAGE_SIZE, except for files sent as one plain AES-CBC message, which are decrypted
+     * to disk as they arrive however large they are.
+     */
+    struct IncomingMessage
+    {
+        PendingMessage       header;
+        std::vector<uint8_t> content; //< Buffered content
+        std::string          failure; //< Set once the content can't be processed; the rest of it is skipped
+        AESWrapper*          fileCipher = nullptr; //< Set while a file streams to `filePath`
+        std::string          filePath;
+        std::ofstream        file;
+        std::string          plain; //< Decrypted piece, reused
+        //
+        ~IncomingMessage() // a file still open was cut off mid-message
+        {
+            if (file.is_open())
+            {
+                file.close();
+                std::remove(filePath.c_str());
+            }
+        }
+    };
+    //
     // === Command handling functions ===
     //
     /**
@@ -48,11 +79,16 @@ private:
      */
     void requestPendingMessages();
     /**
-     * @brief Sends a request for a symmetric key to another client.
+     * @brief Fetches and displays the pending messages page by page, streaming each page in, then acknowledges them.
+     */
+    void fetchPendingMessages();
+    /**
+     * @brief Sends a request for a symmetric key to one or more other clients, pipelined on the control connection.
      */
     void requestSymmetricKey();
     /**
-     * @brief Sends an encrypted text message to a selected recipient.
+     * @brief Sends an encrypted text message to a selected recipient. Without a subscription, the same batch
+     * checks for pending messages, which are then fetched and displayed.
      */
     void sendTextMessage();
     /**
@@ -71,19 +107,11 @@ private:
     // === Requests and Responses
     //
     /**
-     * @brief Receives and verifies a server response, then passes the payload to a handler.
-     * @param expectedCode The expected response code from the server.
-     * @param handler Function to process the response payload if valid.
+     * @brief Reports a failed typed request to the user.
+     * @param status Outcome of the request.
+     * @return True if the request succeeded, false otherwise.
      */
-    void receiveAndHandleResponse(uint16_t expectedCode, std::function<void(std::vector<uint8_t>)> handler);
-    /**
-     * @brief Constructs and sends a packet to the server.
-     * @param code The request code.
-     * @param payload The request payload data.
-     * @param senderId The client ID of the sender.
-     * @return True if the packet was sent successfully, false otherwise.
-     */
-    bool sendClientPacket(uint16_t code, const std::vector<uint8_t>& payload, const std::array<uint8_t, CLIENT_ID_LENGTH>& senderId);
+    bool checkReply(CallStatus status);
     /**
      * @brief Handles user input by executing the corresponding command.
      * @param choice The user-selected menu option.
@@ -99,46 +127,121 @@ private:
     std::string processMessage(
         const std::array<uint8_t, CLIENT_ID_LENGTH>& senderId,
         uint8_t messageType,
-        const std::vector<uint8_t>& messageContent);
+        std::span<const uint8_t> messageContent);
     //
     /**
-     * @brief Handles incoming encrypted symmetric key and stores it.
+     * @brief Records the capabilities announced with a symmetric key request.
+     * @param senderId ID of the sender.
+     * @param content The request content: the sender's capabilities, or empty from an older client.
+     * @return Status message of the result.
+     */
+    std::string handleSymmetricKeyRequest(const std::array<uint8_t, CLIENT_ID_LENGTH>& senderId,
+        std::span<const uint8_t> content);
+    /**
+     * @brief Handles incoming encrypted symmetric key and stores it, with the sender's capabilities if it sent them.
      * @param senderId ID of the sender.
      * @param encryptedKey The encrypted symmetric key data.
      * @return Status message of the result.
      */
     std::string handleSymmetricKeyResponse(const std::array<uint8_t, CLIENT_ID_LENGTH>& senderId,
-        const std::vector<uint8_t>& encryptedKey);
+        std::span<const uint8_t> encryptedKey);
     /**
      * @brief Decrypts and saves a received file.
      * @param senderId ID of the sender.
      * @param encryptedFile The encrypted file content.
+     * @param compressed The file was deflated before encryption.
+     * @param authenticated The file was encrypted with AES-GCM rather than AES-CBC.
      * @return Path to the saved file or error string.
      */
     std::string handleIncomingFile(const std::array<uint8_t, CLIENT_ID_LENGTH>& senderId,
-        const std::vector<uint8_t>& encryptedFile);
+        std::span<const uint8_t> encryptedFile, bool compressed, bool authenticated);
+    /**
+     * @brief Decrypts one chunk of a chunked file transfer and writes it into the partial file at its offset.
+     * The partial file is renamed to its final name once the last chunk is written.
+     * @param senderId ID of the sender.
+     * @param chunkMessage The chunk header followed by the encrypted chunk.
+     * @param compressed The chunk was deflated before encryption.
+     * @param segmented The chunk was encrypted with the SegmentedCipher (AES-CTR) rather than AES-CBC.
+     * @param authenticated The chunk was sealed with AES-GCM, its header as associated data (see FileChunkHeader::gcmNonce).
+     * @return Progress, the path of the completed file, or an error string.
+     */
+    std::string handleFileChunk(const std::array<uint8_t, CLIENT_ID_LENGTH>& senderId,
+        std::span<const uint8_t> chunkMessage, bool compressed, bool segmented, bool authenticated);
     /**
      * @brief Decrypts and returns a received text message.
      * @param senderId ID of the sender.
      * @param encryptedMessage Encrypted message data.
+     * @param compressed The text was deflated before encryption.
+     * @param authenticated The text was encrypted with AES-GCM rather than AES-CBC.
      * @return Decrypted text or error string.
      */
     std::string handleTextMessage(
         const std::array<uint8_t, CLIENT_ID_LENGTH>& senderId,
-        const std::vector<uint8_t>& encryptedMessage);
-    /**
-     * @brief Builds the payload for a message packet.
-     * @param recipientId ID of the message recipient.
-     * @param messageType Type of the message being sent.
-     * @param messageContent Encrypted content of the message.
-     * @return Assembled payload as a byte vector.
-     */
-    std::vector<uint8_t> constructMessagePayload(
-        const std::array<uint8_t, CLIENT_ID_LENGTH>& recipientId,
-        uint8_t messageType,
-        const std::vector<uint8_t>& messageContent);
+        std::span<const uint8_t> encryptedMessage, bool compressed, bool authenticated);
     //
     // === Helpers ===
+    /**
+     * @brief Measures the link to the server and resizes the socket buffers of every connection to match.
+     * @param profile The configured profile, used as the base for the tuned one.
+     */
+    void tuneTransport(TransportProfile profile);
+    /**
+     * @brief Decrypts (if needed) and displays one pending message with its sender.
+     */
+    void displayPendingMessage(const PendingMessage& msg);
+    /**
+     * @brief Displays the processed content of a received message with its sender.
+     */
+    void displayReceived(const std::array<uint8_t, CLIENT_ID_LENGTH>& senderId, const std::string& content);
+    /**
+     * @brief Starts receiving a pending message: plain files open their output file, everything else is buffered.
+     */
+    void beginIncomingMessage(IncomingMessage& incoming, const PendingMessage& header, uint32_t contentSize);
+    /**
+     * @brief Takes the next piece of the content of the message being received.
+     */
+    void appendIncomingMessage(IncomingMessage& incoming, std::span<const uint8_t> piece);
+    /**
+     * @brief Finishes the message being received and displays it.
+     */
+    void endIncomingMessage(IncomingMessage& incoming);
+    /**
+     * @brief A new unique path for a received file: temp directory, sender ID, random suffix and timestamp.
+     */
+    static std::string incomingFilePath(const std::array<uint8_t, CLIENT_ID_LENGTH>& senderId);
+    /**
+     * @brief Starts receiving new messages over a subscription instead of polling, unless turned off in the config.
+     * Falls back to manual fetching if the subscription cannot be opened.
+     */
+    void startSubscription();
+    /**
+     * @brief Deflates message content before encryption, if `capabilities` include compression,
+     * the content reaches the negotiated threshold, and compressing actually makes it smaller.
+     * @param content The plain content.
+     * @param capabilities The formats shared with the recipient (see sharedCapabilities).
+     * @return The compressed content, or std::nullopt to send the content as is.
+     */
+    std::optional<std::string> compressContent(std::span<const uint8_t> content, uint32_t capabilities);
+    /**
+     * @brief The negotiated compression threshold, or std::nullopt if `capabilities` do not include compression.
+     */
+    std::optional<uint32_t> compressionThreshold(uint32_t capabilities);
+    /**
+     * @brief The message formats both the server connection and a peer handle: the server's negotiated
+     * capabilities masked with those the peer announced in the key exchange (none if it announced none).
+     */
+    uint32_t sharedCapabilities(const std::array<uint8_t, CLIENT_ID_LENGTH>& peerId);
+    /**
+     * @brief The worker pool for file encryption, created on first use.
+     */
+    SegmentedCipher& segmentedCipher();
+    /**
+     * @brief Uploads a file larger than one chunk as a resumable chunked transfer on a bulk connection.
+     * @param capabilities The formats shared with the recipient, selecting compression and the chunk cipher.
+     */
+    void sendFileChunked(const std::string& filePath, uint64_t fileSize,
+        const std::array<uint8_t, CLIENT_ID_LENGTH>& recipientId, const std::vector<uint8_t>& symmetricKey,
+        uint32_t capabilities);
     /**
      * @brief Returns the platform-specific temporary directory path.
      * @return Temporary directory path as string.
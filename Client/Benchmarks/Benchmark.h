@@ -0,0 +1,91 @@
+/*
+    Benchmark.h
+
+    Shared helpers of the standalone benchmark executable (Benchmarks.vcxproj). Each benchmark is a
+    function taking its command line arguments, registered by name in BenchmarkMain.cpp, and prints
+    one table row per case so runs can be pasted into a commit or review as is.
+*/
+
+#pragma once
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <ctime>
+#include <string>
+#include <vector>
+
+using BenchmarkArgs = std::vector<std::string>;
+//
+// === Benchmarks (see BenchmarkMain.cpp) ===
+int runSendBenchmark(const BenchmarkArgs& args);
+int runHeaderBenchmark(const BenchmarkArgs& args);
+int runDeflateBenchmark(const BenchmarkArgs& args);
+int runKeyExchangeBenchmark(const BenchmarkArgs& args);
+int runSegmentedCipherBenchmark(const BenchmarkArgs& args);
+//
+//
+/**
+ * @brief Wall and CPU time of a timed section. CPU time is the whole process, so it includes worker threads.
+ */
+struct BenchmarkTiming
+{
+    double wallSeconds = 0;
+    double cpuSeconds  = 0;
+};
+//
+/**
+ * @brief Runs `body` `iterations` times and returns the total time taken.
+ */
+template<typename Body>
+BenchmarkTiming timeIterations(size_t iterations, Body&& body)
+{
+    const std::clock_t cpuStart = std::clock();
+    const auto wallStart = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < iterations; ++i)
+        body();
+    BenchmarkTiming timing;
+    timing.wallSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - wallStart).count();
+    timing.cpuSeconds  = static_cast<double>(std::clock() - cpuStart) / CLOCKS_PER_SEC;
+    return timing;
+}
+//
+/**
+ * @brief Number of repetitions that moves about `targetBytes` in total, at least `minimum`.
+ */
+inline size_t iterationsFor(size_t bytesPerIteration, size_t targetBytes, size_t minimum = 3)
+{
+    const size_t iterations = targetBytes / (bytesPerIteration ? bytesPerIteration : 1);
+    return iterations < minimum ? minimum : iterations;
+}
+//
+/**
+ * @brief "512 B", "64 KB", "16 MB"; sizes that are not a whole number of units get one decimal ("8.3 MB").
+ */
+inline std::string formatSize(size_t bytes)
+{
+    const char* unit = bytes >= (1u << 20) ? "MB" : bytes >= 1024 ? "KB" : "B";
+    const size_t scale = bytes >= (1u << 20) ? (1u << 20) : bytes >= 1024 ? 1024 : 1;
+    char text[32];
+    if (bytes % scale == 0)
+        std::snprintf(text, sizeof(text), "%zu %s", bytes / scale, unit);
+    else
+        std::snprintf(text, sizeof(text), "%.1f %s", static_cast<double>(bytes) / scale, unit);
+    return text;
+}
+//
+/**
+ * @brief Throughput in MB/s (2^20 bytes) for `bytes` moved in `seconds`.
+ */
+inline double megabytesPerSecond(uint64_t bytes, double seconds)
+{
+    return seconds > 0 ? static_cast<double>(bytes) / (1 << 20) / seconds : 0;
+}
+//
+/**
+ * @brief Keeps the compiler from discarding the work that computed `value` (e.g. a size or a checksum byte).
+ */
+inline void keepAlive(uint64_t value)
+{
+    static volatile uint64_t sink;
+    sink = sink + value;
+}
@@ -0,0 +1,106 @@
+/*
+    BenchmarkMain.cpp
+
+    Entry point of the benchmark executable: `Benchmarks <name> [args...]` runs one benchmark,
+    `Benchmarks` alone lists them. Build the Release configuration for meaningful numbers.
+    Every run starts with the machine and build it ran on, so its output can be recorded as is.
+*/
+
+#include "Benchmark.h"
+#include <cryptlib.h>
+#include <algorithm>
+#include <exception>
+#include <iostream>
+#include <thread>
+
+namespace
+{
+    struct BenchmarkEntry
+    {
+        const char* name;
+        const char* description;
+        int (*run)(const BenchmarkArgs& args);
+    };
+    //
+    const BenchmarkEntry BENCHMARKS[] = {
+        { "send", "vectored header + payload write vs ClientPacket::serialize(), 1 KB to 512 MB", runSendBenchmark },
+        { "header", "compile-time header codec vs hand-coded encode/decode", runHeaderBenchmark },
+        { "deflate", "content compression ratio, bandwidth, CPU time and upload time on sample files", runDeflateBenchmark },
+        { "keyexchange", "draining symmetric key responses, cached private key vs parsing it per message", runKeyExchangeBenchmark },
+        { "segmented", "parallel AES-CTR file encryption throughput from 1 to N worker threads", runSegmentedCipherBenchmark },
+        { "crypto", "segmented, keyexchange and deflate with their defaults, the runs the crypto changes are measured by", nullptr },
+    };
+    const char* CRYPTO_SUITE[] = { "segmented", "keyexchange", "deflate" };
+    //
+    void printEnvironment()
+    {
+        std::cout << "hardware threads: " << std::max(1u, std::thread::hardware_concurrency());
+#ifdef NDEBUG
+        std::cout << ", release build";
+#else
+        std::cout << ", debug build (numbers are not meaningful)";
+#endif
+#ifdef _MSC_VER
+        std::cout << ", MSVC " << _MSC_VER;
+#endif
+#ifdef CRYPTOPP_VERSION
+        std::cout << ", Crypto++ " << CRYPTOPP_VERSION / 100 << "." << CRYPTOPP_VERSION / 10 % 10 << "." << CRYPTOPP_VERSION % 10;
+#endif
+        std::cout << "\n\n";
+    }
+    //
+    int runEntry(const BenchmarkEntry& entry, const BenchmarkArgs& args)
+    {
+        try
+        {
+            return entry.run(args);
+        }
+        catch (const std::exception& e)
+        {
+            std::cerr << "Benchmark " << entry.name << " failed: " << e.what() << std::endl;
+            return 1;
+        }
+    }
+    //
+    void printUsage()
+    {
+        std::cout << "Usage: Benchmarks <name> [args...]\n";
+        for (const BenchmarkEntry& entry : BENCHMARKS)
+            std::cout << "  " << entry.name << " - " << entry.description << "\n";
+    }
+}
+//
+int main(int argc, char* argv[])
+{
+    if (argc < 2)
+    {
+        printUsage();
+        return 1;
+    }
+    const std::string name = argv[1];
+    for (const BenchmarkEntry& entry : BENCHMARKS)
+    {
+        if (name != entry.name)
+            continue;
+        printEnvironment();
+        if (entry.run)
+            return runEntry(entry, BenchmarkArgs(argv + 2, argv + argc));
+        //
+        int result = 0;
+        for (const char* suiteName : CRYPTO_SUITE)
+        {
+            for (const BenchmarkEntry& suiteEntry : BENCHMARKS)
+            {
+                if (suiteName != std::string(suiteEntry.name))
+                    continue;
+                std::cout << "=== " << suiteEntry.name << " ===\n";
+                result |= runEntry(suiteEntry, {});
+                std::cout << "\n";
+            }
+        }
+        return result;
+    }
+    std::cerr << "Unknown benchmark: " << name << std::endl;
+    printUsage();
+    return 1;
+}
@@ -0,0 +1,111 @@
+/*
+    DeflateBenchmark.cpp
+
+    DeflateWrapper (the content compression of MSG_FLAG_COMPRESSED) on sample files: ratio, compression
+    and decompression bandwidth and CPU time, and what it does to the time to upload the file over a
+    link of the given speed (compression time + compressed bytes against the raw bytes).
+
+    Usage: Benchmarks deflate [--link-mbps N] [files...]
+    Without files it runs on generated samples: prose-like text, log lines and random bytes.
+*/
+
+#include "Benchmark.h"
+#include "../DeflateWrapper.h"
+#include "../Utility.h"
+#include "../ByteCodec.h"
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <random>
+#include <stdexcept>
+
+namespace
+{
+    constexpr size_t SAMPLE_SIZE       = 8 << 20;
+    constexpr size_t BYTES_PER_CASE    = 64 << 20; //< Volume compressed per sample
+    constexpr double DEFAULT_LINK_MBPS = 100;
+    //
+    struct Sample
+    {
+        std::string          name;
+        std::vector<uint8_t> data;
+    };
+    //
+    std::vector<uint8_t> readFile(const std::string& path)
+    {
+        std::ifstream file(path, std::ios::binary);
+        if (!file)
+            throw std::runtime_error("cannot open " + path);
+        return std::vector<uint8_t>(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+    }
+    //
+    std::vector<Sample> generatedSamples()
+    {
+        static const char* const WORDS[] = { "the", "message", "server", "client", "key", "file", "of", "and", "to",
+            "a", "request", "symmetric", "pending", "is", "received", "with", "connection", "chunk", "sent", "in" };
+        std::mt19937 rng(1);
+        Sample text{ "text", {} }, log{ "log", {} }, random{ "random", {} };
+        while (text.data.size() < SAMPLE_SIZE)
+        {
+            std::string word = WORDS[rng() % std::size(WORDS)];
+            word += rng() % 12 == 0 ? ".\n" : " ";
+            text.data.insert(text.data.end(), word.begin(), word.end());
+        }
+        for (uint32_t line = 0; log.data.size() < SAMPLE_SIZE; ++line)
+        {
+            std::string entry = "2024-05-01 12:" + std::to_string(10 + line / 6000 % 50) + ":" + std::to_string(10 + line / 100 % 50) +
+                " INFO Received data from client " + std::to_string(rng() % 64) + " code " + std::to_string(600 + rng() % 13) +
+                " size " + std::to_string(rng() % 100000) + "\n";
+            log.data.insert(log.data.end(), entry.begin(), entry.end());
+        }
+        random.data.resize(SAMPLE_SIZE);
+        for (uint8_t& byte : random.data)
+            byte = static_cast<uint8_t>(rng());
+        return { std::move(text), std::move(log), std::move(random) };
+    }
+}
+//
+int runDeflateBenchmark(const BenchmarkArgs& args)
+{
+    double linkMbps = DEFAULT_LINK_MBPS;
+    std::vector<Sample> samples;
+    for (size_t i = 0; i < args.size(); ++i)
+    {
+        if (args[i] == "--link-mbps" && i + 1 < args.size())
+            linkMbps = std::stod(args[++i]);
+        else
+            samples.push_back({ args[i], readFile(args[i]) });
+    }
+    if (samples.empty())
+        samples = generatedSamples();
+    const double linkBytesPerSecond = linkMbps * 1e6 / 8;
+
+    std::printf("%-16s %10s %7s %12s %10s %12s %10s %12s %12s\n", "sample", "size", "ratio", "deflate MB/s",
+        "deflate s", "inflate MB/s", "inflate s", "upload raw s", "upload def s");
+    for (const Sample& sample : samples)
+    {
+        const size_t iterations = iterationsFor(sample.data.size(), BYTES_PER_CASE);
+        std::string compressed;
+        const BenchmarkTiming deflate = timeIterations(iterations, [&] { compressed = DeflateWrapper::compress(sample.data); });
+        std::string inflated;
+        const BenchmarkTiming inflate = timeIterations(iterations, [&] {
+            inflated = DeflateWrapper::decompress(asBytes(compressed), MAX_DECOMPRESSED_SIZE);
+        });
+        if (inflated.size() != sample.data.size() || std::memcmp(inflated.data(), sample.data.data(), inflated.size()) != 0)
+            throw std::runtime_error("round trip of " + sample.name + " failed");
+
+        // Per pass; CPU time is per pass too. The upload column counts compression plus sending the smaller content
+        // (Application::compressContent sends the content as is when deflating does not make it smaller)
+        const uint64_t bytes = static_cast<uint64_t>(iterations) * sample.data.size();
+        const double deflateSeconds = deflate.wallSeconds / iterations;
+        const double rawUpload = sample.data.size() / linkBytesPerSecond;
+        const double deflatedUpload = compressed.size() < sample.data.size()
+            ? deflateSeconds + compressed.size() / linkBytesPerSecond : deflateSeconds + rawUpload;
+        std::printf("%-16s %10s %6.1f%% %12.1f %10.4f %12.1f %10.4f %12.3f %12.3f\n", sample.name.c_str(),
+            formatSize(sample.data.size()).c_str(), 100.0 * compressed.size() / sample.data.size(),
+            megabytesPerSecond(bytes, deflate.wallSeconds), deflate.cpuSeconds / iterations,
+            megabytesPerSecond(bytes, inflate.wallSeconds), inflate.cpuSeconds / iterations, rawUpload, deflatedUpload);
+    }
+    std::printf("(upload columns at %.0f Mbit/s; deflate s and inflate s are CPU seconds per pass)\n", linkMbps);
+    return 0;
+}
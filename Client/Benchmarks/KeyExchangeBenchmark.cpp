@@ -0,0 +1,82 @@
+/*
+    KeyExchangeBenchmark.cpp
+
+    Draining a backlog of symmetric key responses: each one is an RSA-OAEP ciphertext of an AES key
+    that the client decrypts with its private key. Compares ClientInfo::decryptWithPrivateKey, which
+    reuses the key parsed when it was loaded, against the path it replaced (Base64-decode and parse
+    the DER key, seed a new RNG and build a decryptor for every message).
+
+    Usage: Benchmarks keyexchange [messages, default 1000]
+*/
+
+#include "Benchmark.h"
+#include "../ClientInfo.h"
+#include "../RSAWrapper.h"
+#include "../AESWrapper.h"
+#include "../Base64Wrapper.h"
+#include <osrng.h>
+#include <stdexcept>
+
+namespace
+{
+    constexpr size_t DEFAULT_MESSAGES = 1000;
+    //
+    // As ClientInfo::decryptWithPrivateKey was written before the parsed key was kept
+    std::string decryptPerMessage(const std::string& privateKeyBase64, const std::string& cipher)
+    {
+        std::string rawPrivateKey = Base64Wrapper::decode(privateKeyBase64);
+        CryptoPP::AutoSeededRandomPool rng;
+        CryptoPP::RSA::PrivateKey privateKey;
+        CryptoPP::StringSource keySource(rawPrivateKey, true);
+        privateKey.Load(keySource);
+        //
+        std::string decrypted;
+        CryptoPP::RSAES_OAEP_SHA_Decryptor decryptor(privateKey);
+        CryptoPP::StringSource ss(cipher, true, new CryptoPP::PK_DecryptorFilter(rng, decryptor, new CryptoPP::StringSink(decrypted)));
+        return decrypted;
+    }
+    //
+    void printRow(const char* name, size_t messages, const BenchmarkTiming& timing, double baselineSeconds)
+    {
+        std::printf("%-26s %10zu %10.1f %12.1f %12.0f %7.2fx\n", name, messages, timing.wallSeconds * 1e3,
+            timing.wallSeconds * 1e6 / messages, messages / timing.wallSeconds, baselineSeconds / timing.wallSeconds);
+    }
+}
+//
+int runKeyExchangeBenchmark(const BenchmarkArgs& args)
+{
+    const size_t messages = args.empty() ? DEFAULT_MESSAGES : std::stoull(args[0]);
+
+    // One key pair, one fresh AES key per incoming response, as peers would send them
+    RSAPrivateWrapper keyPair;
+    const std::string privateKeyBase64 = Base64Wrapper::encode(keyPair.getPrivateKey());
+    RSAPublicWrapper publicKey(keyPair.getPublicKey());
+    CryptoPP::AutoSeededRandomPool rng;
+    std::vector<std::string> symmetricKeys(messages), responses(messages);
+    for (size_t i = 0; i < messages; ++i)
+    {
+        symmetricKeys[i].resize(AESWrapper::DEFAULT_KEYLENGTH);
+        rng.GenerateBlock(reinterpret_cast<CryptoPP::byte*>(&symmetricKeys[i][0]), symmetricKeys[i].size());
+        responses[i] = publicKey.encrypt(symmetricKeys[i]);
+    }
+
+    ClientInfo client;
+    client.setPrivateKey(privateKeyBase64);
+
+    std::printf("%-26s %10s %10s %12s %12s %8s\n", "case", "messages", "total ms", "us/message", "messages/s", "speedup");
+    size_t next = 0;
+    const BenchmarkTiming perMessage = timeIterations(messages, [&] {
+        if (decryptPerMessage(privateKeyBase64, responses[next]) != symmetricKeys[next])
+            throw std::runtime_error("per-message key parse decrypted the wrong key");
+        ++next;
+    });
+    next = 0;
+    const BenchmarkTiming cached = timeIterations(messages, [&] {
+        if (client.decryptWithPrivateKey(responses[next]) != symmetricKeys[next])
+            throw std::runtime_error("cached key decrypted the wrong key");
+        ++next;
+    });
+    printRow("parse key per message", messages, perMessage, perMessage.wallSeconds);
+    printRow("cached private key", messages, cached, perMessage.wallSeconds);
+    return 0;
+}
@@ -0,0 +1,77 @@
+/*
+    SegmentedCipherBenchmark.cpp
+
+    Throughput of the parallel AES-CTR file encryption (MSG_FLAG_SEGMENTED) from 1 to N worker threads:
+    SegmentedCipher::apply on one chunk, as the receiver decrypts it, and a window of chunks sealed one
+    job per chunk, as FileSender encrypts them. Speedups are against one thread. With fewer hardware
+    threads than workers the extra workers only add scheduling overhead.
+
+    Usage: Benchmarks segmented [max threads, default one per hardware thread]
+*/
+
+#include "Benchmark.h"
+#include "../SegmentedCipher.h"
+#include "../FileSender.h"
+#include "../Utility.h"
+#include <algorithm>
+#include <thread>
+
+namespace
+{
+    constexpr size_t BYTES_PER_CASE = 512ull << 20; //< Volume encrypted per thread count and case
+    constexpr uint64_t FILE_ID      = 0x0123456789ABCDEFull;
+}
+//
+int runSegmentedCipherBenchmark(const BenchmarkArgs& args)
+{
+    const unsigned hardware = std::max(1u, std::thread::hardware_concurrency());
+    const unsigned maxThreads = args.empty() ? hardware : static_cast<unsigned>(std::stoul(args[0]));
+    const unsigned char key[16] = { 0x5A, 0x01, 0x02, 0x03 };
+
+    std::vector<uint8_t> chunk(FILE_CHUNK_SIZE, 0x5A);
+    std::vector<uint8_t> window(FileSender::MAX_WINDOW_CHUNKS * static_cast<size_t>(FILE_CHUNK_SIZE), 0x5A);
+    if (maxThreads > hardware)
+        std::printf("rows above %u threads share the hardware threads, they cannot show a speedup\n", hardware);
+    std::printf("%8s %12s %8s %8s %12s %8s %10s\n", "threads", "chunk MB/s", "speedup", "window", "window MB/s", "speedup", "CPU s/GB");
+    // Powers of two, then the maximum itself
+    std::vector<unsigned> threadCounts;
+    for (unsigned threads = 1; threads < maxThreads; threads *= 2)
+        threadCounts.push_back(threads);
+    threadCounts.push_back(maxThreads);
+
+    double chunkBase = 0, windowBase = 0;
+    for (unsigned threads : threadCounts)
+    {
+        SegmentedCipher cipher(threads);
+
+        // Receiver: one chunk, split into segments across the pool
+        const size_t chunkIterations = iterationsFor(chunk.size(), BYTES_PER_CASE);
+        const BenchmarkTiming chunkTiming = timeIterations(chunkIterations, [&] {
+            cipher.apply(key, FILE_ID, 0, chunk);
+        });
+        const double chunkRate = megabytesPerSecond(static_cast<uint64_t>(chunkIterations) * chunk.size(), chunkTiming.wallSeconds);
+
+        // Sender: FileSender's window for this thread count, one job per whole chunk
+        const size_t windowChunks = std::clamp<size_t>(threads, 1, FileSender::MAX_WINDOW_CHUNKS);
+        const size_t windowBytes = windowChunks * FILE_CHUNK_SIZE;
+        const size_t windowIterations = iterationsFor(windowBytes, BYTES_PER_CASE);
+        const BenchmarkTiming windowTiming = timeIterations(windowIterations, [&] {
+            cipher.forEachAsync(windowChunks, [&](size_t index) {
+                const size_t offset = index * FILE_CHUNK_SIZE;
+                SegmentedCipher::applySegment(key, FILE_ID, offset, std::span<uint8_t>(window.data() + offset, FILE_CHUNK_SIZE));
+            }).get();
+        });
+        const uint64_t windowTotal = static_cast<uint64_t>(windowIterations) * windowBytes;
+        const double windowRate = megabytesPerSecond(windowTotal, windowTiming.wallSeconds);
+
+        if (threads == 1)
+        {
+            chunkBase = chunkRate;
+            windowBase = windowRate;
+        }
+        std::printf("%8u %12.1f %7.2fx %8zu %12.1f %7.2fx %10.3f\n", threads, chunkRate, chunkRate / chunkBase,
+            windowChunks, windowRate, windowRate / windowBase, windowTiming.cpuSeconds / (windowTotal / 1e9));
+    }
+    keepAlive(chunk[0] + window[0]);
+    return 0;
+}
@@ -0,0 +1,87 @@
+/*
+    SendBenchmark.cpp
+
+    Sending a request as a vectored write (the encoded header and the payload as one buffer sequence,
+    as NetworkManager does) against copying it into one buffer with ClientPacket::serialize() first.
+    Packets go over a loopback connection to a thread that reads and discards them, so the numbers
+    include the socket writes but no server work.
+
+    Usage: Benchmarks send [max size in bytes, default 512 MB]
+*/
+
+#include "Benchmark.h"
+#include "../ClientPacket.h"
+#include <boost/asio.hpp>
+#include <iostream>
+#include <thread>
+
+using boost::asio::ip::tcp;
+
+namespace
+{
+    constexpr size_t DEFAULT_MAX_SIZE = 512ull << 20;
+    constexpr size_t BYTES_PER_CASE   = 256ull << 20; //< Volume sent per size and method
+    constexpr size_t SINK_BUFFER_SIZE = 1 << 20;
+    //
+    /**
+     * @brief Reads and discards everything sent on `socket` until the peer closes it.
+     */
+    void drain(tcp::socket& socket)
+    {
+        std::vector<uint8_t> buffer(SINK_BUFFER_SIZE);
+        boost::system::error_code error;
+        while (!error)
+            socket.read_some(boost::asio::buffer(buffer), error);
+    }
+}
+//
+int runSendBenchmark(const BenchmarkArgs& args)
+{
+    const size_t maxSize = args.empty() ? DEFAULT_MAX_SIZE : std::stoull(args[0]);
+
+    boost::asio::io_context io;
+    tcp::acceptor acceptor(io, tcp::endpoint(boost::asio::ip::address_v4::loopback(), 0));
+    tcp::socket sink(io);
+    std::thread sinkThread([&] { acceptor.accept(sink); drain(sink); });
+
+    tcp::socket socket(io);
+    socket.connect(acceptor.local_endpoint());
+    socket.set_option(tcp::no_delay(true));
+
+    std::array<uint8_t, CLIENT_ID_LENGTH> clientId{};
+    std::printf("%10s %10s %14s %14s %12s %12s %8s\n",
+        "size", "packets", "vectored MB/s", "serialize MB/s", "vectored us", "serialize us", "speedup");
+
+    for (size_t size = 1024; size <= maxSize; size *= 4)
+    {
+        const ClientPacket packet(CODE_SEND_MESSAGE_TO_USER, std::vector<uint8_t>(size, 0x5A), clientId);
+        const size_t packets = iterationsFor(size + CLIENT_HEADER_SIZE, BYTES_PER_CASE);
+        const uint64_t bytes = static_cast<uint64_t>(packets) * (size + CLIENT_HEADER_SIZE);
+
+        const BenchmarkTiming vectored = timeIterations(packets, [&] {
+            const std::array<uint8_t, CLIENT_HEADER_SIZE> header = packet.encodeHeader();
+            const std::array<boost::asio::const_buffer, 2> buffers{
+                boost::asio::buffer(header), boost::asio::buffer(packet.getPayload()) };
+            boost::asio::write(socket, buffers);
+        });
+        const BenchmarkTiming serialized = timeIterations(packets, [&] {
+            const std::vector<uint8_t> buffer = packet.serialize();
+            boost::asio::write(socket, boost::asio::buffer(buffer));
+        });
+
+        std::printf("%10s %10zu %14.1f %14.1f %12.2f %12.2f %7.2fx\n",
+            formatSize(size).c_str(), packets,
+            megabytesPerSecond(bytes, vectored.wallSeconds), megabytesPerSecond(bytes, serialized.wallSeconds),
+            vectored.wallSeconds * 1e6 / packets, serialized.wallSeconds * 1e6 / packets,
+            serialized.wallSeconds / vectored.wallSeconds);
+
+        // Largest size last even when it is not a power of four from 1 KB (512 MB is not)
+        if (size < maxSize && size * 4 > maxSize)
+            size = maxSize / 4;
+    }
+
+    socket.shutdown(tcp::socket::shutdown_send);
+    socket.close();
+    sinkThread.join();
+    return 0;
+}
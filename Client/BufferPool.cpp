@@ -0,0 +1,60 @@
+#include "BufferPool.h"
+
+#define DEFAULT_MAX_POOLED_BUFFERS    (4U)
+#define DEFAULT_MAX_RETAINED_CAPACITY (64U * 1024U * 1024U) // 64 MB
+
+BufferPool::Lease::Lease(std::weak_ptr<BufferPool> pool, std::vector<uint8_t>&& buffer)
+    : m_pool(std::move(pool)), m_buffer(std::move(buffer)) {}
+//
+BufferPool::Lease& BufferPool::Lease::operator=(Lease&& other) noexcept
+{
+    if (this != &other)
+    {
+        if (std::shared_ptr<BufferPool> pool = m_pool.lock())
+            pool->release(std::move(m_buffer));
+        m_pool = std::move(other.m_pool);
+        m_buffer = std::move(other.m_buffer);
+        other.m_pool.reset();
+    }
+    return *this;
+}
+//
+BufferPool::Lease::~Lease()
+{
+    if (std::shared_ptr<BufferPool> pool = m_pool.lock())
+        pool->release(std::move(m_buffer));
+}
+//
+BufferPool::BufferPool(size_t maxPooled, size_t maxRetainedCapacity)
+    : m_maxPooled(maxPooled), m_maxRetainedCapacity(maxRetainedCapacity) {}
+//
+std::shared_ptr<BufferPool> BufferPool::create()
+{
+    return std::make_shared<BufferPool>(DEFAULT_MAX_POOLED_BUFFERS, DEFAULT_MAX_RETAINED_CAPACITY);
+}
+//
+BufferPool::Lease BufferPool::acquire(size_t size)
+{
+    std::vector<uint8_t> buffer;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (!m_free.empty())
+        {
+            buffer = std::move(m_free.back());
+            m_free.pop_back();
+        }
+    }
+    buffer.resize(size);
+    return Lease(weak_from_this(), std::move(buffer));
+}
+//
+void BufferPool::release(std::vector<uint8_t>&& buffer)
+{
+    if (buffer.capacity() == 0 || buffer.capacity() > m_maxRetainedCapacity)
+        return;
+    //
+    buffer.clear();
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (m_free.size() < m_maxPooled)
+        m_free.push_back(std::move(buffer));
+}
@@ -0,0 +1,59 @@
+/*
+    BufferPool.h
+
+    A small pool of reusable byte buffers for received packets. A buffer is handed out as a
+    move-only Lease and goes back to the pool when the lease is destroyed, so in steady state
+    receiving a packet does not allocate. The pool is shared, so a lease may safely outlive
+    the object that created the pool.
+*/
+
+#pragma once
+#include <vector>
+#include <memory>
+#include <mutex>
+#include <cstdint>
+
+class BufferPool : public std::enable_shared_from_this<BufferPool>
+{
+    std::mutex                        m_mutex;
+    std::vector<std::vector<uint8_t>> m_free; //< Buffers ready for reuse
+    size_t                            m_maxPooled; //< Max number of idle buffers kept
+    size_t                            m_maxRetainedCapacity; //< Larger buffers are freed instead of pooled
+    //
+    /**
+     * @brief Returns a buffer to the pool, or frees it if the pool is full or the buffer is too large.
+     */
+    void release(std::vector<uint8_t>&& buffer);
+public:
+    /**
+     * Move-only handle to a pooled buffer. Returns the buffer to its pool on destruction.
+     */
+    class Lease
+    {
+        std::weak_ptr<BufferPool> m_pool;
+        std::vector<uint8_t>      m_buffer;
+    public:
+        Lease() = default;
+        Lease(std::weak_ptr<BufferPool> pool, std::vector<uint8_t>&& buffer);
+        Lease(Lease&& other) noexcept = default;
+        Lease& operator=(Lease&& other) noexcept;
+        Lease(const Lease&) = delete;
+        Lease& operator=(const Lease&) = delete;
+        ~Lease();
+        //
+        uint8_t*       data() { return m_buffer.data(); }
+        const uint8_t* data() const { return m_buffer.data(); }
+        size_t         size() const { return m_buffer.size(); }
+        void           resize(size_t size) { m_buffer.resize(size); }
+    };
+    //
+    BufferPool(size_t maxPooled, size_t maxRetainedCapacity);
+    /**
+     * @brief Creates a pool with the default limits.
+     */
+    static std::shared_ptr<BufferPool> create();
+    /**
+     * @brief Hands out a buffer of `size` bytes, reusing an idle one when possible.
+     */
+    Lease acquire(size_t size);
+};
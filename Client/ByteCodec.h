@@ -0,0 +1,172 @@
+/*
+    ByteCodec.h
+
+    Bounds-checked cursors for building and parsing payloads in place.
+    ByteWriter writes into a caller-owned buffer of fixed size (it never allocates or grows), and ByteReader
+    reads from a span without copying: byte runs are returned as sub-spans of the input.
+    Both throw std::runtime_error instead of writing or reading past the end. Integers are big endian,
+    varints are unsigned LEB128 (7 bits per byte, low bits first).
+*/
+
+#pragma once
+#include <array>
+#include <cstdint>
+#include <cstring>
+#include <span>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+
+constexpr size_t MAX_VARINT_LEN = 5; //< LEB128 bytes needed for a 32-bit value
+
+/**
+ * @brief Views the characters of a string as bytes, without copying.
+ */
+inline std::span<const uint8_t> asBytes(std::string_view text)
+{
+    return std::span<const uint8_t>(reinterpret_cast<const uint8_t*>(text.data()), text.size());
+}
+
+class ByteWriter
+{
+private:
+    std::span<uint8_t> m_buffer;
+    size_t             m_pos;
+    //
+    uint8_t* reserve(size_t size)
+    {
+        if (size > m_buffer.size() - m_pos)
+            throw std::runtime_error("Payload encoding overflow\n");
+        uint8_t* out = m_buffer.data() + m_pos;
+        m_pos += size;
+        return out;
+    }
+public:
+    explicit ByteWriter(std::span<uint8_t> buffer) : m_buffer(buffer), m_pos(0) { }
+    //
+    void writeU8(uint8_t value) { *reserve(1) = value; }
+    void writeU16(uint16_t value)
+    {
+        uint8_t* out = reserve(2);
+        out[0] = static_cast<uint8_t>(value >> 8);
+        out[1] = static_cast<uint8_t>(value);
+    }
+    void writeU32(uint32_t value)
+    {
+        uint8_t* out = reserve(4);
+        out[0] = static_cast<uint8_t>(value >> 24);
+        out[1] = static_cast<uint8_t>(value >> 16);
+        out[2] = static_cast<uint8_t>(value >> 8);
+        out[3] = static_cast<uint8_t>(value);
+    }
+    void writeU64(uint64_t value)
+    {
+        writeU32(static_cast<uint32_t>(value >> 32));
+        writeU32(static_cast<uint32_t>(value));
+    }
+    void writeBytes(std::span<const uint8_t> bytes)
+    {
+        if (!bytes.empty())
+            std::memcpy(reserve(bytes.size()), bytes.data(), bytes.size());
+    }
+    /**
+     * @brief Writes `text` into a field of exactly `fieldSize` bytes, zero-padded. Fails if it does not fit.
+     */
+    void writeFixedString(std::string_view text, size_t fieldSize)
+    {
+        if (text.size() > fieldSize)
+            throw std::runtime_error("String does not fit its field\n");
+        uint8_t* out = reserve(fieldSize);
+        std::memcpy(out, text.data(), text.size());
+        std::memset(out + text.size(), 0, fieldSize - text.size());
+    }
+    //
+    size_t written() const { return m_pos; }
+};
+
+class ByteReader
+{
+private:
+    std::span<const uint8_t> m_data;
+    //
+    std::span<const uint8_t> take(size_t size)
+    {
+        if (size > m_data.size())
+            throw std::runtime_error("Payload too short\n");
+        std::span<const uint8_t> result = m_data.first(size);
+        m_data = m_data.subspan(size);
+        return result;
+    }
+public:
+    explicit ByteReader(std::span<const uint8_t> data) : m_data(data) { }
+    //
+    uint8_t readU8() { return take(1)[0]; }
+    uint16_t readU16()
+    {
+        std::span<const uint8_t> in = take(2);
+        return static_cast<uint16_t>((in[0] << 8) | in[1]);
+    }
+    uint32_t readU32()
+    {
+        std::span<const uint8_t> in = take(4);
+        return (static_cast<uint32_t>(in[0]) << 24) | (static_cast<uint32_t>(in[1]) << 16) |
+            (static_cast<uint32_t>(in[2]) << 8) | static_cast<uint32_t>(in[3]);
+    }
+    uint64_t readU64()
+    {
+        uint64_t high = readU32();
+        return (high << 32) | readU32();
+    }
+    /**
+     * @brief Reads an unsigned LEB128 varint. Fails on values that do not fit 32 bits.
+     */
+    uint32_t readVarint()
+    {
+        uint32_t value = 0;
+        for (size_t i = 0; i < MAX_VARINT_LEN; ++i)
+        {
+            uint8_t byte = readU8();
+            if (i == MAX_VARINT_LEN - 1 && byte > 0x0F)
+                break;
+            value |= static_cast<uint32_t>(byte & 0x7F) << (7 * i);
+            if (!(byte & 0x80))
+                return value;
+        }
+        throw std::runtime_error("Varint out of range\n");
+    }
+    template <size_t N>
+    std::array<uint8_t, N> readArray()
+    {
+        std::array<uint8_t, N> result;
+        std::memcpy(result.data(), take(N).data(), N);
+        return result;
+    }
+    /**
+     * @brief Returns a view of the next `size` bytes.
+     */
+    std::span<const uint8_t> readBytes(size_t size) { return take(size); }
+    /**
+     * @brief Returns a view of everything not read yet.
+     */
+    std::span<const uint8_t> readRest() { return take(m_data.size()); }
+    /**
+     * @brief Reads a zero-padded string field of `fieldSize` bytes, up to its first null character.
+     */
+    std::string readFixedString(size_t fieldSize)
+    {
+        std::span<const uint8_t> field = take(fieldSize);
+        const uint8_t* end = static_cast<const uint8_t*>(std::memchr(field.data(), 0, field.size()));
+        return std::string(reinterpret_cast<const char*>(field.data()), end ? end - field.data() : field.size());
+    }
+    /**
+     * @brief Reads a string preceded by a one-byte length.
+     */
+    std::string readShortString()
+    {
+        std::span<const uint8_t> text = take(readU8());
+        return std::string(reinterpret_cast<const char*>(text.data()), text.size());
+    }
+    //
+    size_t remaining() const { return m_data.size(); }
+    bool empty() const { return m_data.empty(); }
+};
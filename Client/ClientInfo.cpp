@@ -8,6 +8,7 @@
 #include <stdexcept>
 
 ClientInfo::ClientInfo() : m_clientId{} {};
+ClientInfo::~ClientInfo() = default;
 
 bool ClientInfo::loadFromFile(const std::string& filePath)
 {
@@ -50,10 +51,11 @@ bool ClientInfo::loadFromFile(const std::string& filePath)
         std::cerr << "Error: Private key is not valid Base64.\n";
         return resetCorruptedFile(filePath);
     }
-    // try creating RSA object to confirm the key works
+    // Parse the key once: confirms it works and keeps it ready for decryption
+    std::unique_ptr<RSAPrivateWrapper> parsedKey;
     try
     {
-        RSAPrivateWrapper testKey(decodedKey);
+        parsedKey = std::make_unique<RSAPrivateWrapper>(decodedKey);
     }
     catch (...)
     {
@@ -70,6 +72,7 @@ bool ClientInfo::loadFromFile(const std::string& filePath)
     m_username = username;
     m_clientId = clientId;
     m_privateKeyBase64 = privateKey;
+    m_privateKey = std::move(parsedKey);
     //
     return true;
 }
@@ -97,9 +100,15 @@ void ClientInfo::saveToFile(const std::string& filePath) const
 //
 std::string ClientInfo::decryptWithPrivateKey(const std::string& encryptedData)
 {
-    std::string rawPrivateKey = Base64Wrapper::decode(m_privateKeyBase64);
-    RSAPrivateWrapper privateKey(rawPrivateKey);
-    return privateKey.decrypt(encryptedData);
+    if (!m_privateKey)
+        throw std::runtime_error("No private key loaded.");
+    return m_privateKey->decrypt(encryptedData);
+}
+//
+void ClientInfo::setPrivateKey(const std::string& privateKey)
+{
+    m_privateKey = std::make_unique<RSAPrivateWrapper>(Base64Wrapper::decode(privateKey));
+    m_privateKeyBase64 = privateKey;
 }
 
 bool ClientInfo::resetCorruptedFile(const std::string& filePath)
@@ -13,6 +13,9 @@
 #include <vector>
 #include <string>
 #include <optional>
+#include <memory>
+
+class RSAPrivateWrapper;
 
 class ClientInfo
 {
@@ -21,8 +24,10 @@ private:
     std::array<uint8_t, CLIENT_ID_LENGTH> m_clientId;
     std::string m_publicKey;         // Raw 160-byte RSA public key
     std::string m_privateKeyBase64;  // Base64-encoded DER-formatted RSA private key
+    std::unique_ptr<RSAPrivateWrapper> m_privateKey; // Parsed once from m_privateKeyBase64, reused for every decryption
 public:
     ClientInfo(); // CTOR
+    ~ClientInfo();
     //
     /**
      * @brief Loads client data (username, client ID, private key) from file.
@@ -42,7 +47,8 @@ public:
     void saveToFile(const std::string& filePath) const; 
     //
     /**
-     * @brief Decrypts data using the client's private RSA key.
+     * @brief Decrypts data using the client's private RSA key, parsed when the key was loaded or set.
+     * Throws if no private key is set or the data cannot be decrypted.
      *
      * @param encryptedData Encrypted input (typically an AES key).
      * @return Decrypted string.
@@ -64,6 +70,9 @@ public:
     void setUsername(const std::string& username) { m_username = username; }
     void setClientId(const std::array<uint8_t, CLIENT_ID_LENGTH>& clientId) { m_clientId = clientId; }
     void setPublicKey(const std::string& publicKey) { m_publicKey = publicKey; }
-    void setPrivateKey(const std::string& privateKey) { m_privateKeyBase64 = privateKey; }
+    /**
+     * @brief Sets the Base64 encoded private key and parses it for decryption. Throws if the key is invalid.
+     */
+    void setPrivateKey(const std::string& privateKey);
 };
 
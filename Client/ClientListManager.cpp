@@ -1,6 +1,6 @@
 #include "ClientListManager.h"
 
-ClientListManager::ClientListManager()
+ClientListManager::ClientListManager() : m_version(0)
 {
     clientMap.clear();
 }
@@ -8,8 +8,21 @@ ClientListManager::ClientListManager()
 void ClientListManager::updateClientList(const std::vector<std::pair<std::string, std::array<uint8_t, CLIENT_ID_LENGTH>>>& clients)
 {
     clientMap.clear();
+    usernameMap.clear();
+    m_version = 0; // a full list carries no version, the next sync starts over
+    mergeClientList(clients, 0);
+}
+//
+void ClientListManager::mergeClientList(const std::vector<std::pair<std::string, std::array<uint8_t, CLIENT_ID_LENGTH>>>& clients, uint32_t version)
+{
+    clientMap.reserve(clientMap.size() + clients.size());
+    usernameMap.reserve(usernameMap.size() + clients.size());
     for (const auto& client : clients)
+    {
         clientMap[client.first] = client.second;
+        usernameMap[client.second] = client.first;
+    }
+    m_version = version;
 }
 //
 std::optional<std::array<uint8_t, CLIENT_ID_LENGTH>> ClientListManager::getClientId(const std::string& username) const
@@ -35,6 +48,13 @@ void ClientListManager::storePublicKey(const std::array<uint8_t, CLIENT_ID_LENGT
     publicKeyMap[clientId] = publicKey;
 }
 //
+void ClientListManager::storePublicKeys(std::span<const std::pair<std::array<uint8_t, CLIENT_ID_LENGTH>, std::span<const uint8_t>>> keys)
+{
+    publicKeyMap.reserve(publicKeyMap.size() + keys.size());
+    for (const auto& [clientId, publicKey] : keys)
+        publicKeyMap[clientId].assign(publicKey.begin(), publicKey.end());
+}
+//
 void ClientListManager::printClientList() const
 {
     if (clientMap.empty())
@@ -50,18 +70,18 @@ void ClientListManager::printClientList() const
 //
 std::optional<std::string> ClientListManager::getUsername(const std::array<uint8_t, CLIENT_ID_LENGTH>& clientId) const
 {
-    for (const auto& [username, id] : clientMap)
-    {
-        if (std::equal(id.begin(), id.end(), clientId.begin()))
-            return username;
-    }
+    auto it = usernameMap.find(clientId);
+    if (it != usernameMap.end())
+        return it->second;
     return std::nullopt;
 }
 //
 // Store symmetric key for specific client ID
 void ClientListManager::storeSymmetricKey(const std::array<uint8_t, CLIENT_ID_LENGTH>& clientId, const std::vector<uint8_t>& symmetricKey)
 {
-    m_symmetricKeys[clientId] = symmetricKey;
+    // The key is expanded once here, every message to or from the client reuses the cipher
+    m_symmetricKeys.erase(clientId);
+    m_symmetricKeys.try_emplace(clientId, symmetricKey.data(), static_cast<unsigned int>(symmetricKey.size()));
 }
 //
 // Retrieve symmetric key for specific client ID
@@ -69,7 +89,29 @@ std::optional<std::vector<uint8_t>> ClientListManager::getSymmetricKey(const std
 {
     auto it = m_symmetricKeys.find(clientId);
     if (it != m_symmetricKeys.end())
-        return it->second;
+        return std::vector<uint8_t>(it->second.getKey(), it->second.getKey() + AESWrapper::DEFAULT_KEYLENGTH);
     //
     return std::nullopt; // No key found
 }
+//
+AESWrapper* ClientListManager::getCipher(const std::array<uint8_t, CLIENT_ID_LENGTH>& clientId)
+{
+    auto it = m_symmetricKeys.find(clientId);
+    return it != m_symmetricKeys.end() ? &it->second : nullptr;
+}
+//
+void ClientListManager::setPeerCapabilities(const std::array<uint8_t, CLIENT_ID_LENGTH>& clientId, std::optional<uint32_t> capabilities)
+{
+    if (capabilities)
+        m_peerCapabilities[clientId] = *capabilities;
+    else
+        m_peerCapabilities.erase(clientId);
+}
+//
+std::optional<uint32_t> ClientListManager::getPeerCapabilities(const std::array<uint8_t, CLIENT_ID_LENGTH>& clientId) const
+{
+    auto it = m_peerCapabilities.find(clientId);
+    if (it != m_peerCapabilities.end())
+        return it->second;
+    return std::nullopt;
+}
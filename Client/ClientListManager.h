@@ -12,14 +12,19 @@
 #include <array>
 #include <vector>
 #include <optional>
+#include <span>
 #include "UI.h"
+#include "AESWrapper.h"
 
 class ClientListManager
 {
 private:
     std::unordered_map<std::string, std::array<uint8_t, CLIENT_ID_LENGTH>> clientMap; // maps username to client ID
+    std::unordered_map<std::array<uint8_t, CLIENT_ID_LENGTH>, std::string, ArrayHasher> usernameMap; // maps client ID to username
+    uint32_t m_version; // server directory version the client list is in sync with
     std::unordered_map<std::array<uint8_t, CLIENT_ID_LENGTH>, std::string, ArrayHasher> publicKeyMap; // maps client ID to public key
-    std::unordered_map<std::array<uint8_t, CLIENT_ID_LENGTH>, std::vector<uint8_t>, ArrayHasher> m_symmetricKeys; // maps client ID to symmetric key
+    std::unordered_map<std::array<uint8_t, CLIENT_ID_LENGTH>, AESWrapper, ArrayHasher> m_symmetricKeys; // maps client ID to a cipher keyed with its symmetric key
+    std::unordered_map<std::array<uint8_t, CLIENT_ID_LENGTH>, uint32_t, ArrayHasher> m_peerCapabilities; // maps client ID to the formats it announced
     UI m_ui;
     //
 public:
@@ -30,6 +35,17 @@ public:
      * @param clients Vector of <username, clientId> pairs.
      */
     void updateClientList(const std::vector<std::pair<std::string, std::array<uint8_t, CLIENT_ID_LENGTH>>>& clients);
+    /**
+     * @brief Merge clients added on the server into the current list, in place.
+     *
+     * @param clients Vector of <username, clientId> pairs added since getVersion().
+     * @param version Directory version the list is in sync with afterwards.
+     */
+    void mergeClientList(const std::vector<std::pair<std::string, std::array<uint8_t, CLIENT_ID_LENGTH>>>& clients, uint32_t version);
+    /**
+     * @brief Get the server directory version the client list is in sync with (0 if never synced).
+     */
+    uint32_t getVersion() const { return m_version; }
     /**
      * @brief Get the client ID for a given username.
      *
@@ -64,10 +80,16 @@ public:
      * @param publicKey Raw public key data as string.
      */
     void storePublicKey(const std::array<uint8_t, CLIENT_ID_LENGTH>& clientId, const std::string& publicKey);
+    /**
+     * @brief Store the public keys of several clients in one pass.
+     *
+     * @param keys Pairs of client ID and raw public key data.
+     */
+    void storePublicKeys(std::span<const std::pair<std::array<uint8_t, CLIENT_ID_LENGTH>, std::span<const uint8_t>>> keys);
     //
     // === Symmetric key handling ===
     /**
-     * @brief Store a symmetric key for a specific client.
+     * @brief Store a symmetric key for a specific client, replacing its cipher if it had one.
      *
      * @param clientId The client ID.
      * @param symmetricKey A 128-bit AES key.
@@ -80,5 +102,29 @@ public:
      * @return std::optional containing the symmetric key if found.
      */
     std::optional<std::vector<uint8_t>> getSymmetricKey(const std::array<uint8_t, CLIENT_ID_LENGTH>& clientId) const;
+    /**
+     * @brief Get the cipher keyed with a client's symmetric key, ready to encrypt or decrypt.
+     * The pointer stays valid until the client's key is replaced.
+     *
+     * @param clientId The client ID.
+     * @return The cached cipher, or nullptr if no symmetric key is stored for the client.
+     */
+    AESWrapper* getCipher(const std::array<uint8_t, CLIENT_ID_LENGTH>& clientId);
+    //
+    // === Peer capabilities ===
+    /**
+     * @brief Record the capabilities a client announced in the symmetric key exchange.
+     *
+     * @param clientId The client ID.
+     * @param capabilities The announced PEER_CAPABILITIES bits, or std::nullopt if the client announced none (an older client).
+     */
+    void setPeerCapabilities(const std::array<uint8_t, CLIENT_ID_LENGTH>& clientId, std::optional<uint32_t> capabilities);
+    /**
+     * @brief Get the capabilities a client announced.
+     *
+     * @param clientId The client ID.
+     * @return std::optional containing the capabilities, or std::nullopt if none are known.
+     */
+    std::optional<uint32_t> getPeerCapabilities(const std::array<uint8_t, CLIENT_ID_LENGTH>& clientId) const;
 };
 
@@ -1,5 +1,4 @@
 #include "ClientPacket.h"
-#include <WinSock2.h>
 #include <stdexcept>
 
 ClientPacketHeader::ClientPacketHeader()
@@ -17,23 +16,21 @@ ClientPacket::ClientPacket() : header(), payload() {}
 
 ClientPacket::ClientPacket(uint16_t opCode, const std::vector<uint8_t>& data, const std::array<uint8_t, CLIENT_ID_LENGTH>& id)
     : header(opCode, data.size(), id), payload(data) {}
-    //
+
+ClientPacket::ClientPacket(uint16_t opCode, std::vector<uint8_t>&& data, const std::array<uint8_t, CLIENT_ID_LENGTH>& id)
+    : header(opCode, static_cast<uint32_t>(data.size()), id), payload(std::move(data)) {}
+//
+std::array<uint8_t, CLIENT_HEADER_SIZE> ClientPacket::encodeHeader() const
+{
+    return ClientHeaderCodec::encode(header);
+}
+//
 std::vector<uint8_t> ClientPacket::serialize() const
 {
-     size_t pos = 0;
     std::vector<uint8_t> buffer(CLIENT_HEADER_SIZE + payload.size());
+    std::array<uint8_t, CLIENT_HEADER_SIZE> headerBytes = encodeHeader();
     //
-    std::memcpy(buffer.data(), header.clientId.data(), CLIENT_ID_LENGTH);
-    buffer[CLIENT_ID_LENGTH] = header.version;
-    pos += CLIENT_ID_LENGTH + VERSION_LENGTH;
-    //
-    uint16_t netCode = htons(header.code);
-    std::memcpy(buffer.data() + pos, &netCode, CODE_LENGTH);
-    pos += CODE_LENGTH;
-    //
-    uint32_t payloadSize = htonl(header.payloadSize);
-    std::memcpy(buffer.data() + pos, &payloadSize, PAYLOAD_SIZE_LENGTH);
-    //
+    std::memcpy(buffer.data(), headerBytes.data(), CLIENT_HEADER_SIZE);
     std::memcpy(buffer.data() + CLIENT_HEADER_SIZE, payload.data(), payload.size());
     //
     return buffer;
@@ -1,5 +1,6 @@
 #pragma once
 #include "Utility.h"
+#include "WireHeader.h"
 #include <cstring>
 
 struct ClientPacketHeader
@@ -12,6 +13,17 @@ struct ClientPacketHeader
     ClientPacketHeader();
     ClientPacketHeader(uint16_t opCode, uint32_t size, const std::array<uint8_t, CLIENT_ID_LENGTH>& id);
 };
+//
+// Wire layout of the request header, integers in network byte order
+using ClientHeaderCodec = WireLayout<
+    WireField<&ClientPacketHeader::clientId>,
+    WireField<&ClientPacketHeader::version>,
+    WireField<&ClientPacketHeader::code, ByteOrder::Big>,
+    WireField<&ClientPacketHeader::payloadSize, ByteOrder::Big>>;
+static_assert(ClientHeaderCodec::size == CLIENT_HEADER_SIZE);
+static_assert(ClientHeaderCodec::offsetOf<1> == CLIENT_ID_LENGTH);
+static_assert(ClientHeaderCodec::offsetOf<2> == CLIENT_ID_LENGTH + VERSION_LENGTH);
+static_assert(ClientHeaderCodec::offsetOf<3> == PAYLOAD_SIZE_OFFSET);
 
 class ClientPacket
 {
@@ -21,7 +33,16 @@ class ClientPacket
 public:
     ClientPacket();
     ClientPacket(uint16_t opCode, const std::vector<uint8_t>& data, const std::array<uint8_t, CLIENT_ID_LENGTH>& id);
+    ClientPacket(uint16_t opCode, std::vector<uint8_t>&& data, const std::array<uint8_t, CLIENT_ID_LENGTH>& id);
     //
+    /**
+     * @brief Encodes only the header (see ClientHeaderCodec) into a fixed-size buffer,
+     * so the header and payload can be sent as a buffer sequence without copying the payload.
+     */
+    std::array<uint8_t, CLIENT_HEADER_SIZE> encodeHeader() const;
     std::vector<uint8_t> serialize() const;
+    //
+    uint16_t getCode() const { return header.code; }
+    const std::vector<uint8_t>& getPayload() const { return payload; }
 };
 
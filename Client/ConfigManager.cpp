@@ -22,45 +22,157 @@ bool ConfigManager::validatePort(const uint16_t port) const
     return (port >= MIN_PORT && port <= MAX_PORT);
 }
 
-std::optional<std::pair < std::string, uint16_t >> ConfigManager::getServerInfo() const
+std::pair<std::string, uint16_t> ConfigManager::parseEndpoint(const std::string& line) const
+{
+    size_t colonPos = line.find(':');
+    if (colonPos == std::string::npos)
+        throw std::runtime_error("Invalid server info format\n");
+    //
+    std::string ip = line.substr(0, colonPos);
+    uint16_t port = static_cast<uint16_t>(std::stoi(line.substr(colonPos + 1)));
+    //
+    if (!validateIPAdder(ip))
+        throw std::runtime_error("Invalid ip address format\n");
+    if (!validatePort(port))
+        throw std::runtime_error("Invalid port\n");
+    //
+    return std::make_pair(ip, port);
+}
+
+std::vector<std::pair<std::string, uint16_t>> ConfigManager::getServerEndpoints() const
 {
     std::ifstream file(m_serverConfigFile);
     if (!file.is_open())
         throw std::runtime_error("Failed to open file: " + m_serverConfigFile);
     //
-    file.clear();
-    file.seekg(0, std::ios::beg);
-    //
+    std::vector<std::pair<std::string, uint16_t>> endpoints;
     std::string line;
-    if (!std::getline(file, line))
+    while (std::getline(file, line))
     {
+        // Skip blank lines and key=value options
+        if (line.find_first_not_of(" \t\r") == std::string::npos || line.find('=') != std::string::npos)
+            continue;
+        endpoints.push_back(parseEndpoint(line));
+    }
+    //
+    if (endpoints.empty())
         throw std::runtime_error(m_serverConfigFile + " empty or invalid\n");
+    return endpoints;
+}
+
+std::optional<std::string> ConfigManager::getServerOption(const std::string& key) const
+{
+    std::ifstream file(m_serverConfigFile);
+    if (!file.is_open())
         return std::nullopt;
-    }
     //
-    size_t colonPos = line.find(':');
-    if (colonPos == std::string::npos)
+    std::string line;
+    while (std::getline(file, line))
     {
-        throw std::runtime_error("Invalid server info format\n");
-        return std::nullopt;
+        size_t equalsPos = line.find('=');
+        if (equalsPos != std::string::npos && line.substr(0, equalsPos) == key)
+            return line.substr(equalsPos + 1);
     }
+    return std::nullopt;
+}
+
+size_t ConfigManager::getConnectionCount() const
+{
+    std::optional<std::string> value = getServerOption("connections");
+    if (!value)
+        return 1;
     //
-    std::string ip = line.substr(0, colonPos);
-    uint16_t port = static_cast<uint16_t>(std::stoi(line.substr(colonPos + 1)));
+    try
+    {
+        int count = std::stoi(*value);
+        if (count >= 1 && static_cast<size_t>(count) <= MAX_CONNECTIONS)
+            return static_cast<size_t>(count);
+    }
+    catch (const std::exception&) { }
+    std::cerr << "Warning: Invalid connections option in " << m_serverConfigFile << ", using a single connection.\n";
+    return 1;
+}
+
+std::optional<uint32_t> ConfigManager::getCompressionThreshold() const
+{
+    std::optional<std::string> value = getServerOption("compression");
+    if (!value)
+        return DEFAULT_COMPRESSION_THRESHOLD;
+    if (*value == "off")
+        return std::nullopt;
     //
-    if (!validateIPAdder(ip))
+    try
     {
-        throw std::runtime_error("Invalid ip address format\n");
+        unsigned long threshold = std::stoul(*value);
+        if (threshold <= UINT32_MAX)
+            return static_cast<uint32_t>(threshold);
+    }
+    catch (const std::exception&) { }
+    std::cerr << "Warning: Invalid compression option in " << m_serverConfigFile << ", using the default threshold.\n";
+    return DEFAULT_COMPRESSION_THRESHOLD;
+}
+
+bool ConfigManager::getPushDelivery() const
+{
+    std::optional<std::string> value = getServerOption("push");
+    if (!value || *value == "on")
+        return true;
+    if (*value != "off")
+        std::cerr << "Warning: Invalid push option in " << m_serverConfigFile << ", using push delivery.\n";
+    return *value != "off";
+}
+
+bool ConfigManager::getAuthenticatedEncryption() const
+{
+    std::optional<std::string> value = getServerOption("cipher");
+    if (!value || *value == "gcm")
+        return true;
+    if (*value != "cbc")
+        std::cerr << "Warning: Invalid cipher option in " << m_serverConfigFile << ", using gcm.\n";
+    return *value != "cbc";
+}
+
+std::optional<std::pair<std::string, std::chrono::seconds>> ConfigManager::getMetricsDump() const
+{
+    std::optional<std::string> value = getServerOption("metrics");
+    if (!value)
         return std::nullopt;
+    //
+    size_t commaPos = value->find(',');
+    std::string path = value->substr(0, commaPos);
+    std::chrono::seconds interval(DEFAULT_METRICS_INTERVAL_SEC);
+    try
+    {
+        if (commaPos != std::string::npos)
+            interval = std::chrono::seconds(std::stoul(value->substr(commaPos + 1)));
+        if (!path.empty() && interval.count() > 0)
+            return std::make_pair(path, interval);
     }
-    if (!validatePort(port))
+    catch (const std::exception&) { }
+    std::cerr << "Warning: Invalid metrics option in " << m_serverConfigFile << ", metrics stay off.\n";
+    return std::nullopt;
+}
+
+TransportProfile ConfigManager::getTransportProfile() const
+{
+    TransportProfile profile;
+    std::optional<std::string> name = getServerOption("profile");
+    if (name)
     {
-        throw std::runtime_error("Invalid port\n");
-        return std::nullopt;
+        std::optional<TransportProfile> preset = TransportProfile::preset(*name);
+        if (preset)
+            profile = *preset;
+        else
+            std::cerr << "Warning: Unknown transport profile '" << *name << "', using " << profile.name << ".\n";
     }
     //
-    //
-    return std::make_pair(ip, port);
+    for (const char* key : { "tcp_nodelay", "quickack", "keepalive", "keepalive_idle", "send_buffer", "recv_buffer" })
+    {
+        std::optional<std::string> value = getServerOption(key);
+        if (value && !profile.setOption(key, *value))
+            std::cerr << "Warning: Invalid value for " << key << " in " << m_serverConfigFile << ", ignoring it.\n";
+    }
+    return profile;
 }
 
 std::optional<std::tuple<std::string, std::string, std::string>> ConfigManager::getUserInfo() const
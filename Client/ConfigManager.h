@@ -1,17 +1,20 @@
 /*
     ConfigManager class
     Handles reading configuration files: server information and user credentials.
-    - server.info: contains IP:port
+    - server.info: one or more IP:port lines, and optional key=value option lines (e.g. connections=4,
+      metrics=wire.log,10)
     - me.info: contains username, client_id (hex), and private key (base64)
 */
 #pragma once
 #include "Utility.h"
 #include "UI.h"
+#include "TransportProfile.h"
 #include <fstream>
 #include <sstream>
 #include <stdexcept>
 #include <optional>
 #include <vector>
+#include <chrono>
 
 class ConfigManager
 {
@@ -28,12 +31,54 @@ private:
      * Validates port number is in the range [1024, 65535].
      */
     bool validatePort(const uint16_t port) const;
+    /**
+     * Parses and validates an IP:port line. Throws std::runtime_error if invalid.
+     */
+    std::pair<std::string, uint16_t> parseEndpoint(const std::string& line) const;
 public:
     /**
-     * Reads the server info from the file (ip:port).
-     * @return std::optional pair of IP and port if successful.
+     * Reads every server endpoint (ip:port line) from the file, in file order.
+     * Throws std::runtime_error if the file is missing, has no endpoint, or an endpoint is invalid.
+     * @return IP and port pairs, at least one.
+     */
+    std::vector<std::pair<std::string, uint16_t>> getServerEndpoints() const;
+    /**
+     * Reads an optional key=value line from the server info file.
+     * @return The value, or std::nullopt if the key is not present.
+     */
+    std::optional<std::string> getServerOption(const std::string& key) const;
+    /**
+     * Reads the number of connections to open to the server ("connections" option).
+     * @return A value in [1, MAX_CONNECTIONS], 1 if the option is missing or invalid.
+     */
+    size_t getConnectionCount() const;
+    /**
+     * Reads the transport profile: the "profile" preset (low-latency if missing) with any per-option overrides.
+     * Unknown presets and invalid overrides are reported and ignored.
+     */
+    TransportProfile getTransportProfile() const;
+    /**
+     * Reads the compression setting ("compression" option): "off", or the smallest content size in bytes worth
+     * compressing. Missing or invalid values fall back to DEFAULT_COMPRESSION_THRESHOLD.
+     * @return The threshold, or std::nullopt if compression is turned off.
+     */
+    std::optional<uint32_t> getCompressionThreshold() const;
+    /**
+     * Reads whether new messages are pushed over a subscription ("push" option, "on" or "off").
+     * @return True unless the option is "off".
+     */
+    bool getPushDelivery() const;
+    /**
+     * Reads the message cipher ("cipher" option): "gcm" for authenticated encryption, or "cbc" for the legacy mode.
+     * @return True unless the option is "cbc"; AES-GCM is still only used if the server negotiates it.
+     */
+    bool getAuthenticatedEncryption() const;
+    /**
+     * Reads the transport metrics dump ("metrics" option): "<path>[,<interval in seconds>]".
+     * @return The file to append snapshots to and the interval (DEFAULT_METRICS_INTERVAL_SEC if not given),
+     *         or std::nullopt if the option is missing or invalid, which leaves metrics off.
      */
-    std::optional<std::pair < std::string, uint16_t >> getServerInfo() const;
+    std::optional<std::pair<std::string, std::chrono::seconds>> getMetricsDump() const;
     /**
      * Reads the user info (username, client ID, private key).
      * @return std::optional tuple of username, client ID hex, and base64 private key.
@@ -0,0 +1,315 @@
+#include "ConnectionPool.h"
+#include "PendingMessageParser.h"
+#include <future>
+
+using boost::asio::awaitable;
+
+ConnectionPool::ConnectionPool(size_t connections)
+    : m_outstanding(0), m_control(std::make_unique<NetworkManager>()), m_subscribed(false), m_delivering(false)
+{
+    for (size_t i = 1; i < connections; i++)
+    {
+        m_bulk.push_back(std::make_unique<BulkLane>());
+        m_bulk.back()->network = std::make_unique<NetworkManager>();
+    }
+}
+//
+ConnectionPool::~ConnectionPool()
+{
+    // Stop the bulk lanes and the subscription first, their coroutines report to the completion queue
+    m_bulk.clear();
+    if (m_subscribed.exchange(false))
+        m_subscription->disconnect(); // Fails the held wait, and the loop sees it should stop
+    m_subscription.reset();
+}
+//
+bool ConnectionPool::connect(const std::vector<NetworkManager::Endpoint>& endpoints)
+{
+    if (!m_control->ConnectToFastest(endpoints))
+        return false;
+    m_endpoints = endpoints;
+    //
+    NetworkManager::Endpoint fastest = m_control->currentEndpoint();
+    std::erase_if(m_bulk, [&](const std::unique_ptr<BulkLane>& lane)
+    {
+        lane->network->setEndpoints(endpoints);
+        if (lane->network->ConnectToServer(fastest.ip, fastest.port))
+            return false;
+        std::cerr << "Warning: Bulk connection failed to connect, dropping it from the pool.\n";
+        return true;
+    });
+    return true;
+}
+//
+void ConnectionPool::setTransportProfile(const TransportProfile& profile)
+{
+    m_control->setTransportProfile(profile);
+    for (const std::unique_ptr<BulkLane>& lane : m_bulk)
+        lane->network->setTransportProfile(profile);
+}
+//
+void ConnectionPool::startMetricsDump(const std::string& path, std::chrono::milliseconds interval)
+{
+    m_metricsDump.emplace(path, interval);
+    m_control->startMetricsDump(path, interval);
+    for (size_t i = 0; i < m_bulk.size(); i++)
+        m_bulk[i]->network->startMetricsDump(path + ".bulk" + std::to_string(i + 1), interval);
+    if (m_subscription)
+        m_subscription->startMetricsDump(path + ".subscription", interval);
+}
+//
+ConnectionPool::BulkLane& ConnectionPool::leastLoadedLane()
+{
+    BulkLane* best = m_bulk.front().get();
+    for (const std::unique_ptr<BulkLane>& lane : m_bulk)
+    {
+        if (lane->outstanding < best->outstanding)
+            best = lane.get();
+    }
+    return *best;
+}
+//
+void ConnectionPool::submitBulk(ClientPacket packet, BulkHandler onComplete)
+{
+    std::shared_ptr<const ClientPacket> shared = std::make_shared<const ClientPacket>(std::move(packet));
+    submitBulkTask([shared](NetworkManager& network) { return exchange(network, shared); }, std::move(onComplete));
+}
+//
+awaitable<std::optional<ServerPacket>> ConnectionPool::exchange(NetworkManager& network, std::shared_ptr<const ClientPacket> packet)
+{
+    std::optional<ServerPacket> response;
+    if (co_await network.asyncSendPacket(*packet))
+        response = co_await network.asyncReceivePacket();
+    co_return response;
+}
+//
+void ConnectionPool::submitBulkTask(BulkTask task, BulkHandler onComplete)
+{
+    if (m_bulk.empty())
+    {
+        std::future<std::optional<ServerPacket>> result =
+            boost::asio::co_spawn(m_control->getExecutor(), task(*m_control), boost::asio::use_future);
+        onComplete(result.get());
+        return;
+    }
+    //
+    {
+        std::lock_guard<std::mutex> lock(m_completedMutex);
+        m_outstanding++;
+    }
+    BulkLane& lane = leastLoadedLane();
+    lane.outstanding++;
+    boost::asio::post(lane.network->getExecutor(),
+        [this, &lane, job = BulkJob{ std::move(task), std::move(onComplete) }]() mutable
+    {
+        lane.queue.push_back(std::move(job));
+        if (!lane.running)
+        {
+            lane.running = true;
+            boost::asio::co_spawn(lane.network->getExecutor(), runLane(lane), boost::asio::detached);
+        }
+    });
+}
+//
+awaitable<void> ConnectionPool::runLane(BulkLane& lane)
+{
+    while (!lane.queue.empty())
+    {
+        BulkJob job = std::move(lane.queue.front());
+        lane.queue.pop_front();
+        //
+        std::optional<ServerPacket> response = co_await job.task(*lane.network);
+        lane.outstanding--;
+        complete(std::move(job.onComplete), std::move(response));
+    }
+    lane.running = false;
+}
+//
+bool ConnectionPool::subscribe(const std::array<uint8_t, CLIENT_ID_LENGTH>& clientId, MessageHandler onMessages,
+    BacklogHandler onBacklog)
+{
+    if (m_subscribed)
+        return true;
+    //
+    // Waits are held by the server for up to the wait timeout, reads must outlast them
+    m_subscription = std::make_unique<NetworkManager>();
+    NetworkManager::Deadlines deadlines = m_subscription->getDeadlines();
+    deadlines.read += std::chrono::milliseconds(DEFAULT_WAIT_TIMEOUT_MS);
+    m_subscription->setDeadlines(deadlines);
+    m_subscription->setTransportProfile(m_control->getTransportProfile());
+    m_subscription->setEndpoints(m_endpoints);
+    if (m_metricsDump)
+        m_subscription->startMetricsDump(m_metricsDump->first + ".subscription", m_metricsDump->second);
+    //
+    NetworkManager::Endpoint endpoint = m_control->currentEndpoint();
+    if (!m_subscription->ConnectToServer(endpoint.ip, endpoint.port))
+    {
+        std::cerr << "Warning: Subscription connection failed to connect, messages must be fetched manually.\n";
+        m_subscription.reset();
+        return false;
+    }
+    m_subscribed = true;
+    boost::asio::co_spawn(m_subscription->getExecutor(), runSubscription(clientId, std::move(onMessages), std::move(onBacklog)),
+        boost::asio::detached);
+    return true;
+}
+//
+awaitable<void> ConnectionPool::runSubscription(std::array<uint8_t, CLIENT_ID_LENGTH> clientId, MessageHandler onMessages,
+    BacklogHandler onBacklog)
+{
+    NetworkManager& network = *m_subscription;
+    boost::asio::steady_timer retryTimer(network.getExecutor());
+    uint32_t queued = 0; // ID of the last message queued for dispatch
+    m_delivering = false;
+    while (m_subscribed)
+    {
+        // A wait acknowledges (deletes) everything up to its cursor, so the next one is only sent once the
+        // dispatching thread has handled what was queued so far. Until then those messages stay on the server.
+        if (m_delivering)
+        {
+            retryTimer.expires_after(SUBSCRIPTION_ACK_POLL);
+            co_await retryTimer.async_wait(boost::asio::use_awaitable);
+            continue;
+        }
+        ClientPacket packet = encodeRequest(ReqWaitMessages{ ReqPendingPage{ queued } }, clientId);
+        std::shared_ptr<ReceivedPage> received = std::make_shared<ReceivedPage>();
+        bool handOver = false;
+        std::optional<ServerPacketHeader> header;
+        if (co_await network.asyncSendPacket(packet))
+            header = co_await receiveWaitPage(network, *received, handOver);
+        //
+        if (header && header->code != RESP_CODE_WAIT_MESSAGES)
+        {
+            std::cerr << "Warning: The server does not support message subscriptions, messages must be fetched manually.\n";
+            break;
+        }
+        if (handOver)
+        {
+            // Asking again would get the same page: the dispatching thread fetches it page by page instead.
+            // The wait acknowledged nothing beyond `queued`, so that fetch starts with the first message of this page.
+            m_delivering = true;
+            std::lock_guard<std::mutex> lock(m_completedMutex);
+            m_completed.emplace_back([this, onBacklog](const std::optional<ServerPacket>&)
+            {
+                onBacklog();
+                m_delivering = false;
+            }, std::nullopt);
+            continue;
+        }
+        if (!header)
+        {
+            if (!m_subscribed)
+                break;
+            // Lost connections reconnect in the background, retry once that had a chance
+            retryTimer.expires_after(SUBSCRIPTION_RETRY_DELAY);
+            co_await retryTimer.async_wait(boost::asio::use_awaitable);
+            continue;
+        }
+        if (received->page.messages.empty())
+            continue; // The wait timed out
+        //
+        queued = received->page.messages.back().messageId;
+        m_delivering = true;
+        std::lock_guard<std::mutex> lock(m_completedMutex);
+        m_completed.emplace_back([this, onMessages, received](const std::optional<ServerPacket>&)
+        {
+            onMessages(received->page);
+            m_delivering = false; // shown, the next wait may acknowledge it
+        }, std::nullopt);
+    }
+    m_subscribed = false;
+}
+//
+awaitable<std::optional<ServerPacketHeader>> ConnectionPool::receiveWaitPage(NetworkManager& network,
+    ReceivedPage& received, bool& handOver)
+{
+    // Content is copied out of the stream into the page, up to the byte budget of one page
+    size_t contentBytes = 0;
+    PendingMessageParser parser({
+        [&](const PendingMessage& header, uint32_t contentSize)
+        {
+            contentBytes += contentSize;
+            if (contentBytes > PENDING_PAGE_MAX_BYTES)
+            {
+                handOver = true;
+                return;
+            }
+            received.page.messages.push_back(header);
+            received.contents.emplace_back().reserve(contentSize);
+        },
+        [&](std::span<const uint8_t> piece)
+        {
+            if (!handOver)
+                received.contents.back().insert(received.contents.back().end(), piece.begin(), piece.end());
+        },
+        [&]
+        {
+            if (!handOver)
+                received.page.messages.back().content = received.contents.back();
+        } });
+    //
+    bool flagRead = false;
+    std::optional<ServerPacketHeader> header = co_await network.asyncReceivePacketStreaming(
+        [&](const ServerPacketHeader& hdr, std::span<const uint8_t> chunk)
+        {
+            if (hdr.code != RESP_CODE_WAIT_MESSAGES)
+                return true; // drained, the caller looks at the code
+            if (!flagRead)
+            {
+                parser.setProtocolVersion(hdr.version); // record encoding the server chose
+                received.page.hasMore = chunk[0] != 0;
+                chunk = chunk.subspan(PAGE_HAS_MORE_LEN);
+                flagRead = true;
+            }
+            try
+            {
+                parser.feed(chunk);
+            }
+            catch (const std::runtime_error&)
+            {
+                handOver = true;
+            }
+            return !handOver; // once over budget, the rest is only read and discarded
+        });
+    if (header && header->code == RESP_CODE_WAIT_MESSAGES && (!flagRead || !parser.atMessageBoundary()))
+        handOver = true;
+    co_return handOver ? std::nullopt : header;
+}
+//
+void ConnectionPool::complete(BulkHandler handler, std::optional<ServerPacket> response)
+{
+    {
+        std::lock_guard<std::mutex> lock(m_completedMutex);
+        m_completed.emplace_back(std::move(handler), std::move(response));
+        m_outstanding--;
+    }
+    m_completedCv.notify_all();
+}
+//
+size_t ConnectionPool::dispatchCompleted()
+{
+    std::deque<std::pair<BulkHandler, std::optional<ServerPacket>>> completed;
+    {
+        std::lock_guard<std::mutex> lock(m_completedMutex);
+        completed.swap(m_completed);
+    }
+    // Handlers run unlocked, they may submit more bulk requests
+    for (std::pair<BulkHandler, std::optional<ServerPacket>>& entry : completed)
+        entry.first(entry.second);
+    return completed.size();
+}
+//
+void ConnectionPool::waitForBulk()
+{
+    {
+        std::unique_lock<std::mutex> lock(m_completedMutex);
+        m_completedCv.wait(lock, [this]() { return m_outstanding == 0; });
+    }
+    dispatchCompleted();
+}
+//
+size_t ConnectionPool::pendingBulk()
+{
+    std::lock_guard<std::mutex> lock(m_completedMutex);
+    return m_outstanding;
+}
@@ -0,0 +1,192 @@
+/**
+ * ConnectionPool.h
+ * A set of connections to the same server: one control connection for small request/response commands
+ * and optional bulk connections for large uploads, so a big transfer never queues in front of a command.
+ *
+ * Each connection is a NetworkManager with its own socket and I/O thread. Bulk requests are queued on the
+ * least loaded bulk connection and run in the background; their completion handlers are collected and run
+ * on the caller's thread by dispatchCompleted/waitForBulk, so they never race with the UI.
+ * With a single connection there is no bulk lane, and bulk requests run synchronously on the control connection.
+ *
+ * A subscription adds one more connection that keeps a long-poll request (ReqWaitMessages) open, so new
+ * messages arrive without polling. Its deliveries go through the same completion queue as bulk requests.
+ * It streams each page in and buffers at most PENDING_PAGE_MAX_BYTES of content; larger (or malformed) pages
+ * are handed over to the caller, which fetches them with the paged streaming requests instead.
+ */
+
+#pragma once
+#include "NetworkManager.h"
+#include <vector>
+#include <deque>
+#include <mutex>
+#include <condition_variable>
+
+class ConnectionPool
+{
+public:
+    /**
+     * Completion handler of a bulk request, called with the response (std::nullopt if the request failed).
+     */
+    using BulkHandler = std::function<void(const std::optional<ServerPacket>&)>;
+    /**
+     * A bulk operation made of several exchanges (e.g. a chunked file upload), run on the I/O thread of the
+     * connection it is given. Its result is passed to the completion handler.
+     */
+    using BulkTask = std::function<boost::asio::awaitable<std::optional<ServerPacket>>(NetworkManager&)>;
+    /**
+     * Handler of the messages delivered by the subscription, called with every page that holds messages.
+     */
+    using MessageHandler = std::function<void(const RespPendingPage&)>;
+    /**
+     * Handler called instead when the subscription cannot buffer what is waiting. It must fetch the pending
+     * messages itself (pages of ReqPendingPage, streamed), since the subscription does not ask for them again.
+     */
+    using BacklogHandler = std::function<void()>;
+    /**
+     * Wait before asking again after a failed long-poll request.
+     */
+    static constexpr std::chrono::milliseconds SUBSCRIPTION_RETRY_DELAY{ 1000 };
+    /**
+     * How often the subscription checks whether the messages it queued were shown, before it asks for more.
+     */
+    static constexpr std::chrono::milliseconds SUBSCRIPTION_ACK_POLL{ 50 };
+
+private:
+    /**
+     * A page received by the subscription, owning the contents its messages point into.
+     */
+    struct ReceivedPage
+    {
+        RespPendingPage                  page;
+        std::deque<std::vector<uint8_t>> contents; //< One per message, in order; a deque never moves them
+    };
+    struct BulkJob
+    {
+        BulkTask    task;
+        BulkHandler onComplete;
+    };
+    /**
+     * A bulk connection and the requests queued on it. `queue` and `running` are only touched on the
+     * connection's I/O thread. `network` is declared last so its I/O thread is joined before the queue is destroyed.
+     */
+    struct BulkLane
+    {
+        std::deque<BulkJob>             queue;
+        bool                            running = false; //< A runLane coroutine is draining the queue
+        std::atomic<size_t>             outstanding{ 0 }; //< Submitted and not yet completed
+        std::unique_ptr<NetworkManager> network;
+    };
+    //
+    std::mutex                      m_completedMutex;
+    std::condition_variable         m_completedCv;
+    std::deque<std::pair<BulkHandler, std::optional<ServerPacket>>> m_completed; //< Finished bulk requests, not dispatched yet
+    size_t                          m_outstanding; //< Bulk requests not finished yet, guarded by m_completedMutex
+    //
+    std::unique_ptr<NetworkManager>        m_control; //< Commands and their responses
+    std::vector<std::unique_ptr<BulkLane>> m_bulk; //< Large uploads, may be empty
+    std::vector<NetworkManager::Endpoint>  m_endpoints; //< Failover candidates, for connections opened later
+    std::unique_ptr<NetworkManager>        m_subscription; //< Long-polls for new messages, if subscribed
+    std::atomic<bool>                      m_subscribed; //< The subscription is running
+    std::atomic<bool>                      m_delivering; //< Queued subscription messages (or a backlog) not handled yet
+    std::optional<std::pair<std::string, std::chrono::milliseconds>> m_metricsDump; //< Path and interval, if dumping metrics
+    //
+    /**
+     * @brief Sends the queued requests of a lane one at a time, each followed by its response. Runs on the lane's I/O thread.
+     */
+    boost::asio::awaitable<void> runLane(BulkLane& lane);
+    /**
+     * @brief Hands a finished bulk request over to the dispatching thread.
+     */
+    void complete(BulkHandler handler, std::optional<ServerPacket> response);
+    /**
+     * @brief Sends one request and reads its response: the task behind submitBulk.
+     */
+    static boost::asio::awaitable<std::optional<ServerPacket>> exchange(NetworkManager& network, std::shared_ptr<const ClientPacket> packet);
+    /**
+     * @brief Keeps one long-poll request open at a time and queues every page that holds messages for dispatch.
+     * Each request acknowledges the messages shown so far, and is only sent once every queued page was shown.
+     * Runs on the subscription's I/O thread until the server turns out not to support long-polling.
+     */
+    boost::asio::awaitable<void> runSubscription(std::array<uint8_t, CLIENT_ID_LENGTH> clientId, MessageHandler onMessages,
+        BacklogHandler onBacklog);
+    /**
+     * @brief Receives the response to a wait, buffering its messages into `received` as they stream in.
+     * @param handOver Set if the page holds more than PENDING_PAGE_MAX_BYTES of content or is malformed.
+     * @return The response header, or std::nullopt if the exchange failed or the page was handed over.
+     */
+    static boost::asio::awaitable<std::optional<ServerPacketHeader>> receiveWaitPage(NetworkManager& network,
+        ReceivedPage& received, bool& handOver);
+    /**
+     * @brief The bulk lane with the fewest outstanding requests.
+     */
+    BulkLane& leastLoadedLane();
+
+public:
+    /**
+     * @param connections Total number of connections, at least 1. Everything beyond the control connection is a bulk lane.
+     */
+    explicit ConnectionPool(size_t connections);
+    ~ConnectionPool();
+    //
+    /**
+     * @brief Races the control connection to all endpoints (see NetworkManager::asyncConnectFastest), then connects
+     * the bulk connections to the endpoint that won. Every connection fails over to the other endpoints.
+     * Bulk connections that fail to connect are dropped from the pool, and their traffic goes to the remaining ones.
+     * @return True if the control connection is connected, false otherwise.
+     */
+    bool connect(const std::vector<NetworkManager::Endpoint>& endpoints);
+    /**
+     * @brief The connection used for ordinary commands.
+     */
+    NetworkManager& control() { return *m_control; }
+    /**
+     * @brief Sets the socket options of every connection in the pool.
+     */
+    void setTransportProfile(const TransportProfile& profile);
+    /**
+     * @brief Records transport metrics on every connection of the pool and appends snapshots every `interval`:
+     * the control connection's to `path`, the others' to `path` with a suffix naming the connection
+     * (".bulk1", ... and ".subscription"). Connections opened later are included.
+     */
+    void startMetricsDump(const std::string& path, std::chrono::milliseconds interval);
+    /**
+     * @brief Number of connections in the pool, including the control connection.
+     */
+    size_t size() const { return 1 + m_bulk.size(); }
+    /**
+     * @brief Sends a request and reads its response on a bulk connection, in the background.
+     * `onComplete` runs later, from dispatchCompleted or waitForBulk on the calling thread.
+     * Without bulk connections the request runs synchronously on the control connection and `onComplete` runs before returning.
+     */
+    void submitBulk(ClientPacket packet, BulkHandler onComplete);
+    /**
+     * @brief Runs a bulk task on a bulk connection, in the background, queued like submitBulk requests.
+     * `onComplete` runs later with the task's result, from dispatchCompleted or waitForBulk on the calling thread.
+     * Without bulk connections the task runs synchronously on the control connection.
+     */
+    void submitBulkTask(BulkTask task, BulkHandler onComplete);
+    /**
+     * @brief Runs the handlers of bulk requests that have finished since the last call. Never blocks.
+     * @return Number of handlers run.
+     */
+    size_t dispatchCompleted();
+    /**
+     * @brief Blocks until every submitted bulk request has finished, then runs their handlers.
+     */
+    void waitForBulk();
+    /**
+     * @brief Number of bulk requests submitted and not finished yet.
+     */
+    size_t pendingBulk();
+    /**
+     * @brief Opens the subscription connection and starts long-polling for messages sent to `clientId`.
+     * `onMessages` and `onBacklog` run from dispatchCompleted or waitForBulk on the calling thread, like bulk
+     * completion handlers. Delivered messages are acknowledged (deleted on the server) once they were shown.
+     * @return True if the subscription connection is connected.
+     */
+    bool subscribe(const std::array<uint8_t, CLIENT_ID_LENGTH>& clientId, MessageHandler onMessages, BacklogHandler onBacklog);
+    /**
+     * @brief Whether new messages currently arrive through the subscription.
+     */
+    bool subscribed() const { return m_subscribed; }
+};
@@ -0,0 +1,50 @@
+#include "DeflateWrapper.h"
+
+#include <zdeflate.h>
+#include <zinflate.h>
+#include <filters.h>
+
+#include <algorithm>
+#include <stdexcept>
+
+
+static const size_t INFLATE_INPUT_CHUNK = 4096;	// bounds the output produced between size checks
+
+
+std::string DeflateWrapper::compress(std::span<const uint8_t> data)
+{
+	std::string compressed;
+	CryptoPP::Deflator deflator(new CryptoPP::StringSink(compressed), CryptoPP::Deflator::DEFAULT_DEFLATE_LEVEL);
+	deflator.Put(data.data(), data.size());
+	deflator.MessageEnd();
+
+	return compressed;
+}
+
+
+std::string DeflateWrapper::decompress(std::span<const uint8_t> data, size_t maxSize)
+{
+	std::string decompressed;
+	CryptoPP::Inflator inflator;
+
+	// Feed the input in chunks and drain the output after each one, so a hostile input is rejected
+	// before it can expand into a huge buffer
+	auto drain = [&]()
+	{
+		size_t available = inflator.MaxRetrievable();
+		if (available > maxSize - decompressed.size())
+			throw std::runtime_error("decompressed content exceeds the size limit");
+		size_t offset = decompressed.size();
+		decompressed.resize(offset + available);
+		inflator.Get(reinterpret_cast<CryptoPP::byte*>(&decompressed[offset]), available);
+	};
+	for (size_t offset = 0; offset < data.size(); offset += INFLATE_INPUT_CHUNK)
+	{
+		inflator.Put(data.data() + offset, std::min(INFLATE_INPUT_CHUNK, data.size() - offset));
+		drain();
+	}
+	inflator.MessageEnd();
+	drain();
+
+	return decompressed;
+}
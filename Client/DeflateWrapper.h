@@ -0,0 +1,15 @@
+#pragma once
+
+#include <string>
+#include <span>
+#include <cstdint>
+
+
+class DeflateWrapper
+{
+public:
+	// Compresses data with raw deflate (RFC 1951)
+	static std::string compress(std::span<const uint8_t> data);
+	// Inflates data produced by compress(). Throws std::runtime_error if the result would exceed maxSize bytes.
+	static std::string decompress(std::span<const uint8_t> data, size_t maxSize);
+};
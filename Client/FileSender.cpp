@@ -0,0 +1,166 @@
+#include "FileSender.h"
+#include "DeflateWrapper.h"
+#include <algorithm>
+#include <random>
+
+FileSender::FileSender(std::string filePath, uint64_t fileSize, const std::array<uint8_t, CLIENT_ID_LENGTH>& recipientId,
+    const std::array<uint8_t, CLIENT_ID_LENGTH>& senderId, const std::vector<uint8_t>& symmetricKey,
+    std::optional<uint32_t> compressionThreshold, SegmentedCipher& workers, ChunkCipher chunkCipher)
+    : m_filePath(std::move(filePath)), m_fileSize(fileSize), m_recipientId(recipientId), m_senderId(senderId),
+      m_cipher(symmetricKey.data(), static_cast<unsigned int>(symmetricKey.size())), m_compressionThreshold(compressionThreshold),
+      m_workers(workers), m_chunkCipher(chunkCipher)
+{
+    std::random_device rd;
+    m_fileId = (static_cast<uint64_t>(rd()) << 32) | rd();
+}
+//
+std::string FileSender::sealChunk(std::span<const uint8_t> plain, uint64_t offset, bool& compressed) const
+{
+    compressed = false;
+    std::string deflated;
+    if (m_compressionThreshold && plain.size() >= *m_compressionThreshold)
+    {
+        deflated = DeflateWrapper::compress(plain);
+        compressed = deflated.size() < plain.size();
+    }
+    if (m_chunkCipher == ChunkCipher::SegmentedCtr)
+    {
+        // CTR keeps the length; a deflated chunk is shorter, so it never reaches into the next chunk's keystream
+        std::string sealed = compressed ? std::move(deflated) : std::string(plain.begin(), plain.end());
+        SegmentedCipher::applySegment(m_cipher.getKey(), m_fileId, offset,
+            std::span<uint8_t>(reinterpret_cast<uint8_t*>(sealed.data()), sealed.size()));
+        return sealed;
+    }
+    AESWrapper cipher(m_cipher.getKey(), AESWrapper::DEFAULT_KEYLENGTH);
+    const char* data = compressed ? deflated.data() : reinterpret_cast<const char*>(plain.data());
+    const unsigned int length = static_cast<unsigned int>(compressed ? deflated.size() : plain.size());
+    if (m_chunkCipher == ChunkCipher::Gcm)
+    {
+        FileChunkHeader header = chunkHeader(offset, static_cast<uint32_t>(plain.size()));
+        return cipher.encryptAuthenticated(data, length, header.gcmNonce().data(), header.encoded().data(), FILE_CHUNK_HEADER_LEN);
+    }
+    return cipher.encrypt(data, length);
+}
+//
+FileChunkHeader FileSender::chunkHeader(uint64_t offset, uint32_t length) const
+{
+    return FileChunkHeader{ m_fileId, offset, length, m_fileSize };
+}
+//
+std::vector<FileSender::SealedChunk> FileSender::windowAt(uint64_t offset) const
+{
+    const size_t windowChunks = std::clamp<size_t>(m_workers.getThreadCount(), 1, MAX_WINDOW_CHUNKS);
+    std::vector<SealedChunk> window;
+    for (; offset < m_fileSize && window.size() < windowChunks; offset += FILE_CHUNK_SIZE)
+    {
+        SealedChunk chunk;
+        chunk.offset = offset;
+        chunk.length = static_cast<uint32_t>(std::min<uint64_t>(FILE_CHUNK_SIZE, m_fileSize - offset));
+        window.push_back(std::move(chunk));
+    }
+    return window;
+}
+//
+std::future<void> FileSender::sealAsync(std::vector<SealedChunk>& window)
+{
+    SealedChunk* chunks = window.data();
+    return m_workers.forEachAsync(window.size(), [this, chunks](size_t index)
+    {
+        SealedChunk& chunk = chunks[index];
+        std::vector<uint8_t> plain(chunk.length);
+        {
+            std::lock_guard<std::mutex> lock(m_fileMutex);
+            m_file.seekg(static_cast<std::streamoff>(chunk.offset));
+            if (!m_file.read(reinterpret_cast<char*>(plain.data()), chunk.length))
+            {
+                m_file.clear();
+                throw std::runtime_error("reading " + m_filePath + " failed at offset " + std::to_string(chunk.offset));
+            }
+        }
+        chunk.sealed = sealChunk(plain, chunk.offset, chunk.compressed);
+    });
+}
+//
+boost::asio::awaitable<std::optional<ServerPacket>> FileSender::run(NetworkManager& network)
+{
+    m_file.open(m_filePath, std::ios::binary);
+    if (!m_file)
+    {
+        std::cerr << "Error: Cannot open " << m_filePath << " for sending.\n";
+        co_return std::nullopt;
+    }
+    //
+    // Sealing jobs use m_file and the windows: whatever way this returns, it waits for them first
+    std::future<void> sealing;
+    struct SealingGuard
+    {
+        std::future<void>& sealing;
+        ~SealingGuard() { if (sealing.valid()) sealing.wait(); }
+    };
+    std::vector<SealedChunk> current = windowAt(0);
+    std::vector<SealedChunk> next;
+    SealingGuard guard{ sealing };
+    sealing = sealAsync(current);
+    //
+    std::optional<ServerPacket> lastAck;
+    unsigned resumes = 0;
+    while (true)
+    {
+        try
+        {
+            sealing.get();
+        }
+        catch (const std::exception& e)
+        {
+            std::cerr << "Error: Sealing a chunk of " << m_filePath << " failed: " << e.what() << "\n";
+            co_return std::nullopt;
+        }
+        if (current.empty()) // resumed with nothing left to send
+            co_return lastAck;
+        //
+        // Seal the next window while this one is on the wire
+        next = windowAt(current.back().offset + current.back().length);
+        sealing = sealAsync(next);
+        std::vector<ReqSendFileChunk> requests(current.size());
+        for (size_t i = 0; i < current.size(); ++i)
+        {
+            requests[i].targetId = m_recipientId;
+            requests[i].messageType = MSG_TYPE_SEND_FILE | MSG_FLAG_CHUNKED | (current[i].compressed ? MSG_FLAG_COMPRESSED : 0) |
+                (m_chunkCipher == ChunkCipher::Gcm ? MSG_FLAG_AEAD : 0) | (m_chunkCipher == ChunkCipher::SegmentedCtr ? MSG_FLAG_SEGMENTED : 0);
+            requests[i].header = chunkHeader(current[i].offset, current[i].length);
+            requests[i].encryptedChunk = asBytes(current[i].sealed);
+        }
+        std::vector<MessageReply<ReqSendFileChunk>> acks = co_await network.asyncCallAll(std::move(requests), m_senderId);
+        size_t acked = 0;
+        for (; acked < acks.size() && acks[acked]; ++acked)
+            lastAck = std::move(acks[acked].packet);
+        if (acked == acks.size())
+        {
+            if (next.empty())
+                co_return lastAck;
+            current = std::move(next);
+            continue;
+        }
+        //
+        // Lost or refused: ask the server how far it got (once reconnected) and go on from there
+        uint64_t offset = current[acked].offset;
+        if (++resumes > MAX_RESUMES)
+        {
+            std::cerr << "Error: Sending " << m_filePath << " failed too often, giving up at offset " << offset << ".\n";
+            co_return std::nullopt;
+        }
+        ReqFileProgress progressRequest{ m_recipientId, m_fileId };
+        MessageReply<ReqFileProgress> progress = co_await network.asyncCall(progressRequest, m_senderId);
+        // The server forgets a transfer once its final chunk is stored: an unknown transfer after an acknowledged
+        // chunk means every chunk got through and only acknowledgements were lost
+        if (progress && progress->totalSize == 0 && offset > 0)
+            co_return lastAck;
+        if (progress && progress->received <= m_fileSize)
+            offset = progress->received;
+        std::cerr << "Warning: Resuming " << m_filePath << " at offset " << offset << ".\n";
+        //
+        sealing.wait();
+        current = windowAt(offset);
+        sealing = sealAsync(current);
+    }
+}
@@ -0,0 +1,102 @@
+/*
+    FileSender.h
+
+    Uploads a file larger than one chunk as a chunked file transfer: fixed-size plaintext chunks, each
+    (optionally deflated and) encrypted on its own and sent as a file message that starts with a
+    FileChunkHeader. With AES-GCM every chunk is sealed under a nonce derived from the file ID and the
+    chunk index, with its header as associated data, so a chunk cannot be altered, moved or relabelled. Chunks go in windows of up to one per worker thread (at most MAX_WINDOW_CHUNKS):
+    the chunks of a window are read and sealed in parallel on the worker pool, then sent back to back
+    with their acknowledgements read after the last one, and the next window is sealed while the
+    current one is on the wire. At most two windows are held in memory. When a chunk fails (connection
+    lost, server refused it), the sender asks the server how far the transfer got and resumes from
+    there, after the connection has reconnected.
+*/
+
+#pragma once
+#include "NetworkManager.h"
+#include "AESWrapper.h"
+#include "SegmentedCipher.h"
+#include <fstream>
+#include <future>
+#include <mutex>
+#include <string>
+#include <vector>
+#include <optional>
+
+class FileSender
+{
+public:
+    static constexpr unsigned MAX_RESUMES = 5; //< Failed chunks tolerated per transfer before giving up
+    static constexpr size_t MAX_WINDOW_CHUNKS = 16; //< Most chunks sealed and sent per window
+    /**
+     * How chunks are encrypted; the first one the server and the recipient both handle is used.
+     */
+    enum class ChunkCipher
+    {
+        Gcm,          //< AES-GCM per chunk (MSG_FLAG_AEAD), authenticating the chunk header too
+        SegmentedCtr, //< One AES-CTR keystream over the file (MSG_FLAG_SEGMENTED)
+        Cbc           //< AES-CBC per chunk
+    };
+private:
+    /**
+     * One chunk of a window: where it is in the file and, once sealed, what goes on the wire.
+     */
+    struct SealedChunk
+    {
+        uint64_t    offset = 0;
+        uint32_t    length = 0;
+        bool        compressed = false;
+        std::string sealed;
+    };
+    //
+    std::string                           m_filePath;
+    uint64_t                              m_fileSize;
+    uint64_t                              m_fileId; //< Random, identifies the transfer to the server and receiver
+    std::array<uint8_t, CLIENT_ID_LENGTH> m_recipientId;
+    std::array<uint8_t, CLIENT_ID_LENGTH> m_senderId;
+    AESWrapper                            m_cipher; //< Holds the key; sealing jobs key their own copy (not thread-safe)
+    std::optional<uint32_t>               m_compressionThreshold; //< Set if compression was negotiated
+    SegmentedCipher&                      m_workers; //< Reads and seals the chunks of a window in parallel
+    ChunkCipher                           m_chunkCipher;
+    std::ifstream                         m_file; //< Open while run() is
+    std::mutex                            m_fileMutex; //< Sealing jobs read m_file one at a time
+    //
+    /**
+     * @brief Encrypts one plaintext chunk, deflating it first if that was negotiated and makes it smaller.
+     * Runs on a worker thread, in parallel with the other chunks of the window.
+     * @param offset Position of the chunk in the file: selects the keystream position (AES-CTR) or the nonce (AES-GCM).
+     * @param compressed Set to whether the chunk was deflated.
+     */
+    std::string sealChunk(std::span<const uint8_t> plain, uint64_t offset, bool& compressed) const;
+    /**
+     * @brief The header the chunk at `offset` is sent with.
+     */
+    FileChunkHeader chunkHeader(uint64_t offset, uint32_t length) const;
+    /**
+     * @brief The chunks of the window that starts at `offset`, not read yet.
+     */
+    std::vector<SealedChunk> windowAt(uint64_t offset) const;
+    /**
+     * @brief Reads and seals every chunk of `window` on the worker pool, one job per chunk.
+     * @return Becomes ready when all of them are sealed; throws std::runtime_error if reading the file failed.
+     * `window`'s elements must stay where they are until then (moving the vector itself is fine).
+     */
+    std::future<void> sealAsync(std::vector<SealedChunk>& window);
+public:
+    /**
+     * @param compressionThreshold Smallest chunk worth compressing, or std::nullopt if compression is not negotiated.
+     * @param workers Worker pool that reads and seals the chunks. Must outlive the transfer.
+     */
+    FileSender(std::string filePath, uint64_t fileSize, const std::array<uint8_t, CLIENT_ID_LENGTH>& recipientId,
+        const std::array<uint8_t, CLIENT_ID_LENGTH>& senderId, const std::vector<uint8_t>& symmetricKey,
+        std::optional<uint32_t> compressionThreshold, SegmentedCipher& workers, ChunkCipher chunkCipher);
+    //
+    /**
+     * @brief Sends every chunk over `network`, resuming from the server's progress after a failure.
+     * Must run on the connection's I/O thread (e.g. as a ConnectionPool bulk task).
+     * @return The acknowledgement of the last chunk, or std::nullopt if the transfer failed.
+     */
+    boost::asio::awaitable<std::optional<ServerPacket>> run(NetworkManager& network);
+    //
+    uint64_t getFileId() const { return m_fileId; }
+};
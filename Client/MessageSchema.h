@@ -0,0 +1,674 @@
+/*
+    MessageSchema.h
+
+    Typed request/response payloads for the protocol opcodes. Every request struct declares its opcode, the
+    response code it expects and its Response type, and knows its exact encoded size, so encodeRequest writes
+    the payload into a single buffer of the right size with no per-field growth. Responses decode from a
+    span of the received packet with bounds checks, and byte runs (keys, message content) stay views into
+    the packet instead of being copied.
+
+    Use NetworkManager::call for a full round trip:
+        MessageReply<ReqPublicKey> reply = net.call(ReqPublicKey{ targetId }, myId);
+        if (reply)
+            use(reply->publicKey);
+*/
+
+#pragma once
+#include "Utility.h"
+#include "ByteCodec.h"
+#include "ClientPacket.h"
+#include "ServerPacket.h"
+#include "PendingMessageParser.h"
+#include <optional>
+#include <span>
+#include <string>
+#include <string_view>
+#include <tuple>
+#include <vector>
+
+/**
+ * Outcome of a typed request.
+ */
+enum class CallStatus
+{
+    Ok,
+    SendFailed,     //< The request could not be sent
+    NoResponse,     //< The connection was lost before a response arrived
+    ServerError,    //< The server answered with RESP_CODE_ERROR
+    UnexpectedCode, //< The server answered with another response code
+    Malformed       //< The response payload did not match its schema
+};
+
+// === 600: Register ===
+struct RespRegister
+{
+    std::array<uint8_t, CLIENT_ID_LENGTH> clientId{};
+    //
+    static RespRegister decode(ByteReader& reader) { return { reader.readArray<CLIENT_ID_LENGTH>() }; }
+};
+
+struct ReqRegister
+{
+    using Response = RespRegister;
+    static constexpr uint16_t code = CODE_REGISTER_USER;
+    static constexpr uint16_t responseCode = RESP_CODE_REGISTER_SUCCCESS;
+    //
+    std::string_view         username;
+    std::span<const uint8_t> publicKey; //< REGISTER_PUBLIC_KEY_LEN bytes
+    //
+    size_t encodedSize() const { return REGISTER_USERNAME_LEN + REGISTER_PUBLIC_KEY_LEN; }
+    void encode(ByteWriter& writer) const
+    {
+        if (publicKey.size() != REGISTER_PUBLIC_KEY_LEN)
+            throw std::runtime_error("Unexpected public key size: " + std::to_string(publicKey.size()));
+        writer.writeFixedString(username, REGISTER_USERNAME_LEN);
+        writer.writeBytes(publicKey);
+    }
+};
+
+// === 601: Client list ===
+/**
+ * @brief Decodes client list records until the reader is exhausted.
+ * Legacy records hold a zero-padded username, compact ones a length-prefixed one.
+ */
+inline std::vector<std::pair<std::string, std::array<uint8_t, CLIENT_ID_LENGTH>>> decodeClientRecords(ByteReader& reader, uint8_t version)
+{
+    std::vector<std::pair<std::string, std::array<uint8_t, CLIENT_ID_LENGTH>>> clients;
+    if (version >= PROTOCOL_VERSION_COMPACT)
+    {
+        while (!reader.empty())
+        {
+            std::array<uint8_t, CLIENT_ID_LENGTH> clientId = reader.readArray<CLIENT_ID_LENGTH>();
+            clients.emplace_back(reader.readShortString(), clientId);
+        }
+        return clients;
+    }
+    //
+    constexpr size_t recordSize = CLIENT_ID_LENGTH + REGISTER_USERNAME_LEN;
+    if (reader.remaining() % recordSize != 0)
+        throw std::runtime_error("Client list payload is not a whole number of records\n");
+    clients.reserve(reader.remaining() / recordSize);
+    while (!reader.empty())
+    {
+        std::array<uint8_t, CLIENT_ID_LENGTH> clientId = reader.readArray<CLIENT_ID_LENGTH>();
+        clients.emplace_back(reader.readFixedString(REGISTER_USERNAME_LEN), clientId);
+    }
+    return clients;
+}
+
+struct RespClientList
+{
+    std::vector<std::pair<std::string, std::array<uint8_t, CLIENT_ID_LENGTH>>> clients; //< Username and client ID
+    //
+    static RespClientList decode(ByteReader& reader, uint8_t version)
+    {
+        RespClientList response;
+        response.clients = decodeClientRecords(reader, version);
+        return response;
+    }
+};
+
+struct ReqClientList
+{
+    using Response = RespClientList;
+    static constexpr uint16_t code = CODE_REQ_USER_LIST;
+    static constexpr uint16_t responseCode = RESP_CODE_GET_CLIENT_LIST;
+    //
+    size_t encodedSize() const { return 0; }
+    void encode(ByteWriter&) const { }
+};
+
+// === 602: Public key ===
+struct RespPublicKey
+{
+    std::array<uint8_t, CLIENT_ID_LENGTH> clientId{};
+    std::span<const uint8_t>              publicKey; //< View into the response packet
+    //
+    static RespPublicKey decode(ByteReader& reader)
+    {
+        RespPublicKey response;
+        response.clientId = reader.readArray<CLIENT_ID_LENGTH>();
+        response.publicKey = reader.readRest();
+        return response;
+    }
+};
+
+struct ReqPublicKey
+{
+    using Response = RespPublicKey;
+    static constexpr uint16_t code = CODE_REQ_USER_PUBLIC_KEY;
+    static constexpr uint16_t responseCode = RESP_CODE_GET_PUBLIC_KEY;
+    //
+    std::array<uint8_t, CLIENT_ID_LENGTH> targetId{};
+    //
+    size_t encodedSize() const { return CLIENT_ID_LENGTH; }
+    void encode(ByteWriter& writer) const { writer.writeBytes(targetId); }
+};
+
+// === 603: Send message ===
+struct RespSendMessage
+{
+    std::array<uint8_t, CLIENT_ID_LENGTH> targetId{};
+    uint32_t                              messageId = 0;
+    //
+    static RespSendMessage decode(ByteReader& reader)
+    {
+        RespSendMessage response;
+        response.targetId = reader.readArray<CLIENT_ID_LENGTH>();
+        response.messageId = reader.readU32();
+        return response;
+    }
+};
+
+struct ReqSendMessage
+{
+    using Response = RespSendMessage;
+    static constexpr uint16_t code = CODE_SEND_MESSAGE_TO_USER;
+    static constexpr uint16_t responseCode = RESP_CODE_SEND_MSG_SUCCESS;
+    //
+    std::array<uint8_t, CLIENT_ID_LENGTH> targetId{};
+    uint8_t                               messageType = 0;
+    std::span<const uint8_t>              content; //< Must stay alive until the request is encoded
+    //
+    size_t encodedSize() const { return CLIENT_ID_LENGTH + MESSAGE_TYPE_LEN + MESSAGE_CONTENT_LEN + content.size(); }
+    void encode(ByteWriter& writer) const
+    {
+        writer.writeBytes(targetId);
+        writer.writeU8(messageType);
+        writer.writeU32(static_cast<uint32_t>(content.size()));
+        writer.writeBytes(content);
+    }
+};
+
+/**
+ * Starts the content of a file chunk message (MSG_FLAG_CHUNKED), in plaintext ahead of the encrypted chunk.
+ * Offsets and sizes count plaintext file bytes.
+ */
+struct FileChunkHeader
+{
+    uint64_t fileId = 0; //< Random, picked by the sender for each transfer
+    uint64_t offset = 0;
+    uint32_t length = 0; //< Plaintext bytes in this chunk
+    uint64_t totalSize = 0;
+    //
+    void encode(ByteWriter& writer) const
+    {
+        writer.writeU64(fileId);
+        writer.writeU64(offset);
+        writer.writeU32(length);
+        writer.writeU64(totalSize);
+    }
+    static FileChunkHeader decode(ByteReader& reader)
+    {
+        FileChunkHeader header;
+        header.fileId = reader.readU64();
+        header.offset = reader.readU64();
+        header.length = reader.readU32();
+        header.totalSize = reader.readU64();
+        if (header.length > header.totalSize || header.offset > header.totalSize - header.length)
+            throw std::runtime_error("File chunk past the end of its file\n");
+        return header;
+    }
+    /**
+     * @brief The header as sent; an AES-GCM chunk (MSG_FLAG_AEAD) authenticates it as associated data.
+     */
+    std::array<uint8_t, FILE_CHUNK_HEADER_LEN> encoded() const
+    {
+        std::array<uint8_t, FILE_CHUNK_HEADER_LEN> bytes;
+        ByteWriter writer(bytes);
+        encode(writer);
+        return bytes;
+    }
+    /**
+     * @brief The AES-GCM nonce of the chunk (MSG_FLAG_AEAD): the file ID and the chunk index (offset / FILE_CHUNK_SIZE),
+     * big endian. Unique under the transfer's key, since every transfer picks a new file ID.
+     */
+    std::array<uint8_t, FILE_CHUNK_NONCE_LEN> gcmNonce() const
+    {
+        std::array<uint8_t, FILE_CHUNK_NONCE_LEN> nonce;
+        ByteWriter writer(nonce);
+        writer.writeU64(fileId);
+        writer.writeU32(static_cast<uint32_t>(offset / FILE_CHUNK_SIZE));
+        return nonce;
+    }
+};
+
+/**
+ * One chunk of a file transfer: a send message request whose content is the chunk header and the encrypted chunk.
+ * The server stores chunks in order only, and acknowledges a chunk it already holds with message ID 0.
+ */
+struct ReqSendFileChunk
+{
+    using Response = RespSendMessage;
+    static constexpr uint16_t code = CODE_SEND_MESSAGE_TO_USER;
+    static constexpr uint16_t responseCode = RESP_CODE_SEND_MSG_SUCCESS;
+    //
+    std::array<uint8_t, CLIENT_ID_LENGTH> targetId{};
+    uint8_t                               messageType = MSG_TYPE_SEND_FILE | MSG_FLAG_CHUNKED;
+    FileChunkHeader                       header;
+    std::span<const uint8_t>              encryptedChunk; //< Must stay alive until the request is encoded
+    //
+    size_t encodedSize() const
+    {
+        return CLIENT_ID_LENGTH + MESSAGE_TYPE_LEN + MESSAGE_CONTENT_LEN + FILE_CHUNK_HEADER_LEN + encryptedChunk.size();
+    }
+    void encode(ByteWriter& writer) const
+    {
+        writer.writeBytes(targetId);
+        writer.writeU8(messageType);
+        writer.writeU32(static_cast<uint32_t>(FILE_CHUNK_HEADER_LEN + encryptedChunk.size()));
+        header.encode(writer);
+        writer.writeBytes(encryptedChunk);
+    }
+};
+
+// === 604: Pending messages ===
+/**
+ * @brief Decodes pending message records until the reader is exhausted.
+ * Legacy records hold a 4-byte content size, compact ones a varint. Contents are views into the reader's buffer.
+ */
+inline std::vector<PendingMessage> decodePendingRecords(ByteReader& reader, uint8_t version)
+{
+    std::vector<PendingMessage> messages;
+    while (!reader.empty())
+    {
+        PendingMessage message;
+        message.senderId = reader.readArray<CLIENT_ID_LENGTH>();
+        message.messageId = reader.readU32();
+        message.messageType = reader.readU8();
+        message.content = reader.readBytes(version >= PROTOCOL_VERSION_COMPACT ? reader.readVarint() : reader.readU32());
+        messages.push_back(message);
+    }
+    return messages;
+}
+
+struct RespPendingMessages
+{
+    std::vector<PendingMessage> messages; //< Contents are views into the response packet
+    //
+    static RespPendingMessages decode(ByteReader& reader, uint8_t version)
+    {
+        RespPendingMessages response;
+        response.messages = decodePendingRecords(reader, version);
+        return response;
+    }
+};
+
+struct ReqPendingMessages
+{
+    using Response = RespPendingMessages;
+    static constexpr uint16_t code = CODE_REQ_PENDING_MESSAGES;
+    static constexpr uint16_t responseCode = RESP_CODE_GET_PENDING_MSGS;
+    //
+    size_t encodedSize() const { return 0; }
+    void encode(ByteWriter&) const { }
+};
+
+// === 607: Public keys (bulk) ===
+struct RespPublicKeys
+{
+    //< Keys are views into the response packet. Unknown clients are left out.
+    std::vector<std::pair<std::array<uint8_t, CLIENT_ID_LENGTH>, std::span<const uint8_t>>> keys;
+    //
+    static RespPublicKeys decode(ByteReader& reader)
+    {
+        RespPublicKeys response;
+        response.keys.reserve(reader.remaining() / (CLIENT_ID_LENGTH + REGISTER_PUBLIC_KEY_LEN));
+        while (!reader.empty())
+        {
+            std::array<uint8_t, CLIENT_ID_LENGTH> clientId = reader.readArray<CLIENT_ID_LENGTH>();
+            response.keys.emplace_back(clientId, reader.readBytes(REGISTER_PUBLIC_KEY_LEN));
+        }
+        return response;
+    }
+};
+
+struct ReqPublicKeys
+{
+    using Response = RespPublicKeys;
+    static constexpr uint16_t code = CODE_REQ_PUBLIC_KEYS;
+    static constexpr uint16_t responseCode = RESP_CODE_GET_PUBLIC_KEYS;
+    //
+    std::span<const std::array<uint8_t, CLIENT_ID_LENGTH>> targetIds; //< Must stay alive until the request is encoded
+    //
+    size_t encodedSize() const { return targetIds.size() * CLIENT_ID_LENGTH; }
+    void encode(ByteWriter& writer) const
+    {
+        if (targetIds.size() > MAX_BULK_PUBLIC_KEYS)
+            throw std::runtime_error("Too many clients in one public key request\n");
+        for (const auto& targetId : targetIds)
+            writer.writeBytes(targetId);
+    }
+};
+
+// === 608: Pending messages page ===
+struct RespPendingPage
+{
+    bool                        hasMore = false; //< More messages follow this page
+    std::vector<PendingMessage> messages; //< Contents are views into the response packet
+    //
+    static RespPendingPage decode(ByteReader& reader, uint8_t version)
+    {
+        RespPendingPage response;
+        response.hasMore = reader.readU8() != 0;
+        response.messages = decodePendingRecords(reader, version);
+        return response;
+    }
+};
+
+/**
+ * Asks for the next page of pending messages. `cursor` acknowledges every message up to and including
+ * that ID, which the server then deletes; a `maxCount` of 0 only acknowledges.
+ */
+struct ReqPendingPage
+{
+    using Response = RespPendingPage;
+    static constexpr uint16_t code = CODE_REQ_PENDING_PAGE;
+    static constexpr uint16_t responseCode = RESP_CODE_GET_PENDING_PAGE;
+    //
+    uint32_t cursor = 0;
+    uint16_t maxCount = PENDING_PAGE_MAX_COUNT;
+    uint32_t maxBytes = PENDING_PAGE_MAX_BYTES;
+    //
+    size_t encodedSize() const { return PAGE_REQUEST_LEN; }
+    void encode(ByteWriter& writer) const
+    {
+        writer.writeU32(cursor);
+        writer.writeU16(maxCount);
+        writer.writeU32(maxBytes);
+    }
+};
+
+// === 609: Client list sync ===
+struct RespClientListSync
+{
+    uint32_t version = 0; //< Directory version the client list is now in sync with
+    std::vector<std::pair<std::string, std::array<uint8_t, CLIENT_ID_LENGTH>>> clients; //< Clients added since the requested version
+    //
+    static RespClientListSync decode(ByteReader& reader, uint8_t version)
+    {
+        RespClientListSync response;
+        response.version = reader.readU32();
+        response.clients = decodeClientRecords(reader, version);
+        return response;
+    }
+};
+
+struct ReqClientListSync
+{
+    using Response = RespClientListSync;
+    static constexpr uint16_t code = CODE_SYNC_USER_LIST;
+    static constexpr uint16_t responseCode = RESP_CODE_SYNC_CLIENT_LIST;
+    //
+    uint32_t sinceVersion = 0; //< Last directory version seen, 0 for the full list
+    //
+    size_t encodedSize() const { return DIRECTORY_VERSION_LEN; }
+    void encode(ByteWriter& writer) const { writer.writeU32(sinceVersion); }
+};
+
+// === 610: Hello ===
+struct RespHello
+{
+    uint32_t capabilities = 0; //< Features both sides support on this connection
+    uint32_t compressionThreshold = 0; //< Smallest content size to compress
+    //
+    static RespHello decode(ByteReader& reader)
+    {
+        RespHello response;
+        response.capabilities = reader.readU32();
+        response.compressionThreshold = reader.readU32();
+        return response;
+    }
+};
+
+/**
+ * Sent first on every new connection to negotiate optional features.
+ */
+struct ReqHello
+{
+    using Response = RespHello;
+    static constexpr uint16_t code = CODE_HELLO;
+    static constexpr uint16_t responseCode = RESP_CODE_HELLO;
+    //
+    uint32_t capabilities = 0;
+    uint32_t compressionThreshold = DEFAULT_COMPRESSION_THRESHOLD;
+    //
+    size_t encodedSize() const { return 2 * sizeof(uint32_t); }
+    void encode(ByteWriter& writer) const
+    {
+        writer.writeU32(capabilities);
+        writer.writeU32(compressionThreshold);
+    }
+};
+
+// === 611: Wait for messages (long-poll) ===
+/**
+ * A pending page request the server holds open until there is something to deliver or `timeoutMs` runs out
+ * (then the page is empty). Answered with the pending page layout.
+ */
+struct ReqWaitMessages
+{
+    using Response = RespPendingPage;
+    static constexpr uint16_t code = CODE_WAIT_MESSAGES;
+    static constexpr uint16_t responseCode = RESP_CODE_WAIT_MESSAGES;
+    //
+    ReqPendingPage page;
+    uint32_t       timeoutMs = DEFAULT_WAIT_TIMEOUT_MS;
+    //
+    size_t encodedSize() const { return WAIT_REQUEST_LEN; }
+    void encode(ByteWriter& writer) const
+    {
+        page.encode(writer);
+        writer.writeU32(timeoutMs);
+    }
+};
+
+// === 612: File transfer progress ===
+struct RespFileProgress
+{
+    uint64_t received = 0; //< Plaintext bytes the server holds, in order from the start of the file
+    uint64_t totalSize = 0; //< 0 for a transfer the server does not know
+    //
+    static RespFileProgress decode(ByteReader& reader)
+    {
+        RespFileProgress response;
+        response.received = reader.readU64();
+        response.totalSize = reader.readU64();
+        return response;
+    }
+};
+
+/**
+ * Asks how far a chunked file transfer to `targetId` got, to resume it from there.
+ */
+struct ReqFileProgress
+{
+    using Response = RespFileProgress;
+    static constexpr uint16_t code = CODE_FILE_PROGRESS;
+    static constexpr uint16_t responseCode = RESP_CODE_FILE_PROGRESS;
+    //
+    std::array<uint8_t, CLIENT_ID_LENGTH> targetId{};
+    uint64_t                              fileId = 0;
+    //
+    size_t encodedSize() const { return FILE_PROGRESS_REQUEST_LEN; }
+    void encode(ByteWriter& writer) const
+    {
+        writer.writeBytes(targetId);
+        writer.writeU64(fileId);
+    }
+};
+
+// === Generic encode/decode ===
+/**
+ * Result of a typed round trip. Holds the response packet, because the decoded response may contain
+ * views into it.
+ */
+template <typename Request>
+struct MessageReply
+{
+    CallStatus                  status = CallStatus::SendFailed;
+    std::optional<ServerPacket> packet;
+    typename Request::Response  response{};
+    //
+    explicit operator bool() const { return status == CallStatus::Ok; }
+    const typename Request::Response* operator->() const { return &response; }
+};
+
+/**
+ * @brief Encodes a typed request into a packet, writing the payload into one exactly sized buffer.
+ * @throws std::runtime_error if a field does not fit its schema.
+ */
+template <typename Request>
+ClientPacket encodeRequest(const Request& request, const std::array<uint8_t, CLIENT_ID_LENGTH>& senderId)
+{
+    std::vector<uint8_t> payload(request.encodedSize());
+    ByteWriter writer(payload);
+    request.encode(writer);
+    if (writer.written() != payload.size())
+        throw std::runtime_error("Request encoded to an unexpected size\n");
+    return ClientPacket(Request::code, std::move(payload), senderId);
+}
+
+/**
+ * @brief Checks a response code and payload against the request's schema and decodes them.
+ * Responses whose layout depends on the protocol version take `version` as a second decode argument.
+ * `response` may contain views into `payload`.
+ */
+template <typename Request>
+CallStatus decodePayload(uint16_t code, uint8_t version, std::span<const uint8_t> payload, typename Request::Response& response)
+{
+    if (code == RESP_CODE_ERROR)
+        return CallStatus::ServerError;
+    if (code != Request::responseCode)
+        return CallStatus::UnexpectedCode;
+    //
+    try
+    {
+        ByteReader reader(payload);
+        if constexpr (requires { Request::Response::decode(reader, version); })
+            response = Request::Response::decode(reader, version);
+        else
+            response = Request::Response::decode(reader);
+    }
+    catch (const std::runtime_error&)
+    {
+        return CallStatus::Malformed;
+    }
+    return CallStatus::Ok;
+}
+
+/**
+ * @brief Checks a response packet against the request's schema and decodes it.
+ * `response` may contain views into `packet`.
+ */
+template <typename Request>
+CallStatus decodeResponse(const std::optional<ServerPacket>& packet, typename Request::Response& response)
+{
+    if (!packet)
+        return CallStatus::NoResponse;
+    return decodePayload<Request>(packet->getCode(), packet->getVersion(), packet->getPayload(), response);
+}
+
+// === 606: Batch ===
+/**
+ * Outcome of one item of a batch.
+ */
+template <typename Request>
+struct BatchItemReply
+{
+    using RequestType = Request;
+    //
+    CallStatus                 status = CallStatus::NoResponse;
+    typename Request::Response response{};
+    //
+    explicit operator bool() const { return status == CallStatus::Ok; }
+    const typename Request::Response* operator->() const { return &response; }
+};
+
+/**
+ * Result of a batch round trip: the status of the batch as a whole and, if it succeeded, one reply per
+ * request in request order. Holds the response packet the decoded items may point into.
+ */
+template <typename... Requests>
+struct BatchReply
+{
+    CallStatus                                 status = CallStatus::SendFailed;
+    std::optional<ServerPacket>                packet;
+    std::tuple<BatchItemReply<Requests>...>    items;
+    //
+    explicit operator bool() const { return status == CallStatus::Ok; }
+    template <size_t I>
+    const auto& get() const { return std::get<I>(items); }
+};
+
+/**
+ * @brief Encodes several typed requests into a single batch packet. The server runs them in order and
+ * answers with one batch response, so they cost one round trip.
+ * @throws std::runtime_error if a field does not fit its schema.
+ */
+template <typename... Requests>
+ClientPacket encodeBatch(const std::array<uint8_t, CLIENT_ID_LENGTH>& senderId, const Requests&... requests)
+{
+    static_assert(sizeof...(Requests) > 0 && sizeof...(Requests) <= MAX_BATCH_ITEMS, "Invalid batch size");
+    //
+    std::vector<uint8_t> payload(BATCH_COUNT_LEN + ((BATCH_ITEM_HEADER_LEN + requests.encodedSize()) + ...));
+    ByteWriter writer(payload);
+    writer.writeU16(static_cast<uint16_t>(sizeof...(Requests)));
+    auto encodeItem = [&writer](const auto& request)
+    {
+        writer.writeU16(std::decay_t<decltype(request)>::code);
+        writer.writeU32(static_cast<uint32_t>(request.encodedSize()));
+        request.encode(writer);
+    };
+    (encodeItem(requests), ...);
+    if (writer.written() != payload.size())
+        throw std::runtime_error("Batch encoded to an unexpected size\n");
+    return ClientPacket(CODE_BATCH, std::move(payload), senderId);
+}
+
+/**
+ * @brief Checks a batch response packet and decodes every item against its request's schema.
+ * Items may contain views into `reply.packet`.
+ */
+template <typename... Requests>
+void decodeBatch(BatchReply<Requests...>& reply)
+{
+    if (!reply.packet)
+    {
+        reply.status = CallStatus::NoResponse;
+        return;
+    }
+    if (reply.packet->getCode() == RESP_CODE_ERROR)
+    {
+        reply.status = CallStatus::ServerError;
+        return;
+    }
+    if (reply.packet->getCode() != RESP_CODE_BATCH)
+    {
+        reply.status = CallStatus::UnexpectedCode;
+        return;
+    }
+    //
+    try
+    {
+        uint8_t version = reply.packet->getVersion();
+        ByteReader reader(reply.packet->getPayload());
+        if (reader.readU16() != sizeof...(Requests))
+            throw std::runtime_error("Batch response item count mismatch\n");
+        auto decodeItem = [&reader, version](auto& item)
+        {
+            using Request = typename std::decay_t<decltype(item)>::RequestType;
+            uint16_t code = reader.readU16();
+            std::span<const uint8_t> payload = reader.readBytes(reader.readU32());
+            item.status = decodePayload<Request>(code, version, payload, item.response);
+        };
+        std::apply([&](auto&... items) { (decodeItem(items), ...); }, reply.items);
+        if (!reader.empty())
+            throw std::runtime_error("Trailing bytes in batch response\n");
+        reply.status = CallStatus::Ok;
+    }
+    catch (const std::runtime_error&)
+    {
+        reply.status = CallStatus::Malformed;
+    }
+}
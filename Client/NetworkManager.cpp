@@ -1,156 +1,759 @@
 #include "NetworkManager.h"
-#include <thread>
-#include <chrono>
+#include <future>
+#include <algorithm>
+#include <cmath>
+#include <fstream>
 
-#define MAX_RECONNECTION_ATTEMPTS (5U)
+#define DEFAULT_MAX_IN_FLIGHT      (16U)
+#define RECONNECT_POLL_INTERVAL_MS (50U)
+#define DEFAULT_MAX_PAYLOAD_SIZE   (64U * 1024U * 1024U)   // 64 MB
+#define DEFAULT_MAX_STREAMED_SIZE  (0xFFFFFFFFU)           // Anything the 32-bit size field can express
+#define DEFAULT_STREAM_CHUNK_SIZE  (1024U * 1024U)         // 1 MB
+#define MIN_SUGGESTED_BUFFER_SIZE  (64 * 1024)             // 64 KB
+#define MAX_SUGGESTED_BUFFER_SIZE  (16 * 1024 * 1024)      // 16 MB
+
+using boost::asio::awaitable;
+using boost::asio::use_awaitable;
+
+#ifdef TCP_QUICKACK
+using quick_ack = boost::asio::detail::socket_option::boolean<IPPROTO_TCP, TCP_QUICKACK>;
+#endif
+#ifdef TCP_KEEPIDLE
+using keep_alive_idle = boost::asio::detail::socket_option::integer<IPPROTO_TCP, TCP_KEEPIDLE>;
+#endif
 
 NetworkManager::NetworkManager()
-    : m_socket(m_io_context), m_connected(false) {}
+    : m_workGuard(boost::asio::make_work_guard(m_io_context)), m_socket(m_io_context), m_connected(false),
+      m_reconnecting(false), m_jitterRng(std::random_device{}()), m_serverPort(0), m_generation(0), m_bufferPool(BufferPool::create()), m_maxInFlight(DEFAULT_MAX_IN_FLIGHT),
+      m_maxPayloadSize(DEFAULT_MAX_PAYLOAD_SIZE), m_maxStreamedPayloadSize(DEFAULT_MAX_STREAMED_SIZE),
+      m_streamChunkSize(DEFAULT_STREAM_CHUNK_SIZE)
+{
+    m_ioThread = std::thread([this]() { m_io_context.run(); });
+}
 //
 NetworkManager::~NetworkManager()
 {
-    if (m_connected)
+    boost::asio::post(m_io_context, [this]()
     {
-        std::cout << "Closing socket\n";
-        m_socket.close();
-    }
+        closeSocket();
+        if (m_metricsDumpTimer)
+            m_metricsDumpTimer->cancel();
+        m_metricsDumpTimer.reset();
+    });
+    m_workGuard.reset();
+    if (m_ioThread.joinable())
+        m_ioThread.join();
 }
 //
-bool NetworkManager::ConnectToServer(const std::string& ip, uint16_t port)
+template <typename T>
+T NetworkManager::runBlocking(awaitable<T> operation)
+{
+    std::future<T> result = boost::asio::co_spawn(m_io_context, std::move(operation), boost::asio::use_future);
+    return result.get();
+}
+//
+template <typename Operation>
+awaitable<boost::system::error_code> NetworkManager::withDeadline(std::chrono::milliseconds timeout, Operation operation)
+{
+    // The flag is shared with the watchdog handler, which may run after this frame is gone
+    std::shared_ptr<bool> timedOut = std::make_shared<bool>(false);
+    boost::asio::steady_timer watchdog(m_io_context, timeout);
+    watchdog.async_wait([this, timedOut](const boost::system::error_code& ec)
+    {
+        if (ec)
+            return; // Cancelled, the operation finished in time
+        *timedOut = true;
+        boost::system::error_code ignored;
+        m_socket.cancel(ignored);
+    });
+    //
+    boost::system::error_code ec;
+    co_await operation(boost::asio::redirect_error(use_awaitable, ec));
+    watchdog.cancel();
+    //
+    if (*timedOut)
+        ec = boost::asio::error::timed_out;
+    co_return ec;
+}
+//
+awaitable<bool> NetworkManager::asyncConnect(std::string ip, uint16_t port)
 {
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
     try
     {
         boost::asio::ip::tcp::resolver resolver(m_io_context);
-        boost::asio::ip::tcp::resolver::results_type endpoints = resolver.resolve(ip, std::to_string(port));
-        boost::asio::connect(m_socket, endpoints);
-        m_connected = true;
-        m_serverIp = ip;
-        m_serverPort = port;
-        return m_connected;
+        boost::asio::ip::tcp::resolver::results_type endpoints =
+            co_await resolver.async_resolve(ip, std::to_string(port), use_awaitable);
+        closeSocket();
+        boost::system::error_code ec = co_await withDeadline(m_deadlines.connect,
+            [&](auto token) -> awaitable<void> { co_await boost::asio::async_connect(m_socket, endpoints, token); });
+        if (ec)
+            throw boost::system::system_error(ec);
+        if (!co_await exchangeHello())
+            throw std::runtime_error("Hello exchange failed");
+        markConnected(ip, port);
+        std::chrono::steady_clock::duration elapsed = std::chrono::steady_clock::now() - start;
+        m_metrics.recordConnect(elapsed, true);
+        recordEndpointLatency(ip, port, std::chrono::duration_cast<std::chrono::microseconds>(elapsed));
+        co_return true;
     }
     catch (const std::exception& e)
     {
         std::cerr << "Connection failed: " << e.what() << std::endl;
-        return m_connected;
+        m_metrics.recordConnect(std::chrono::steady_clock::now() - start, false);
+        recordEndpointLatency(ip, port, std::nullopt);
+        co_return false;
     }
 }
 //
-bool NetworkManager::sendPacket(const ClientPacket& packet)
+void NetworkManager::markConnected(const std::string& ip, uint16_t port)
 {
-    bool res = true;
-    if (!m_connected)
+    applyTransportProfile();
+    m_generation++; // before the socket is seen as connected, so a request sent on it sees the new generation
+    m_connected = true;
+    m_serverIp = ip;
+    m_serverPort = port;
+}
+//
+struct NetworkManager::ConnectRace
+{
+    ConnectRace(boost::asio::io_context& io, size_t attempts) : done(io), pending(attempts) { }
+    //
+    boost::asio::steady_timer                   done; //< Cancelled to wake asyncConnectFastest
+    size_t                                      pending; //< Attempts still running
+    std::optional<boost::asio::ip::tcp::socket> winner; //< Socket of the first successful attempt
+    Endpoint                                    winnerEndpoint;
+    std::chrono::microseconds                   winnerLatency{ 0 };
+};
+//
+awaitable<void> NetworkManager::raceEndpoint(std::shared_ptr<ConnectRace> race, Endpoint endpoint)
+{
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    // Shared with the watchdog handler, which may run after this frame is gone
+    std::shared_ptr<boost::asio::ip::tcp::socket> socket = std::make_shared<boost::asio::ip::tcp::socket>(m_io_context);
+    boost::asio::steady_timer watchdog(m_io_context, m_deadlines.connect);
+    watchdog.async_wait([socket](const boost::system::error_code& ec)
     {
-        printConnectionError();
-        if (!reconnect(m_serverIp, m_serverPort))
-            res = false;
+        if (ec)
+            return;
+        boost::system::error_code ignored;
+        socket->close(ignored);
+    });
+    //
+    boost::system::error_code ec;
+    try
+    {
+        boost::asio::ip::tcp::resolver resolver(m_io_context);
+        boost::asio::ip::tcp::resolver::results_type endpoints =
+            co_await resolver.async_resolve(endpoint.ip, std::to_string(endpoint.port), use_awaitable);
+        co_await boost::asio::async_connect(*socket, endpoints, boost::asio::redirect_error(use_awaitable, ec));
+    }
+    catch (const boost::system::system_error& e)
+    {
+        ec = e.code();
+    }
+    watchdog.cancel();
+    //
+    std::chrono::microseconds latency =
+        std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start);
+    recordEndpointLatency(endpoint.ip, endpoint.port, ec ? std::nullopt : std::optional(latency));
+    if (!ec && !race->winner)
+    {
+        race->winner.emplace(std::move(*socket));
+        race->winnerEndpoint = endpoint;
+        race->winnerLatency = latency;
+        race->done.cancel();
+    }
+    else
+    {
+        boost::system::error_code ignored;
+        socket->close(ignored);
+    }
+    //
+    if (--race->pending == 0)
+        race->done.cancel();
+}
+//
+awaitable<bool> NetworkManager::asyncConnectFastest(std::vector<Endpoint> endpoints)
+{
+    m_endpoints.clear();
+    for (const Endpoint& endpoint : endpoints)
+        m_endpoints.push_back({ endpoint, std::nullopt });
+    if (endpoints.empty())
+        co_return false;
+    //
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    std::shared_ptr<ConnectRace> race = std::make_shared<ConnectRace>(m_io_context, endpoints.size());
+    race->done.expires_at(std::chrono::steady_clock::time_point::max());
+    for (const Endpoint& endpoint : endpoints)
+        boost::asio::co_spawn(m_io_context, raceEndpoint(race, endpoint), boost::asio::detached);
+    //
+    // The attempts only run while this coroutine is suspended, so the condition cannot change between check and wait
+    while (!race->winner && race->pending > 0)
+    {
+        boost::system::error_code ignored;
+        co_await race->done.async_wait(boost::asio::redirect_error(use_awaitable, ignored));
+    }
+    //
+    if (!race->winner)
+    {
+        std::cerr << "Connection failed: none of the " << endpoints.size() << " server endpoint(s) is reachable.\n";
+        m_metrics.recordConnect(std::chrono::steady_clock::now() - start, false);
+        co_return false;
+    }
+    closeSocket();
+    m_socket = std::move(*race->winner);
+    race->winner.reset();
+    if (!co_await exchangeHello())
+    {
+        std::cerr << "Connection failed: hello exchange with " << race->winnerEndpoint.ip << ":" << race->winnerEndpoint.port << " failed.\n";
+        m_metrics.recordConnect(std::chrono::steady_clock::now() - start, false);
+        co_return false;
+    }
+    markConnected(race->winnerEndpoint.ip, race->winnerEndpoint.port);
+    m_metrics.recordConnect(race->winnerLatency, true);
+    std::cout << "Connected to " << m_serverIp << ":" << m_serverPort << " (" << race->winnerLatency.count() << "us)\n";
+    co_return true;
+}
+//
+bool NetworkManager::ConnectToFastest(const std::vector<Endpoint>& endpoints)
+{
+    return runBlocking(asyncConnectFastest(endpoints));
+}
+//
+void NetworkManager::setEndpoints(const std::vector<Endpoint>& endpoints)
+{
+    runOnIoThread([&]()
+    {
+        m_endpoints.clear();
+        for (const Endpoint& endpoint : endpoints)
+            m_endpoints.push_back({ endpoint, std::nullopt });
+    });
+}
+//
+void NetworkManager::recordEndpointLatency(const std::string& ip, uint16_t port, std::optional<std::chrono::microseconds> latency)
+{
+    for (EndpointState& state : m_endpoints)
+    {
+        if (state.endpoint.ip == ip && state.endpoint.port == port)
+            state.latency = latency;
+    }
+}
+//
+std::vector<NetworkManager::Endpoint> NetworkManager::failoverOrder(const Endpoint& current, bool currentFirst) const
+{
+    std::vector<const EndpointState*> ranked;
+    for (const EndpointState& state : m_endpoints)
+    {
+        if (state.endpoint.ip != current.ip || state.endpoint.port != current.port)
+            ranked.push_back(&state);
     }
+    std::stable_sort(ranked.begin(), ranked.end(), [](const EndpointState* a, const EndpointState* b)
+    {
+        if (a->latency && b->latency)
+            return *a->latency < *b->latency;
+        return a->latency.has_value() && !b->latency.has_value();
+    });
+    //
+    std::vector<Endpoint> order;
+    for (const EndpointState* state : ranked)
+        order.push_back(state->endpoint);
+    order.insert(currentFirst ? order.begin() : order.end(), current);
+    return order;
+}
+//
+bool NetworkManager::ConnectToServer(const std::string& ip, uint16_t port)
+{
+    return runBlocking(asyncConnect(ip, port));
+}
+//
+awaitable<bool> NetworkManager::asyncSendPacket(const ClientPacket& packet)
+{
+    bool res = true;
+    if (!co_await ensureConnected())
+        co_return false;
     //
     try
     {
-        std::vector<uint8_t> data = packet.serialize();
-        if (!writeExact(data.data(), data.size()))
+        std::array<uint8_t, CLIENT_HEADER_SIZE> header = packet.encodeHeader();
+        std::array<boost::asio::const_buffer, 2> buffers = {
+            boost::asio::buffer(header),
+            boost::asio::buffer(packet.getPayload())
+        };
+        if (!co_await writeExact(buffers))
         {
             std::cerr << "Error: Failed to send packet. Connection may be close.\n";
             res = false;
         }
-        return res;
+        else
+            m_metrics.recordSent(packet.getCode(), CLIENT_HEADER_SIZE + packet.getPayload().size());
     }
     catch (const std::exception& e)
     {
         std::cerr << "Send error: " << e.what() << std::endl;
         res = false;
-        return res;
     }
+    co_return res;
 }
 //
-bool NetworkManager::receivePacket(ServerPacket& packet)
+bool NetworkManager::sendPacket(const ClientPacket& packet)
 {
-    bool res = true;
-    if (!m_connected)
+    return runBlocking(asyncSendPacket(packet));
+}
+//
+awaitable<std::optional<ServerPacketHeader>> NetworkManager::readHeader(uint8_t* raw, size_t maxPayloadSize)
+{
+    if (!co_await readExact(raw, SERVER_HEADER_SIZE))
     {
-        printConnectionError();
-        if (!reconnect(m_serverIp, m_serverPort))
-            res = false;
+        std::cerr << "Warning: Failed to receive packet header.\n";
+        co_return std::nullopt;
     }
     //
+    ServerPacketHeader header = ServerPacket::parseHeader(raw);
+    if (header.payloadsize > maxPayloadSize)
+    {
+        std::cerr << "Error: Packet payload of " << header.payloadsize << " bytes exceeds the limit of "
+            << maxPayloadSize << " bytes. Dropping connection.\n";
+        handleConnectionLost();
+        co_return std::nullopt;
+    }
+    co_return header;
+}
+//
+awaitable<std::optional<ServerPacket>> NetworkManager::asyncReceivePacket()
+{
+    if (!co_await ensureConnected())
+        co_return std::nullopt;
+    std::optional<ServerPacket> packet = co_await readPacket();
+    co_return packet;
+}
+//
+awaitable<std::optional<ServerPacket>> NetworkManager::readPacket()
+{
     try
     {
-        std::vector<uint8_t> buffer(SERVER_HEADER_SIZE);
-        if (!readExact(buffer.data(), SERVER_HEADER_SIZE))
-        {
-            std::cerr << "Warning: Failed to receive packet header.\n";
-            res = false;
-        }
-        //
-        uint32_t payloadSize;
-        std::memcpy(&payloadSize, buffer.data() + SERVER_PAYLOAD_SIZE_OFFSET, sizeof(payloadSize));
+        BufferPool::Lease buffer = m_bufferPool->acquire(SERVER_HEADER_SIZE);
+        std::optional<ServerPacketHeader> header = co_await readHeader(buffer.data(), m_maxPayloadSize);
+        if (!header)
+            co_return std::nullopt;
         //
-        buffer.resize(SERVER_HEADER_SIZE + payloadSize);
-        if (!readExact(buffer.data() + SERVER_HEADER_SIZE, payloadSize))
+        buffer.resize(SERVER_HEADER_SIZE + header->payloadsize);
+        if (!co_await readExact(buffer.data() + SERVER_HEADER_SIZE, header->payloadsize))
         {
             std::cerr << "Warning: Incomplete packet received. Skipping...\n";
-            res = false;
+            co_return std::nullopt;
         }
+        m_metrics.recordReceived(header->code, buffer.size());
         //
-        packet = ServerPacket::deserialize(buffer);
-        return res;
+        co_return ServerPacket::deserialize(std::move(buffer));
     }
     catch (const std::exception& e)
     {
         std::cerr << "Error: Packet processing failed: " << e.what() << std::endl;
-        res = false;
-        return res;
+        co_return std::nullopt;
     }
 }
 //
-void NetworkManager::disconnect()
+awaitable<std::optional<ServerPacketHeader>> NetworkManager::asyncReceivePacketStreaming(
+    std::function<bool(const ServerPacketHeader&, std::span<const uint8_t>)> sink)
+{
+    if (!co_await ensureConnected())
+        co_return std::nullopt;
+    //
+    std::array<uint8_t, SERVER_HEADER_SIZE> raw;
+    std::optional<ServerPacketHeader> header = co_await readHeader(raw.data(), m_maxStreamedPayloadSize);
+    if (!header)
+        co_return std::nullopt;
+    //
+    BufferPool::Lease chunk = m_bufferPool->acquire(std::min<size_t>(m_streamChunkSize, header->payloadsize));
+    size_t remaining = header->payloadsize;
+    bool accepted = true;
+    while (remaining > 0)
+    {
+        size_t chunkSize = std::min(remaining, chunk.size());
+        if (!co_await readExact(chunk.data(), chunkSize))
+        {
+            std::cerr << "Warning: Incomplete packet received.\n";
+            co_return std::nullopt;
+        }
+        remaining -= chunkSize;
+        //
+        // Once the sink gives up, keep reading only to discard the rest of the payload
+        if (accepted)
+        {
+            try
+            {
+                accepted = sink(*header, std::span<const uint8_t>(chunk.data(), chunkSize));
+            }
+            catch (const std::exception& e)
+            {
+                std::cerr << "Error: Packet processing failed: " << e.what() << std::endl;
+                accepted = false;
+            }
+        }
+    }
+    m_metrics.recordReceived(header->code, SERVER_HEADER_SIZE + header->payloadsize);
+    co_return accepted ? header : std::nullopt;
+}
+//
+bool NetworkManager::receivePacket(ServerPacket& packet)
+{
+    std::optional<ServerPacket> received = runBlocking(asyncReceivePacket());
+    if (!received)
+        return false;
+    //
+    packet = std::move(*received);
+    return true;
+}
+//
+bool NetworkManager::receivePacketStreaming(ServerPacketHeader& header,
+    std::function<bool(const ServerPacketHeader&, std::span<const uint8_t>)> sink)
+{
+    std::optional<ServerPacketHeader> received = runBlocking(asyncReceivePacketStreaming(std::move(sink)));
+    if (!received)
+        return false;
+    //
+    header = *received;
+    return true;
+}
+//
+void NetworkManager::queueRequest(ClientPacket packet, std::function<void(ServerPacket&)> onResponse)
+{
+    m_pipeline.push_back({ std::move(packet), std::move(onResponse) });
+}
+//
+bool NetworkManager::flushPipeline()
+{
+    std::deque<PendingRequest> inFlight;
+    uint32_t generation = m_generation;
+    bool res = true;
+    //
+    while (res && (!m_pipeline.empty() || !inFlight.empty()))
+    {
+        // Keep the window full before waiting for the oldest response
+        while (res && !m_pipeline.empty() && inFlight.size() < m_maxInFlight)
+        {
+            if (!sendPacket(m_pipeline.front().packet))
+                res = false;
+            else
+            {
+                inFlight.push_back(std::move(m_pipeline.front()));
+                m_pipeline.pop_front();
+            }
+        }
+        //
+        if (!res || inFlight.empty())
+            break;
+        //
+        ServerPacket response;
+        if (!receivePacket(response))
+        {
+            res = false;
+            break;
+        }
+        inFlight.front().onResponse(response);
+        inFlight.pop_front();
+    }
+    //
+    if (!res)
+    {
+        std::cerr << "Error: Pipeline aborted, " << inFlight.size() + m_pipeline.size() << " request(s) dropped.\n";
+        m_pipeline.clear();
+        // Responses still owed on the same socket would be matched to later requests, drop the connection.
+        if (!inFlight.empty() && generation == m_generation)
+            disconnect();
+    }
+    return res;
+}
+//
+void NetworkManager::applyTransportProfile()
+{
+    const TransportProfile& profile = m_transportProfile;
+    boost::system::error_code ec;
+    auto check = [&](const char* option)
+    {
+        if (ec)
+            std::cerr << "Warning: Failed to set " << option << ": " << ec.message() << "\n";
+        ec.clear();
+    };
+    //
+    m_socket.set_option(boost::asio::ip::tcp::no_delay(profile.noDelay), ec);
+    check("TCP_NODELAY");
+    m_socket.set_option(boost::asio::socket_base::keep_alive(profile.keepAlive), ec);
+    check("SO_KEEPALIVE");
+#ifdef TCP_KEEPIDLE
+    if (profile.keepAlive && profile.keepAliveIdle.count() > 0)
+    {
+        m_socket.set_option(keep_alive_idle(static_cast<int>(profile.keepAliveIdle.count())), ec);
+        check("TCP_KEEPIDLE");
+    }
+#endif
+    if (profile.sendBufferSize > 0)
+    {
+        m_socket.set_option(boost::asio::socket_base::send_buffer_size(profile.sendBufferSize), ec);
+        check("SO_SNDBUF");
+    }
+    if (profile.receiveBufferSize > 0)
+    {
+        m_socket.set_option(boost::asio::socket_base::receive_buffer_size(profile.receiveBufferSize), ec);
+        check("SO_RCVBUF");
+    }
+    rearmQuickAck();
+}
+//
+void NetworkManager::rearmQuickAck()
+{
+#ifdef TCP_QUICKACK
+    if (m_transportProfile.quickAck)
+    {
+        boost::system::error_code ignored;
+        m_socket.set_option(quick_ack(true), ignored);
+    }
+#endif
+}
+//
+void NetworkManager::setTransportProfile(const TransportProfile& profile)
+{
+    runOnIoThread([&]()
+    {
+        m_transportProfile = profile;
+        if (m_connected)
+            applyTransportProfile();
+    });
+}
+//
+void NetworkManager::setHello(const std::optional<ReqHello>& hello)
+{
+    runOnIoThread([&]() { m_hello = hello; });
+}
+//
+RespHello NetworkManager::negotiated()
+{
+    RespHello result;
+    runOnIoThread([&]() { result = m_negotiated; });
+    return result;
+}
+//
+awaitable<bool> NetworkManager::exchangeHello()
+{
+    m_negotiated = RespHello{};
+    if (!m_hello)
+        co_return true;
+    //
+    ClientPacket packet = encodeRequest(*m_hello, std::array<uint8_t, CLIENT_ID_LENGTH>{});
+    std::array<uint8_t, CLIENT_HEADER_SIZE> header = packet.encodeHeader();
+    std::array<boost::asio::const_buffer, 2> buffers = {
+        boost::asio::buffer(header),
+        boost::asio::buffer(packet.getPayload())
+    };
+    if (!co_await writeExact(buffers))
+        co_return false;
+    std::optional<ServerPacket> response = co_await readPacket();
+    if (!response)
+        co_return false;
+    //
+    RespHello agreed;
+    if (decodeResponse<ReqHello>(response, agreed) == CallStatus::Ok)
+        m_negotiated = agreed;
+    co_return true;
+}
+//
+awaitable<std::optional<TransportProbeResult>> NetworkManager::asyncProbeTransport(size_t rttSamples, size_t throughputBytes)
+{
+    using std::chrono::steady_clock;
+    using std::chrono::microseconds;
+    // The server identifies requests by their header only, pings need no client ID
+    const std::array<uint8_t, CLIENT_ID_LENGTH> noId{};
+    TransportProbeResult result;
+    //
+    auto ping = [&](const ClientPacket& request) -> awaitable<std::optional<steady_clock::duration>>
+    {
+        steady_clock::time_point start = steady_clock::now();
+        if (!co_await asyncSendPacket(request))
+            co_return std::nullopt;
+        std::optional<ServerPacket> response = co_await asyncReceivePacket();
+        if (!response || response->getCode() != RESP_CODE_PING || response->getPayload().size() != request.getPayload().size())
+        {
+            std::cerr << "Error: Invalid ping response.\n";
+            co_return std::nullopt;
+        }
+        co_return steady_clock::now() - start;
+    };
+    //
+    ClientPacket emptyPing(CODE_PING, std::vector<uint8_t>(), noId);
+    steady_clock::duration total{ 0 };
+    steady_clock::duration best = steady_clock::duration::max();
+    for (size_t i = 0; i < rttSamples; i++)
+    {
+        std::optional<steady_clock::duration> rtt = co_await ping(emptyPing);
+        if (!rtt)
+            co_return std::nullopt;
+        total += *rtt;
+        best = std::min(best, *rtt);
+    }
+    if (rttSamples > 0)
+    {
+        result.minRtt = std::chrono::duration_cast<microseconds>(best);
+        result.avgRtt = std::chrono::duration_cast<microseconds>(total / rttSamples);
+    }
+    //
+    if (throughputBytes > 0)
+    {
+        std::optional<steady_clock::duration> elapsed =
+            co_await ping(ClientPacket(CODE_PING, std::vector<uint8_t>(throughputBytes), noId));
+        if (!elapsed)
+            co_return std::nullopt;
+        // Discount the fixed round-trip latency the empty pings already measured
+        steady_clock::duration transfer = *elapsed;
+        if (rttSamples > 0 && transfer > 2 * best)
+            transfer -= best;
+        result.throughput = 2.0 * static_cast<double>(throughputBytes) / std::chrono::duration<double>(transfer).count();
+    }
+    //
+    // Enough buffer to keep the pipe full for one round trip
+    double bdp = result.throughput * std::chrono::duration<double>(result.minRtt).count();
+    int suggested = MIN_SUGGESTED_BUFFER_SIZE;
+    while (suggested < bdp && suggested < MAX_SUGGESTED_BUFFER_SIZE)
+        suggested *= 2;
+    result.suggestedBufferSize = suggested;
+    co_return result;
+}
+//
+std::optional<TransportProbeResult> NetworkManager::probeTransport(size_t rttSamples, size_t throughputBytes)
+{
+    return runBlocking(asyncProbeTransport(rttSamples, throughputBytes));
+}
+//
+void NetworkManager::closeSocket()
 {
     if (m_connected)
     {
         std::cout << "Closing socket\n";
-        m_socket.close();
+        boost::system::error_code ec;
+        m_socket.close(ec);
         m_connected = false;
     }
 }
 //
-bool NetworkManager::readExact(void* buffer, size_t size)
+void NetworkManager::runOnIoThread(const std::function<void()>& function)
 {
-    try
+    if (m_io_context.get_executor().running_in_this_thread())
     {
-        boost::asio::read(m_socket, boost::asio::buffer(buffer, size));
-        return true;
+        function();
+        return;
     }
-    catch (const boost::system::system_error& e)
+    std::promise<void> done;
+    boost::asio::post(m_io_context, [&]()
     {
-        std::cerr << "Warning: Read failed: " << e.what() << "\n";
-        if (e.code() == boost::asio::error::eof || e.code() == boost::asio::error::connection_reset)
-        {
-            std::cerr << "Connection lost. Reconnecting...\n";
-            disconnect();
-            reconnect(m_serverIp, m_serverPort);
-        }
-        return false;
+        function();
+        done.set_value();
+    });
+    done.get_future().get();
+}
+//
+void NetworkManager::disconnect()
+{
+    runOnIoThread([this]() { closeSocket(); });
+}
+//
+void NetworkManager::handleConnectionLost()
+{
+    if (!m_connected)
+    {
+        // Lost during the hello exchange, before the socket was marked connected: the connect attempt fails instead
+        boost::system::error_code ec;
+        m_socket.close(ec);
+        return;
     }
+    std::cerr << "Connection lost. Reconnecting in the background...\n";
+    closeSocket();
+    startBackgroundReconnect();
 }
 //
-bool NetworkManager::writeExact(const void* buffer, size_t size)
+void NetworkManager::startBackgroundReconnect()
 {
-    try
+    if (m_reconnecting.exchange(true))
+        return; // A cycle is already running
+    //
+    // The endpoint that was just lost is tried last
+    boost::asio::co_spawn(m_io_context, [this]() -> awaitable<void>
+    {
+        co_await asyncReconnectTo(failoverOrder(currentEndpoint(), false));
+        m_reconnecting = false;
+    }, boost::asio::detached);
+}
+//
+awaitable<bool> NetworkManager::ensureConnected()
+{
+    if (m_connected)
+        co_return true;
+    //
+    printConnectionError();
+    startBackgroundReconnect();
+    //
+    // Wait for the background cycle, but never longer than a single connect is allowed to take
+    std::chrono::steady_clock::time_point deadline = std::chrono::steady_clock::now() + m_deadlines.connect;
+    boost::asio::steady_timer poll(m_io_context);
+    while (!m_connected && m_reconnecting && std::chrono::steady_clock::now() < deadline)
     {
-        boost::asio::write(m_socket, boost::asio::buffer(buffer, size));
-        return true;
+        poll.expires_after(std::chrono::milliseconds(RECONNECT_POLL_INTERVAL_MS));
+        co_await poll.async_wait(use_awaitable);
     }
-    catch (const boost::system::system_error& e)
+    //
+    if (!m_connected)
+        std::cerr << "Error: Server unreachable" << (m_reconnecting ? ", still reconnecting in the background.\n" : ".\n");
+    co_return m_connected.load();
+}
+//
+awaitable<bool> NetworkManager::readExact(void* buffer, size_t size)
+{
+    uint8_t* dst = static_cast<uint8_t*>(buffer);
+    while (size > 0)
     {
-        std::cerr << "Warning: Write failed: " << e.what() << "\n";
-        if (e.code() == boost::asio::error::eof || e.code() == boost::asio::error::connection_reset)
+        size_t bytesRead = 0;
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        boost::system::error_code ec = co_await withDeadline(m_deadlines.read, [&](auto token) -> awaitable<void>
         {
-            std::cerr << "Connection lost. Reconnecting...\n";
-            disconnect();
-            reconnect(m_serverIp, m_serverPort);
+            bytesRead = co_await m_socket.async_read_some(boost::asio::buffer(dst, size), token);
+        });
+        m_metrics.recordRead(std::chrono::steady_clock::now() - start, !ec && bytesRead < size);
+        if (ec)
+        {
+            std::cerr << "Warning: Read failed: " << ec.message() << "\n";
+            handleConnectionLost();
+            co_return false;
         }
-        return false;
+        dst += bytesRead;
+        size -= bytesRead;
     }
+    rearmQuickAck();
+    co_return true;
+}
+//
+awaitable<bool> NetworkManager::writeExact(const std::array<boost::asio::const_buffer, 2>& buffers)
+{
+    std::array<boost::asio::const_buffer, 2> remaining = buffers;
+    while (boost::asio::buffer_size(remaining) > 0)
+    {
+        size_t bytesWritten = 0;
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        boost::system::error_code ec = co_await withDeadline(m_deadlines.write, [&](auto token) -> awaitable<void>
+        {
+            bytesWritten = co_await m_socket.async_write_some(remaining, token);
+        });
+        m_metrics.recordWrite(std::chrono::steady_clock::now() - start);
+        if (ec)
+        {
+            std::cerr << "Warning: Write failed: " << ec.message() << "\n";
+            handleConnectionLost();
+            co_return false;
+        }
+        // Advance past what was written, possibly crossing into the second buffer
+        size_t fromFirst = std::min(bytesWritten, remaining[0].size());
+        remaining[0] += fromFirst;
+        remaining[1] += bytesWritten - fromFirst;
+    }
+    co_return true;
 }
 //
 void NetworkManager::printConnectionError()
@@ -158,18 +761,100 @@ void NetworkManager::printConnectionError()
     std::cerr << "Error: Not connected to server. Reconnecting...\n";
 }
 //
-bool NetworkManager::reconnect(const std::string& ip, uint16_t port)
+std::chrono::milliseconds NetworkManager::backoffDelay(unsigned failedAttempts)
 {
-    for (int attempt = 1; attempt <= MAX_RECONNECTION_ATTEMPTS; attempt++)
+    double base = static_cast<double>(m_reconnectPolicy.initialDelay.count()) *
+        std::pow(m_reconnectPolicy.multiplier, static_cast<double>(failedAttempts - 1));
+    base = std::min(base, static_cast<double>(m_reconnectPolicy.maxDelay.count()));
+    //
+    double jitter = std::clamp(m_reconnectPolicy.jitter, 0.0, 1.0);
+    std::uniform_real_distribution<double> dist(base * (1.0 - jitter), base);
+    return std::chrono::milliseconds(static_cast<long long>(dist(m_jitterRng)));
+}
+//
+awaitable<bool> NetworkManager::asyncReconnect(std::string ip, uint16_t port)
+{
+    std::vector<Endpoint> order = failoverOrder({ ip, port }, true);
+    co_return co_await asyncReconnectTo(std::move(order));
+}
+//
+awaitable<bool> NetworkManager::asyncReconnectTo(std::vector<Endpoint> order)
+{
+    boost::asio::steady_timer timer(m_io_context);
+    for (unsigned attempt = 1; attempt <= m_reconnectPolicy.maxAttempts; attempt++)
     {
-        std::cout << "Attempting to reconnect (" << attempt << "/" << MAX_RECONNECTION_ATTEMPTS << ")...\n";
-        if (ConnectToServer(ip, port))
+        // Fail over through every endpoint before backing off
+        for (const Endpoint& endpoint : order)
         {
-            std::cout << "Reconnection successful.\n";
-            return true;
+            std::cout << "Attempting to reconnect to " << endpoint.ip << ":" << endpoint.port
+                << " (" << attempt << "/" << m_reconnectPolicy.maxAttempts << ")...\n";
+            m_metrics.recordReconnectAttempt();
+            if (co_await asyncConnect(endpoint.ip, endpoint.port))
+            {
+                std::cout << "Reconnection successful.\n";
+                m_metrics.recordReconnectOutcome(true);
+                co_return true;
+            }
         }
-        std::this_thread::sleep_for(std::chrono::seconds(1));
+        if (attempt == m_reconnectPolicy.maxAttempts)
+            break;
+        timer.expires_after(backoffDelay(attempt));
+        co_await timer.async_wait(use_awaitable);
     }
     std::cerr << "All reconnection attempts failed. The server may be down.\n";
-    return false;
+    m_metrics.recordReconnectOutcome(false);
+    co_return false;
+}
+//
+bool NetworkManager::reconnect(const std::string& ip, uint16_t port)
+{
+    if (m_reconnecting)
+    {
+        std::cerr << "Reconnect already in progress.\n";
+        return false;
+    }
+    return runBlocking(asyncReconnect(ip, port));
+}
+//
+awaitable<void> NetworkManager::metricsDumpLoop(std::shared_ptr<boost::asio::steady_timer> timer,
+    std::string path, std::chrono::milliseconds interval)
+{
+    while (true)
+    {
+        timer->expires_after(interval);
+        boost::system::error_code ec;
+        co_await timer->async_wait(boost::asio::redirect_error(use_awaitable, ec));
+        if (ec || timer != m_metricsDumpTimer)
+            co_return; // Stopped or replaced
+        //
+        std::ofstream out(path, std::ios::app);
+        if (!out)
+        {
+            std::cerr << "Warning: Cannot write metrics to " << path << ", stopping the dump.\n";
+            co_return;
+        }
+        m_metrics.snapshot().print(out);
+    }
+}
+//
+void NetworkManager::startMetricsDump(const std::string& path, std::chrono::milliseconds interval)
+{
+    m_metrics.setEnabled(true);
+    boost::asio::post(m_io_context, [this, path, interval]()
+    {
+        if (m_metricsDumpTimer)
+            m_metricsDumpTimer->cancel();
+        m_metricsDumpTimer = std::make_shared<boost::asio::steady_timer>(m_io_context);
+        boost::asio::co_spawn(m_io_context, metricsDumpLoop(m_metricsDumpTimer, path, interval), boost::asio::detached);
+    });
+}
+//
+void NetworkManager::stopMetricsDump()
+{
+    boost::asio::post(m_io_context, [this]()
+    {
+        if (m_metricsDumpTimer)
+            m_metricsDumpTimer->cancel();
+        m_metricsDumpTimer.reset();
+    });
 }
@@ -2,22 +2,108 @@
  * NetworkManager.h
  * This class handles the TCP network communication between the client and the server.
  * Uses Boost.Asio to manage connections, send and receive packets, and handle connection reliability.
+ *
+ * All socket operations are coroutines running on the manager's io_context, which is driven by a
+ * dedicated I/O thread. The async API (asyncSendPacket, asyncReceivePacket, ...) can be awaited from
+ * any coroutine spawned on getExecutor(); the blocking API (sendPacket, receivePacket, ...) is a thin
+ * wrapper that spawns the coroutine and waits for its result, and must not be called from the I/O thread.
  */
 
 #pragma once
 #include "ClientPacket.h"
 #include "ServerPacket.h"
+#include "BufferPool.h"
+#include "MessageSchema.h"
+#include "TransportMetrics.h"
+#include "TransportProfile.h"
 #include <boost/asio.hpp>
 #include <string>
 #include <iostream>
+#include <deque>
+#include <functional>
+#include <optional>
+#include <atomic>
+#include <thread>
+#include <chrono>
+#include <random>
 
 class NetworkManager
 {
+public:
+    /**
+     * Backoff schedule used to reconnect after the connection is lost.
+     * The delay before attempt n+1 is min(maxDelay, initialDelay * multiplier^(n-1)), of which a random
+     * `jitter` fraction is subtracted, so many clients losing the same server do not retry in lockstep.
+     */
+    struct ReconnectPolicy
+    {
+        unsigned                  maxAttempts  = 5;          //< Attempts per reconnect cycle, each trying every endpoint
+        std::chrono::milliseconds initialDelay { 500 };      //< Delay after the first failed attempt
+        std::chrono::milliseconds maxDelay     { 30000 };    //< Upper bound for the delay
+        double                    multiplier   = 2.0;        //< Delay growth per failed attempt
+        double                    jitter       = 0.5;        //< Randomized fraction of the delay, in [0, 1]
+    };
+    /**
+     * Deadlines for socket operations. Read and write deadlines bound each individual socket read or write,
+     * so a large transfer only times out when it stalls, not because it is large.
+     */
+    struct Deadlines
+    {
+        std::chrono::milliseconds connect { 5000 };
+        std::chrono::milliseconds read    { 30000 };
+        std::chrono::milliseconds write   { 30000 };
+    };
+    /**
+     * A server address, as listed in server.info.
+     */
+    struct Endpoint
+    {
+        std::string ip;
+        uint16_t    port = 0;
+    };
+
+private:
     boost::asio::io_context      m_io_context; //< Boost I/O context
+    boost::asio::executor_work_guard<boost::asio::io_context::executor_type> m_workGuard; //< Keeps the I/O thread alive
     boost::asio::ip::tcp::socket m_socket; //< TCP socket
-    bool                         m_connected; //< Connection state
+    std::atomic<bool>            m_connected; //< Connection state
+    std::atomic<bool>            m_reconnecting; //< A background reconnect cycle is running
+    ReconnectPolicy              m_reconnectPolicy; //< Backoff schedule for reconnecting
+    Deadlines                    m_deadlines; //< Per-operation timeouts
+    TransportProfile             m_transportProfile; //< Socket options applied on every connect
+    std::optional<ReqHello>      m_hello; //< Sent first on every new connection, if set
+    RespHello                    m_negotiated; //< Features agreed on by the last hello. Only touched on the I/O thread
+    std::mt19937                 m_jitterRng; //< Randomizes reconnect delays
     std::string                  m_serverIp; //< Server IP address
     uint16_t                     m_serverPort; //< Server Port
+    /**
+     * A known endpoint with its last measured connect latency.
+     */
+    struct EndpointState
+    {
+        Endpoint                                 endpoint;
+        std::optional<std::chrono::microseconds> latency; //< Unset if unmeasured or the last connect failed
+    };
+    std::vector<EndpointState>   m_endpoints; //< Failover candidates, in config order. Only touched on the I/O thread
+    std::atomic<uint32_t>        m_generation; //< Incremented on every successful connect, on the I/O thread
+    std::thread                  m_ioThread; //< Runs m_io_context
+    std::shared_ptr<BufferPool>  m_bufferPool; //< Reusable receive buffers
+    //
+    /**
+     * A queued request waiting to be sent as part of a pipeline, with its completion handler.
+     */
+    struct PendingRequest
+    {
+        ClientPacket                       packet;
+        std::function<void(ServerPacket&)> onResponse;
+    };
+    std::deque<PendingRequest>   m_pipeline; //< Requests queued by queueRequest, not yet sent
+    size_t                       m_maxInFlight; //< Max requests sent before their responses are read
+    size_t                       m_maxPayloadSize; //< Largest payload receivePacket will buffer
+    size_t                       m_maxStreamedPayloadSize; //< Largest payload receivePacketStreaming will accept
+    size_t                       m_streamChunkSize; //< Bytes handed to a streaming sink per call
+    TransportMetrics             m_metrics; //< Wire-level counters and histograms
+    std::shared_ptr<boost::asio::steady_timer> m_metricsDumpTimer; //< Drives the periodic metrics dump, if enabled
     //
     /**
      * @brief Reads exactly `size` bytes from the socket into the buffer.
@@ -25,23 +111,222 @@ class NetworkManager
      * @param size Number of bytes to read.
      * @return True if successful, false otherwise.
      */
-    bool readExact(void* buffer, size_t size);
+    boost::asio::awaitable<bool> readExact(void* buffer, size_t size);
     /**
-     * @brief Writes exactly `size` bytes from the buffer to the socket.
-     * @param buffer Pointer to buffer to write.
-     * @param size Number of bytes to write.
+     * @brief Writes every byte of a buffer sequence to the socket as one vectored (gather) write.
+     * @param buffers Buffers to write, in order.
      * @return True if successful, false otherwise.
      */
-    bool writeExact(const void* buffer, size_t size);
+    boost::asio::awaitable<bool> writeExact(const std::array<boost::asio::const_buffer, 2>& buffers);
+    /**
+     * @brief Applies the transport profile's socket options to the connected socket. Must run on the I/O thread.
+     * Options the platform does not support are skipped, and failures are only reported.
+     */
+    void applyTransportProfile();
+    /**
+     * @brief Re-arms TCP_QUICKACK, which Linux clears again after a few segments. No-op elsewhere.
+     */
+    void rearmQuickAck();
+    /**
+     * @brief Closes the socket. Must run on the I/O thread.
+     */
+    void closeSocket();
+    /**
+     * @brief Closes the socket after a failed read/write and starts a background reconnect cycle.
+     */
+    void handleConnectionLost();
+    /**
+     * @brief Starts asyncReconnect in the background unless a cycle is already running. Must run on the I/O thread.
+     */
+    void startBackgroundReconnect();
+    /**
+     * @brief Makes sure the socket is connected before an operation. Starts a background reconnect if needed
+     * and waits for it for at most the connect deadline, so a dead server never stalls the caller for long.
+     * @return True if connected, false otherwise.
+     */
+    boost::asio::awaitable<bool> ensureConnected();
+    /**
+     * @brief Reads a packet header into `raw` and validates the announced payload size against `maxPayloadSize`.
+     * Drops the connection if the size is over the cap, since the stream cannot be resynchronized.
+     * @param raw Buffer of at least SERVER_HEADER_SIZE bytes receiving the raw header.
+     * @return The parsed header, or std::nullopt on failure.
+     */
+    boost::asio::awaitable<std::optional<ServerPacketHeader>> readHeader(uint8_t* raw, size_t maxPayloadSize);
+    /**
+     * @brief Reads a whole packet from the socket, without checking the connection state first.
+     * @return The packet, or std::nullopt on failure.
+     */
+    boost::asio::awaitable<std::optional<ServerPacket>> readPacket();
+    /**
+     * @brief Sends the hello request on a freshly connected socket and stores what the server agreed to.
+     * A server that does not know the request gets no optional features. Runs before the socket is marked
+     * connected, so no other request can interleave with it.
+     * @return True unless the exchange itself failed.
+     */
+    boost::asio::awaitable<bool> exchangeHello();
+    /**
+     * @brief Runs an asynchronous socket operation, cancelling it if it does not finish within `timeout`.
+     * @param operation Coroutine callable taking a completion token (which reports errors through an
+     *                  error_code instead of throwing) and awaiting the socket operation with it.
+     * @return The operation's error code, or boost::asio::error::timed_out if the deadline expired.
+     */
+    template <typename Operation>
+    boost::asio::awaitable<boost::system::error_code> withDeadline(std::chrono::milliseconds timeout, Operation operation);
+    /**
+     * @brief Stores the latency of the last connect to an endpoint (std::nullopt if it failed), for ranking.
+     */
+    void recordEndpointLatency(const std::string& ip, uint16_t port, std::optional<std::chrono::microseconds> latency);
+    /**
+     * @brief Order in which to try endpoints when reconnecting: the known endpoints fastest first (unmeasured ones
+     * after, in config order), with `current` moved to the front or to the back.
+     */
+    std::vector<Endpoint> failoverOrder(const Endpoint& current, bool currentFirst) const;
+    /**
+     * @brief Marks the socket as connected to the given server. Must run on the I/O thread.
+     */
+    void markConnected(const std::string& ip, uint16_t port);
+    //
+    struct ConnectRace; //< Shared state of asyncConnectFastest and its attempts
+    /**
+     * @brief Connects a fresh socket to one endpoint of a connect race, and hands it to the race if it is the first to succeed.
+     */
+    boost::asio::awaitable<void> raceEndpoint(std::shared_ptr<ConnectRace> race, Endpoint endpoint);
+    /**
+     * @brief Tries the endpoints in order, one pass per reconnect attempt, backing off between passes.
+     */
+    boost::asio::awaitable<bool> asyncReconnectTo(std::vector<Endpoint> order);
+    /**
+     * @brief Computes the jittered backoff delay to wait after `failedAttempts` failed attempts.
+     */
+    std::chrono::milliseconds backoffDelay(unsigned failedAttempts);
+    /**
+     * @brief Spawns `operation` on the I/O thread and blocks until it completes.
+     * @return The operation's result. Exceptions thrown by the operation are rethrown here.
+     */
+    template <typename T>
+    T runBlocking(boost::asio::awaitable<T> operation);
+    /**
+     * @brief Runs `function` on the I/O thread and waits for it (runs it directly when already on the I/O thread).
+     */
+    void runOnIoThread(const std::function<void()>& function);
+    /**
+     * @brief Appends a metrics snapshot to `path` every `interval` until `timer` is cancelled or replaced.
+     */
+    boost::asio::awaitable<void> metricsDumpLoop(std::shared_ptr<boost::asio::steady_timer> timer,
+        std::string path, std::chrono::milliseconds interval);
     /**
      * @brief Prints a standardized connection error message.
      */
     void printConnectionError();
 
 public:
-    NetworkManager(); // CTOR, initializes the socket.
-    ~NetworkManager(); // DTOR, closes the socket.
+    NetworkManager(); // CTOR, initializes the socket and starts the I/O thread.
+    ~NetworkManager(); // DTOR, closes the socket and joins the I/O thread.
+    //
+    /**
+     * @brief Executor of the I/O thread, for spawning coroutines that use the async API.
+     */
+    boost::asio::io_context::executor_type getExecutor() { return m_io_context.get_executor(); }
+    //
+    // === Async API (await from a coroutine running on getExecutor()) ===
+    /**
+     * @brief Resolves and connects to the given IP and port.
+     * @return True if connection was successful, false otherwise.
+     */
+    boost::asio::awaitable<bool> asyncConnect(std::string ip, uint16_t port);
+    /**
+     * @brief Sends a packet to the server, writing the encoded header and the payload as a buffer
+     * sequence so the payload is never copied. `packet` must stay alive until the send completes.
+     * @return True if sent successfully, false otherwise.
+     */
+    boost::asio::awaitable<bool> asyncSendPacket(const ClientPacket& packet);
+    /**
+     * @brief Receives a full packet from the server into a pooled buffer and deserializes it in place.
+     * @return The packet, or std::nullopt if the connection was lost or deserialization failed.
+     */
+    boost::asio::awaitable<std::optional<ServerPacket>> asyncReceivePacket();
+    /**
+     * @brief Receives a packet whose payload is handed to `sink` in chunks of at most the stream chunk size
+     * instead of being buffered whole, so memory use does not depend on the payload size.
+     * If `sink` returns false the rest of the payload is read and discarded and the call fails.
+     * @param sink Called with the packet header and each consecutive payload chunk (not called for an empty payload).
+     * @return The packet header, or std::nullopt if the connection was lost, the payload exceeded the
+     *         streaming size cap, or the sink aborted.
+     */
+    boost::asio::awaitable<std::optional<ServerPacketHeader>> asyncReceivePacketStreaming(
+        std::function<bool(const ServerPacketHeader&, std::span<const uint8_t>)> sink);
+    /**
+     * @brief Connects to every endpoint at once and keeps the first connection that succeeds.
+     * The endpoints become the failover candidates, and the losing attempts keep running in the background
+     * (until the connect deadline) only to measure their latency for ranking.
+     * @return True if any endpoint was reached, false otherwise.
+     */
+    boost::asio::awaitable<bool> asyncConnectFastest(std::vector<Endpoint> endpoints);
+    /**
+     * @brief Tries to reconnect following the reconnect policy (exponential backoff with jitter), waiting on a
+     * timer between attempts without blocking the I/O thread. Each attempt tries the given server first and
+     * then fails over to the other known endpoints, fastest first.
+     */
+    boost::asio::awaitable<bool> asyncReconnect(std::string ip, uint16_t port);
+    /**
+     * @brief Measures the link with ping requests, which the server echoes: `rttSamples` empty pings for
+     * the round-trip time, then one ping carrying `throughputBytes` for the throughput.
+     * @return The measurements, or std::nullopt if a ping failed.
+     */
+    boost::asio::awaitable<std::optional<TransportProbeResult>> asyncProbeTransport(size_t rttSamples, size_t throughputBytes);
+    /**
+     * @brief Sends a typed request and decodes its response (see call).
+     * @throws std::runtime_error if the request does not fit its schema.
+     */
+    template <typename Request>
+    boost::asio::awaitable<MessageReply<Request>> asyncCall(Request request, std::array<uint8_t, CLIENT_ID_LENGTH> senderId)
+    {
+        MessageReply<Request> reply;
+        ClientPacket packet = encodeRequest(request, senderId);
+        if (!co_await asyncSendPacket(packet))
+            co_return reply;
+        //
+        reply.packet = co_await asyncReceivePacket();
+        reply.status = decodeResponse<Request>(reply.packet, reply.response);
+        co_return reply;
+    }
+    /**
+     * @brief Sends typed requests back to back, then reads their responses in order (see asyncCall): one
+     * round trip for all of them. Each reply succeeds or fails on its own; once the connection is lost,
+     * every later reply fails, and so does every earlier one whose response went with it.
+     * @throws std::runtime_error if a request does not fit its schema.
+     */
+    template <typename Request>
+    boost::asio::awaitable<std::vector<MessageReply<Request>>> asyncCallAll(std::vector<Request> requests,
+        std::array<uint8_t, CLIENT_ID_LENGTH> senderId)
+    {
+        // A lost connection takes the responses to the requests sent on it along: after a failed send none
+        // are read, after a reconnect between sends only those of the requests sent on the new connection
+        std::vector<MessageReply<Request>> replies(requests.size());
+        size_t firstOnConnection = 0;
+        uint32_t generation = 0;
+        for (size_t i = 0; i < requests.size(); ++i)
+        {
+            ClientPacket packet = encodeRequest(requests[i], senderId); // one encoded packet held at a time
+            if (!co_await asyncSendPacket(packet))
+                co_return replies;
+            if (i == 0 || m_generation != generation)
+            {
+                firstOnConnection = i;
+                generation = m_generation;
+            }
+        }
+        for (size_t i = firstOnConnection; i < replies.size(); ++i)
+        {
+            replies[i].packet = co_await asyncReceivePacket();
+            replies[i].status = decodeResponse<Request>(replies[i].packet, replies[i].response);
+            if (!replies[i].packet)
+                break;
+        }
+        co_return replies;
+    }
     //
+    // === Blocking API ===
     /**
      * @brief Attempts to connect to the given IP and port.
      * @param ip IP address of the server.
@@ -49,6 +334,18 @@ public:
      * @return True if connection was successful, false otherwise.
      */
     bool ConnectToServer(const std::string& ip, uint16_t port);
+    /**
+     * @brief Races connects to all endpoints and keeps the fastest (see asyncConnectFastest).
+     */
+    bool ConnectToFastest(const std::vector<Endpoint>& endpoints);
+    /**
+     * @brief Sets the failover candidates without connecting. Latencies measured so far are discarded.
+     */
+    void setEndpoints(const std::vector<Endpoint>& endpoints);
+    /**
+     * @brief The endpoint of the current (or last) connection.
+     */
+    Endpoint currentEndpoint() const { return { m_serverIp, m_serverPort }; }
     /**
      * @brief Sends a serialized packet to the server.
      * @param packet The packet to send.
@@ -61,13 +358,134 @@ public:
      * @return True if successful, false if connection lost or deserialization failed.
      */
     bool receivePacket(ServerPacket& packet);
+    /**
+     * @brief Sends a typed request and decodes its response (see MessageSchema.h).
+     * @throws std::runtime_error if the request does not fit its schema.
+     */
+    template <typename Request>
+    MessageReply<Request> call(const Request& request, const std::array<uint8_t, CLIENT_ID_LENGTH>& senderId)
+    {
+        MessageReply<Request> reply;
+        if (!sendPacket(encodeRequest(request, senderId)))
+            return reply;
+        //
+        reply.packet.emplace();
+        if (!receivePacket(*reply.packet))
+            reply.packet.reset();
+        reply.status = decodeResponse<Request>(reply.packet, reply.response);
+        return reply;
+    }
+    /**
+     * @brief Sends several typed requests as one batch and decodes every item of the response, in one round trip.
+     * Each item succeeds or fails on its own; the batch fails as a whole only if the exchange itself fails.
+     * @throws std::runtime_error if a request does not fit its schema.
+     */
+    template <typename... Requests>
+    BatchReply<Requests...> callBatch(const std::array<uint8_t, CLIENT_ID_LENGTH>& senderId, const Requests&... requests)
+    {
+        BatchReply<Requests...> reply;
+        if (!sendPacket(encodeBatch(senderId, requests...)))
+            return reply;
+        //
+        reply.packet.emplace();
+        if (!receivePacket(*reply.packet))
+            reply.packet.reset();
+        decodeBatch(reply);
+        return reply;
+    }
+    /**
+     * @brief Receives a packet and streams its payload to `sink` in bounded chunks (see asyncReceivePacketStreaming).
+     * @param header Output parameter to store the received header.
+     * @return True if the whole payload was delivered, false otherwise.
+     */
+    bool receivePacketStreaming(ServerPacketHeader& header,
+        std::function<bool(const ServerPacketHeader&, std::span<const uint8_t>)> sink);
+    /**
+     * @brief Runs asyncProbeTransport and waits for its result.
+     */
+    std::optional<TransportProbeResult> probeTransport(size_t rttSamples, size_t throughputBytes);
+    /**
+     * @brief Sets the socket options used for this and every later connection.
+     */
+    void setTransportProfile(const TransportProfile& profile);
+    const TransportProfile& getTransportProfile() const { return m_transportProfile; }
+    /**
+     * @brief Sets the hello request sent first on every later connection (std::nullopt to send none).
+     */
+    void setHello(const std::optional<ReqHello>& hello);
+    /**
+     * @brief Returns the features negotiated on the current connection (none before the first hello).
+     */
+    RespHello negotiated();
+    /**
+     * @brief Queues a request for pipelined sending. Nothing is sent until flushPipeline is called.
+     * @param packet The packet to send.
+     * @param onResponse Called with the matching response, in the order the requests were queued.
+     */
+    void queueRequest(ClientPacket packet, std::function<void(ServerPacket&)> onResponse);
+    /**
+     * @brief Sends all queued requests, keeping up to `maxInFlight` of them on the wire at once,
+     * and hands every response to its request's handler in FIFO order.
+     * On failure the remaining requests are dropped and their handlers are not called.
+     * @return True if every queued request got a response, false otherwise.
+     */
+    bool flushPipeline();
+    /**
+     * @brief Sets the hard caps on payload sizes. A packet announcing a larger payload is rejected and the
+     * connection is dropped, so a corrupt size field can never trigger a huge allocation.
+     * @param maxPayloadSize Cap for receivePacket, which buffers the payload whole.
+     * @param maxStreamedPayloadSize Cap for receivePacketStreaming.
+     */
+    void setPayloadLimits(size_t maxPayloadSize, size_t maxStreamedPayloadSize)
+    {
+        m_maxPayloadSize = maxPayloadSize;
+        m_maxStreamedPayloadSize = maxStreamedPayloadSize;
+    }
+    /**
+     * @brief Sets the size of the chunks passed to streaming sinks (at least 1 byte).
+     */
+    void setStreamChunkSize(size_t chunkSize) { m_streamChunkSize = chunkSize ? chunkSize : 1; }
+    /**
+     * @brief Sets the backoff schedule used for reconnecting.
+     */
+    void setReconnectPolicy(const ReconnectPolicy& policy) { m_reconnectPolicy = policy; }
+    /**
+     * @brief Sets the connect/read/write deadlines.
+     */
+    void setDeadlines(const Deadlines& deadlines) { m_deadlines = deadlines; }
+    const Deadlines& getDeadlines() const { return m_deadlines; }
+    /**
+     * @brief True while a background reconnect cycle is running.
+     */
+    bool isReconnecting() const { return m_reconnecting; }
+    /**
+     * @brief Sets the maximum number of requests sent ahead of their responses (at least 1).
+     */
+    void setMaxInFlight(size_t maxInFlight) { m_maxInFlight = maxInFlight ? maxInFlight : 1; }
+    /**
+     * @brief Transport metrics. Recording is off until enabled with getMetrics().setEnabled(true) or startMetricsDump
+     * (the "metrics" option in server.info).
+     */
+    TransportMetrics& getMetrics() { return m_metrics; }
+    /**
+     * @brief Copies the current transport metrics.
+     */
+    TransportMetrics::Snapshot metricsSnapshot() const { return m_metrics.snapshot(); }
+    /**
+     * @brief Enables metrics recording and appends a snapshot to `path` every `interval`, from the I/O thread.
+     * Replaces any dump already running.
+     */
+    void startMetricsDump(const std::string& path, std::chrono::milliseconds interval);
+    /**
+     * @brief Stops the periodic metrics dump, if running. Recording itself stays enabled.
+     */
+    void stopMetricsDump();
     /**
      * @brief Closes the connection.
      */
     void disconnect();
     /**
-    * @brief If the server disconnected try to reconnect 5 times.
+    * @brief Runs a full reconnect cycle (see ReconnectPolicy) and waits for its result.
     */
     bool reconnect(const std::string& ip, uint16_t port);
 };
-
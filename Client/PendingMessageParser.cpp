@@ -0,0 +1,75 @@
+#include "PendingMessageParser.h"
+#include "ByteCodec.h"
+#include <algorithm>
+#include <cstring>
+
+PendingMessageParser::PendingMessageParser(PendingMessageSink sink)
+    : m_sink(std::move(sink)), m_compact(false), m_header{}, m_headerFill(0), m_current{}, m_contentLeft(0), m_messageCount(0) {}
+//
+bool PendingMessageParser::feed(std::span<const uint8_t> chunk)
+{
+    while (!chunk.empty())
+    {
+        // Collect the record header
+        if (!headerComplete())
+        {
+            size_t take = std::min(headerBytesWanted(), chunk.size());
+            std::memcpy(m_header.data() + m_headerFill, chunk.data(), take);
+            m_headerFill += take;
+            chunk = chunk.subspan(take);
+            if (!headerComplete())
+            {
+                if (m_headerFill == MAX_RECORD_HEADER_LEN)
+                    throw std::runtime_error("Pending message content size is out of range\n");
+                continue;
+            }
+            //
+            decodeHeader();
+            m_sink.begin(m_current, m_contentLeft);
+            if (m_contentLeft == 0)
+                finishMessage();
+            continue;
+        }
+        //
+        // Pass on as much of the content as this chunk holds, without copying it
+        size_t take = std::min<size_t>(m_contentLeft, chunk.size());
+        m_sink.data(chunk.first(take));
+        m_contentLeft -= static_cast<uint32_t>(take);
+        chunk = chunk.subspan(take);
+        if (m_contentLeft == 0)
+            finishMessage();
+    }
+    return true;
+}
+//
+bool PendingMessageParser::headerComplete() const
+{
+    if (!m_compact)
+        return m_headerFill == RECORD_HEADER_LEN;
+    // The varint size ends with the first byte that has its high bit clear
+    return m_headerFill > RECORD_PREFIX_LEN && !(m_header[m_headerFill - 1] & 0x80);
+}
+//
+size_t PendingMessageParser::headerBytesWanted() const
+{
+    if (!m_compact)
+        return RECORD_HEADER_LEN - m_headerFill;
+    // Take the fixed prefix and the first size byte at once, then one byte at a time
+    return m_headerFill < RECORD_PREFIX_LEN ? RECORD_PREFIX_LEN + 1 - m_headerFill : 1;
+}
+//
+void PendingMessageParser::decodeHeader()
+{
+    ByteReader reader(std::span<const uint8_t>(m_header.data(), m_headerFill));
+    m_current.senderId = reader.readArray<CLIENT_ID_LENGTH>();
+    m_current.messageId = reader.readU32();
+    m_current.messageType = reader.readU8();
+    m_contentLeft = m_compact ? reader.readVarint() : reader.readU32();
+}
+//
+void PendingMessageParser::finishMessage()
+{
+    m_sink.end();
+    m_messageCount++;
+    m_headerFill = 0;
+}
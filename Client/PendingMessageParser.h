@@ -0,0 +1,91 @@
+/*
+    PendingMessageParser.h
+
+    Incremental parser for the pending-messages response payload
+    (sender ID, message ID, type, content size, content - repeated). The content size is 4 bytes in the
+    legacy encoding and a varint in the compact one, selected by the protocol version of the response.
+    The payload can be fed in arbitrary chunks as it arrives from the network. Each message is passed
+    on as it arrives - its header, then its content in the pieces it was received in, then its end -
+    so nothing beyond one record header is buffered, however large the content is.
+*/
+
+#pragma once
+#include "Utility.h"
+#include "ByteCodec.h"
+#include <span>
+#include <functional>
+
+/**
+ * A single parsed pending message. `content` is only valid during the callback.
+ */
+struct PendingMessage
+{
+    std::array<uint8_t, CLIENT_ID_LENGTH> senderId;
+    uint32_t                              messageId;
+    uint8_t                               messageType;
+    std::span<const uint8_t>              content;
+};
+//
+/**
+ * Receives the messages of a PendingMessageParser. For every message: `begin` once (the header fields; `content`
+ * is empty), `data` for each piece of the content as it arrives (never empty, not called for empty content),
+ * then `end`. Pieces point into the fed chunk and are only valid during the call.
+ */
+struct PendingMessageSink
+{
+    std::function<void(const PendingMessage& header, uint32_t contentSize)> begin;
+    std::function<void(std::span<const uint8_t> piece)>                      data;
+    std::function<void()>                                                    end;
+};
+
+class PendingMessageParser
+{
+public:
+    static constexpr size_t RECORD_PREFIX_LEN = CLIENT_ID_LENGTH + MSG_ID_LEN + MESSAGE_TYPE_LEN; //< Header before the size
+    static constexpr size_t RECORD_HEADER_LEN = RECORD_PREFIX_LEN + MESSAGE_CONTENT_LEN;
+    static constexpr size_t MAX_RECORD_HEADER_LEN = RECORD_PREFIX_LEN + MAX_VARINT_LEN;
+private:
+    PendingMessageSink                          m_sink;
+    bool                                        m_compact; //< Content sizes are varints
+    std::array<uint8_t, MAX_RECORD_HEADER_LEN>  m_header; //< Header of the message being parsed
+    size_t                                      m_headerFill; //< Header bytes received so far
+    PendingMessage                              m_current; //< Fields of the message being parsed
+    uint32_t                                    m_contentLeft; //< Content bytes of the current message still to come
+    size_t                                      m_messageCount; //< Messages delivered
+    //
+    /**
+     * @brief True once the whole header of the current record is buffered.
+     */
+    bool headerComplete() const;
+    /**
+     * @brief Number of header bytes that can be taken from the input without reading past the header.
+     */
+    size_t headerBytesWanted() const;
+    /**
+     * @brief Decodes the buffered record header into m_current and m_contentLeft.
+     */
+    void decodeHeader();
+    /**
+     * @brief Ends the current message and resets for the next one.
+     */
+    void finishMessage();
+public:
+    explicit PendingMessageParser(PendingMessageSink sink);
+    /**
+     * @brief Selects the record encoding from the protocol version of the response. Call on a message boundary.
+     */
+    void setProtocolVersion(uint8_t version) { m_compact = version >= PROTOCOL_VERSION_COMPACT; }
+    /**
+     * @brief Consumes the next chunk of the payload.
+     * @return Always true, so it can be used directly as a streaming sink.
+     */
+    bool feed(std::span<const uint8_t> chunk);
+    /**
+     * @brief True if the data fed so far ends on a message boundary.
+     */
+    bool atMessageBoundary() const { return m_headerFill == 0; }
+    /**
+     * @brief Number of messages ended so far.
+     */
+    size_t messageCount() const { return m_messageCount; }
+};
@@ -53,18 +53,21 @@ std::string RSAPublicWrapper::encrypt(const char* plain, unsigned int length)
 RSAPrivateWrapper::RSAPrivateWrapper()
 {
 	_privateKey.Initialize(_rng, BITS);
+	_decryptor.AccessKey() = _privateKey;
 }
 
 RSAPrivateWrapper::RSAPrivateWrapper(const char* key, unsigned int length)
 {
 	CryptoPP::StringSource ss(reinterpret_cast<const CryptoPP::byte*>(key), length, true);
 	_privateKey.Load(ss);
+	_decryptor.AccessKey() = _privateKey;
 }
 
 RSAPrivateWrapper::RSAPrivateWrapper(const std::string& key)
 {
 	CryptoPP::StringSource ss(key, true);
 	_privateKey.Load(ss);
+	_decryptor.AccessKey() = _privateKey;
 }
 
 RSAPrivateWrapper::~RSAPrivateWrapper()
@@ -105,16 +108,18 @@ char* RSAPrivateWrapper::getPublicKey(char* keyout, unsigned int length) const
 
 std::string RSAPrivateWrapper::decrypt(const std::string& cipher)
 {
-	std::string decrypted;
-	CryptoPP::RSAES_OAEP_SHA_Decryptor d(_privateKey);
-	CryptoPP::StringSource ss_cipher(cipher, true, new CryptoPP::PK_DecryptorFilter(_rng, d, new CryptoPP::StringSink(decrypted)));
-	return decrypted;
+	return decrypt(cipher.data(), static_cast<unsigned int>(cipher.size()));
 }
 
 std::string RSAPrivateWrapper::decrypt(const char* cipher, unsigned int length)
 {
-	std::string decrypted;
-	CryptoPP::RSAES_OAEP_SHA_Decryptor d(_privateKey);
-	CryptoPP::StringSource ss_cipher(reinterpret_cast<const CryptoPP::byte*>(cipher), length, true, new CryptoPP::PK_DecryptorFilter(_rng, d, new CryptoPP::StringSink(decrypted)));
+	if (length != _decryptor.FixedCiphertextLength())
+		throw CryptoPP::InvalidCiphertext("RSAPrivateWrapper: invalid ciphertext length");
+	std::string decrypted(_decryptor.MaxPlaintextLength(length), '\0');
+	CryptoPP::DecodingResult result = _decryptor.Decrypt(_rng, reinterpret_cast<const CryptoPP::byte*>(cipher), length,
+		reinterpret_cast<CryptoPP::byte*>(&decrypted[0]));
+	if (!result.isValidCoding)
+		throw CryptoPP::InvalidCiphertext("RSAPrivateWrapper: invalid ciphertext");
+	decrypted.resize(result.messageLength);
 	return decrypted;
 }
@@ -41,6 +41,7 @@ public:
 private:
 	CryptoPP::AutoSeededRandomPool _rng;
 	CryptoPP::RSA::PrivateKey _privateKey;
+	CryptoPP::RSAES_OAEP_SHA_Decryptor _decryptor; // built once from _privateKey (CRT parameters included), reused by decrypt
 
 	RSAPrivateWrapper(const RSAPrivateWrapper& rsaprivate);
 	RSAPrivateWrapper& operator=(const RSAPrivateWrapper& rsaprivate);
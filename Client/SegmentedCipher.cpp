@@ -0,0 +1,108 @@
+#include "SegmentedCipher.h"
+#include "AESWrapper.h"
+#include <boost/asio/post.hpp>
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <exception>
+#include <algorithm>
+#include <cstring>
+
+namespace
+{
+    unsigned resolveThreadCount(unsigned threads)
+    {
+        if (threads > 0)
+            return threads;
+        unsigned hardware = std::thread::hardware_concurrency();
+        return hardware > 0 ? hardware : 1;
+    }
+}
+//
+SegmentedCipher::SegmentedCipher(unsigned threads)
+    : m_threadCount(resolveThreadCount(threads)), m_workers(m_threadCount)
+{ }
+//
+SegmentedCipher::~SegmentedCipher()
+{
+    m_workers.join();
+}
+//
+void SegmentedCipher::applySegment(const unsigned char* key, uint64_t nonce, uint64_t position, std::span<uint8_t> segment)
+{
+    // Counter block: nonce (8 bytes) + block index (8 bytes), both big endian; Seek sets the block index
+    CryptoPP::byte counter[CryptoPP::AES::BLOCKSIZE] = { 0 };
+    for (size_t i = 0; i < sizeof(nonce); ++i)
+        counter[i] = static_cast<CryptoPP::byte>(nonce >> (8 * (sizeof(nonce) - 1 - i)));
+    //
+    CryptoPP::CTR_Mode<CryptoPP::AES>::Encryption ctr;
+    ctr.SetKeyWithIV(key, AESWrapper::DEFAULT_KEYLENGTH, counter);
+    ctr.Seek(position);
+    ctr.ProcessData(segment.data(), segment.data(), segment.size());
+}
+//
+void SegmentedCipher::apply(const unsigned char* key, uint64_t nonce, uint64_t position, std::span<uint8_t> data)
+{
+    // One segment per worker, block aligned, unless that would make them smaller than MIN_SEGMENT_SIZE
+    size_t segmentCount = std::min<size_t>(m_threadCount, data.size() / MIN_SEGMENT_SIZE);
+    if (segmentCount <= 1)
+    {
+        applySegment(key, nonce, position, data);
+        return;
+    }
+    //
+    const size_t blockSize = CryptoPP::AES::BLOCKSIZE;
+    size_t segmentSize = ((data.size() + segmentCount - 1) / segmentCount + blockSize - 1) / blockSize * blockSize;
+    segmentCount = (data.size() + segmentSize - 1) / segmentSize;
+    forEachAsync(segmentCount, [&](size_t index)
+    {
+        size_t offset = index * segmentSize;
+        applySegment(key, nonce, position + offset, data.subspan(offset, std::min(segmentSize, data.size() - offset)));
+    }).get();
+}
+//
+std::future<void> SegmentedCipher::forEachAsync(size_t count, std::function<void(size_t)> job)
+{
+    // Shared by the jobs; the last one to finish completes the future
+    struct Batch
+    {
+        std::function<void(size_t)> job;
+        std::atomic<size_t>         remaining;
+        std::mutex                  failureMutex;
+        std::exception_ptr          failure;
+        std::promise<void>          done;
+    };
+    std::shared_ptr<Batch> batch = std::make_shared<Batch>();
+    batch->job = std::move(job);
+    batch->remaining = count;
+    std::future<void> result = batch->done.get_future();
+    if (count == 0)
+    {
+        batch->done.set_value();
+        return result;
+    }
+    for (size_t index = 0; index < count; ++index)
+    {
+        boost::asio::post(m_workers, [batch, index]()
+        {
+            try
+            {
+                batch->job(index);
+            }
+            catch (...)
+            {
+                std::lock_guard<std::mutex> lock(batch->failureMutex);
+                if (!batch->failure)
+                    batch->failure = std::current_exception();
+            }
+            if (--batch->remaining > 0)
+                return;
+            if (batch->failure)
+                batch->done.set_exception(batch->failure);
+            else
+                batch->done.set_value();
+        });
+    }
+    return result;
+}
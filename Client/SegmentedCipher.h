@@ -0,0 +1,58 @@
+/**
+ * SegmentedCipher.h
+ * Parallel AES-CTR for file transfers (MSG_FLAG_SEGMENTED). A file is one CTR keystream, identified by
+ * the transfer's file ID and indexed by byte position, so every segment of it can be encrypted on its
+ * own: data is cut into one segment per worker (none smaller than MIN_SEGMENT_SIZE) that are processed
+ * in place on a worker pool. Each segment writes only its own bytes, so the output does not depend on
+ * thread count or scheduling. The pool also runs other per-chunk work (see forEachAsync).
+ *
+ * The counter block is the file ID (8 bytes, big endian) followed by the block index within the file
+ * (8 bytes, big endian). Encryption and decryption are the same operation.
+ */
+
+#pragma once
+#include <boost/asio/thread_pool.hpp>
+#include <cstdint>
+#include <functional>
+#include <future>
+#include <span>
+
+class SegmentedCipher
+{
+public:
+    static constexpr size_t MIN_SEGMENT_SIZE = 64 * 1024; //< Smallest unit of work worth handing to a worker
+private:
+    unsigned                 m_threadCount;
+    boost::asio::thread_pool m_workers;
+public:
+    /**
+     * @param threads Worker count, 0 for one per hardware thread.
+     */
+    explicit SegmentedCipher(unsigned threads = 0);
+    ~SegmentedCipher();
+    SegmentedCipher(const SegmentedCipher&) = delete;
+    SegmentedCipher& operator=(const SegmentedCipher&) = delete;
+    //
+    /**
+     * @brief Encrypts or decrypts `data` in place: the bytes at `position` of the keystream for `nonce`.
+     * Splits `data` into up to getThreadCount() segments that run in parallel on the worker pool; returns
+     * when all of them are done. Thread-safe, but must not be called from a job running on the pool.
+     *
+     * @param key An AESWrapper::DEFAULT_KEYLENGTH byte key.
+     * @param nonce Identifies the keystream (the file ID); must never repeat under the same key.
+     * @param position Byte offset of `data` within the stream.
+     */
+    void apply(const unsigned char* key, uint64_t nonce, uint64_t position, std::span<uint8_t> data);
+    /**
+     * @brief Same as apply, on the calling thread. For jobs that already run on the pool (see forEachAsync).
+     */
+    static void applySegment(const unsigned char* key, uint64_t nonce, uint64_t position, std::span<uint8_t> segment);
+    /**
+     * @brief Runs `job(0)` .. `job(count - 1)` on the worker pool and returns at once.
+     * @return Becomes ready when every job has finished; holds the first exception a job threw.
+     * `job` and everything it refers to must stay alive until then.
+     */
+    std::future<void> forEachAsync(size_t count, std::function<void(size_t)> job);
+    //
+    unsigned getThreadCount() const { return m_threadCount; }
+};
@@ -1,5 +1,4 @@
 #include "ServerPacket.h"
-#include <WinSock2.h>
 #include <stdexcept>
 
 ServerPacketHeader::ServerPacketHeader()
@@ -13,34 +12,31 @@ ServerPacketHeader::ServerPacketHeader(uint16_t opCode, uint32_t size)
     : version(PROTOCOL_VERSION), code(opCode), payloadsize(size) {}
 
 
-ServerPacket::ServerPacket()
-{
-    ServerPacketHeader defHeader;
-    this->header = defHeader;
-    this->payload = {};
-}
+ServerPacket::ServerPacket() : header(), buffer() {}
 
-ServerPacket::ServerPacket(const uint16_t opCode, const std::vector<uint8_t>& data)
-    : header(opCode, data.size()), payload(data) {}
+ServerPacket::ServerPacket(const ServerPacketHeader& hdr, BufferPool::Lease&& data)
+    : header(hdr), buffer(std::move(data)) {}
 
-ServerPacket ServerPacket::deserialize(const std::vector<uint8_t>& buffer)
+ServerPacket ServerPacket::deserialize(BufferPool::Lease&& raw)
 {
-    if (buffer.size() < SERVER_HEADER_SIZE)
+    if (raw.size() < SERVER_HEADER_SIZE)
         throw std::runtime_error("Invalid packet size\n");
     //
-    size_t pos = 0;
-    uint8_t version = buffer[pos];
-    pos += VERSION_LENGTH;
+    ServerPacketHeader hdr = parseHeader(raw.data());
+    if (raw.size() < SERVER_HEADER_SIZE + static_cast<size_t>(hdr.payloadsize))
+        throw std::runtime_error("Packet shorter than its declared payload size\n");
     //
-    uint16_t code;
-    std::memcpy(&code, buffer.data() + pos, CODE_LENGTH);
-    pos += CODE_LENGTH;
-    //
-    uint32_t payloadSize;
-    std::memcpy(&payloadSize, buffer.data() + pos, PAYLOAD_SIZE_LENGTH);
-    pos += PAYLOAD_SIZE_LENGTH;
-    //
-    std::vector<uint8_t> payload(buffer.begin() + SERVER_HEADER_SIZE, buffer.end());
-    return ServerPacket(code, payload);
+    return ServerPacket(hdr, std::move(raw));
 }
 
+ServerPacketHeader ServerPacket::parseHeader(const uint8_t* raw)
+{
+    return ServerHeaderCodec::decode(raw);
+}
+
+std::span<const uint8_t> ServerPacket::getPayload() const
+{
+    if (buffer.size() < SERVER_HEADER_SIZE)
+        return {};
+    return std::span<const uint8_t>(buffer.data() + SERVER_HEADER_SIZE, header.payloadsize);
+}
@@ -1,6 +1,9 @@
 #pragma once
 #include "Utility.h"
+#include "BufferPool.h"
+#include "WireHeader.h"
 #include <cstring>
+#include <span>
 struct ServerPacketHeader
 {
     uint8_t version;
@@ -10,23 +13,44 @@ struct ServerPacketHeader
     ServerPacketHeader();
     ServerPacketHeader(uint16_t opCode, uint32_t size);
 };
+//
+// Wire layout of the response header. The server packs it with struct "<BHI", so integers are little endian.
+using ServerHeaderCodec = WireLayout<
+    WireField<&ServerPacketHeader::version>,
+    WireField<&ServerPacketHeader::code, ByteOrder::Little>,
+    WireField<&ServerPacketHeader::payloadsize, ByteOrder::Little>>;
+static_assert(ServerHeaderCodec::size == SERVER_HEADER_SIZE);
+static_assert(ServerHeaderCodec::offsetOf<1> == VERSION_LENGTH);
+static_assert(ServerHeaderCodec::offsetOf<2> == SERVER_PAYLOAD_SIZE_OFFSET);
 
+/**
+ * A received server packet. The packet owns the (pooled) receive buffer it was read into and
+ * exposes the payload as a non-owning view into it, so no payload bytes are copied after the read.
+ * The view returned by getPayload() is valid as long as the packet is alive.
+ */
 class ServerPacket
 {
-    ServerPacketHeader   header;
-    std::vector<uint8_t> payload;
+    ServerPacketHeader header;
+    BufferPool::Lease  buffer; //< Raw packet bytes (header followed by payload)
 public:
     //
     ServerPacket();
-    ServerPacket(const uint16_t opCode, const std::vector<uint8_t>& data);
+    ServerPacket(const ServerPacketHeader& hdr, BufferPool::Lease&& data);
     //
-    static ServerPacket deserialize(const std::vector<uint8_t>& buffer);
+    /**
+     * @brief Parses the header of a raw packet buffer and takes ownership of the buffer.
+     * @throws std::runtime_error if the buffer is shorter than the header or the declared payload.
+     */
+    static ServerPacket deserialize(BufferPool::Lease&& raw);
+    /**
+     * @brief Parses a raw SERVER_HEADER_SIZE-byte header (see ServerHeaderCodec).
+     */
+    static ServerPacketHeader parseHeader(const uint8_t* raw);
     // Getters:
-    uint8_t  getVersion() { return header.version; }
-    uint16_t getCode() { return header.code; }
-    std::vector<uint8_t> getPayload() { return payload; }
+    uint8_t  getVersion() const { return header.version; }
+    uint16_t getCode() const { return header.code; }
+    std::span<const uint8_t> getPayload() const;
     //
     // Setters:
     void setCode(uint16_t opCode) { header.code = opCode; }
 };
-
@@ -0,0 +1,173 @@
+#include "TransportMetrics.h"
+#include "Utility.h"
+#include <algorithm>
+#include <bit>
+
+constexpr std::memory_order relaxed = std::memory_order_relaxed;
+
+void TransportMetrics::AtomicHistogram::record(std::chrono::steady_clock::duration elapsed)
+{
+    uint64_t micros = static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::microseconds>(elapsed).count());
+    size_t bucket = std::min<size_t>(std::bit_width(micros), HISTOGRAM_BUCKETS - 1);
+    //
+    buckets[bucket].fetch_add(1, relaxed);
+    count.fetch_add(1, relaxed);
+    totalMicros.fetch_add(micros, relaxed);
+    uint64_t previousMax = maxMicros.load(relaxed);
+    while (micros > previousMax && !maxMicros.compare_exchange_weak(previousMax, micros, relaxed))
+        ;
+}
+//
+TransportMetrics::HistogramSnapshot TransportMetrics::AtomicHistogram::snapshot() const
+{
+    HistogramSnapshot snap;
+    snap.count = count.load(relaxed);
+    snap.totalMicros = totalMicros.load(relaxed);
+    snap.maxMicros = maxMicros.load(relaxed);
+    for (size_t i = 0; i < HISTOGRAM_BUCKETS; i++)
+        snap.buckets[i] = buckets[i].load(relaxed);
+    return snap;
+}
+//
+size_t TransportMetrics::slotOf(uint16_t code)
+{
+    if (code >= CODE_REGISTER_USER && code < CODE_REGISTER_USER + RESPONSE_SLOT_BASE)
+        return REQUEST_SLOT_BASE + (code - CODE_REGISTER_USER);
+    if (code >= RESP_CODE_REGISTER_SUCCCESS && code < RESP_CODE_REGISTER_SUCCCESS + (ERROR_SLOT - RESPONSE_SLOT_BASE))
+        return RESPONSE_SLOT_BASE + (code - RESP_CODE_REGISTER_SUCCCESS);
+    if (code == RESP_CODE_ERROR)
+        return ERROR_SLOT;
+    return OTHER_SLOT;
+}
+//
+uint16_t TransportMetrics::codeOf(size_t slot)
+{
+    if (slot < RESPONSE_SLOT_BASE)
+        return static_cast<uint16_t>(CODE_REGISTER_USER + (slot - REQUEST_SLOT_BASE));
+    if (slot < ERROR_SLOT)
+        return static_cast<uint16_t>(RESP_CODE_REGISTER_SUCCCESS + (slot - RESPONSE_SLOT_BASE));
+    if (slot == ERROR_SLOT)
+        return RESP_CODE_ERROR;
+    return CODE_DEFAULT; // Reported as opcode 0: "other"
+}
+//
+std::vector<TransportMetrics::OpcodeTraffic> TransportMetrics::collect(const std::array<AtomicTraffic, OPCODE_SLOTS>& traffic)
+{
+    std::vector<OpcodeTraffic> result;
+    for (size_t slot = 0; slot < OPCODE_SLOTS; slot++)
+    {
+        uint64_t packets = traffic[slot].packets.load(relaxed);
+        if (packets != 0)
+            result.push_back({ codeOf(slot), packets, traffic[slot].bytes.load(relaxed) });
+    }
+    return result;
+}
+//
+void TransportMetrics::addTraffic(std::array<AtomicTraffic, OPCODE_SLOTS>& traffic, uint16_t code, uint64_t bytes)
+{
+    AtomicTraffic& slot = traffic[slotOf(code)];
+    slot.packets.fetch_add(1, relaxed);
+    slot.bytes.fetch_add(bytes, relaxed);
+}
+//
+void TransportMetrics::addRead(std::chrono::steady_clock::duration elapsed, bool shortRead)
+{
+    m_readTime.record(elapsed);
+    if (shortRead)
+        m_shortReads.fetch_add(1, relaxed);
+}
+//
+void TransportMetrics::addWrite(std::chrono::steady_clock::duration elapsed)
+{
+    m_writeTime.record(elapsed);
+}
+//
+void TransportMetrics::addConnect(std::chrono::steady_clock::duration elapsed, bool success)
+{
+    if (success)
+        m_connectTime.record(elapsed);
+    else
+        m_connectFailures.fetch_add(1, relaxed);
+}
+//
+void TransportMetrics::addReconnectAttempt()
+{
+    m_reconnectAttempts.fetch_add(1, relaxed);
+}
+//
+void TransportMetrics::addReconnectOutcome(bool success)
+{
+    (success ? m_reconnectSuccesses : m_reconnectFailures).fetch_add(1, relaxed);
+}
+//
+TransportMetrics::Snapshot TransportMetrics::snapshot() const
+{
+    Snapshot snap;
+    snap.sent = collect(m_sent);
+    snap.received = collect(m_received);
+    snap.readTime = m_readTime.snapshot();
+    snap.writeTime = m_writeTime.snapshot();
+    snap.connectTime = m_connectTime.snapshot();
+    snap.connectFailures = m_connectFailures.load(relaxed);
+    snap.reconnectAttempts = m_reconnectAttempts.load(relaxed);
+    snap.reconnectSuccesses = m_reconnectSuccesses.load(relaxed);
+    snap.reconnectFailures = m_reconnectFailures.load(relaxed);
+    snap.shortReads = m_shortReads.load(relaxed);
+    return snap;
+}
+//
+void TransportMetrics::reset()
+{
+    for (size_t slot = 0; slot < OPCODE_SLOTS; slot++)
+    {
+        m_sent[slot].packets = 0;
+        m_sent[slot].bytes = 0;
+        m_received[slot].packets = 0;
+        m_received[slot].bytes = 0;
+    }
+    for (AtomicHistogram* histogram : { &m_readTime, &m_writeTime, &m_connectTime })
+    {
+        histogram->count = 0;
+        histogram->totalMicros = 0;
+        histogram->maxMicros = 0;
+        for (std::atomic<uint64_t>& bucket : histogram->buckets)
+            bucket = 0;
+    }
+    m_connectFailures = 0;
+    m_reconnectAttempts = 0;
+    m_reconnectSuccesses = 0;
+    m_reconnectFailures = 0;
+    m_shortReads = 0;
+}
+//
+static void printHistogram(std::ostream& os, const char* name, const TransportMetrics::HistogramSnapshot& histogram)
+{
+    os << name << ": count=" << histogram.count << " total=" << histogram.totalMicros << "us";
+    if (histogram.count != 0)
+        os << " avg=" << histogram.totalMicros / histogram.count << "us max=" << histogram.maxMicros << "us";
+    os << "\n";
+    //
+    for (size_t i = 0; i < TransportMetrics::HISTOGRAM_BUCKETS; i++)
+    {
+        if (histogram.buckets[i] == 0)
+            continue;
+        uint64_t upper = 1ULL << i;
+        os << "  <" << upper << "us: " << histogram.buckets[i] << "\n";
+    }
+}
+//
+void TransportMetrics::Snapshot::print(std::ostream& os) const
+{
+    os << "=== Transport metrics ===\n";
+    for (const OpcodeTraffic& traffic : sent)
+        os << "sent     code " << traffic.code << ": " << traffic.packets << " packets, " << traffic.bytes << " bytes\n";
+    for (const OpcodeTraffic& traffic : received)
+        os << "received code " << traffic.code << ": " << traffic.packets << " packets, " << traffic.bytes << " bytes\n";
+    printHistogram(os, "read time", readTime);
+    printHistogram(os, "write time", writeTime);
+    printHistogram(os, "connect time", connectTime);
+    os << "connect failures: " << connectFailures << "\n"
+        << "reconnect attempts: " << reconnectAttempts
+        << " (cycles succeeded: " << reconnectSuccesses << ", gave up: " << reconnectFailures << ")\n"
+        << "short reads: " << shortReads << "\n";
+}
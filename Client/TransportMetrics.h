@@ -0,0 +1,136 @@
+/*
+    TransportMetrics.h
+
+    Counters and latency histograms for the NetworkManager transport: bytes and packets per opcode in
+    each direction, time spent in socket reads/writes, connect latency, reconnect attempts and outcomes,
+    and short reads. All counters are relaxed atomics, so recording is cheap and can happen on the I/O
+    thread while another thread takes a snapshot.
+
+    Recording can be switched off at runtime (setEnabled) or compiled out entirely by defining
+    TRANSPORT_METRICS_ENABLED as 0, in which case every record* call is an empty inline function.
+*/
+
+#pragma once
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <ostream>
+#include <vector>
+
+#ifndef TRANSPORT_METRICS_ENABLED
+#define TRANSPORT_METRICS_ENABLED 1
+#endif
+
+class TransportMetrics
+{
+public:
+    static constexpr size_t HISTOGRAM_BUCKETS = 32; //< Bucket i counts durations in [2^(i-1), 2^i) microseconds
+    //
+    /**
+     * Plain-value copy of a latency histogram.
+     */
+    struct HistogramSnapshot
+    {
+        uint64_t                                count = 0;
+        uint64_t                                totalMicros = 0;
+        uint64_t                                maxMicros = 0;
+        std::array<uint64_t, HISTOGRAM_BUCKETS> buckets{};
+    };
+    /**
+     * Traffic for a single opcode in one direction.
+     */
+    struct OpcodeTraffic
+    {
+        uint16_t code = 0;
+        uint64_t packets = 0;
+        uint64_t bytes = 0; //< Header and payload
+    };
+    /**
+     * Plain-value copy of all metrics at one point in time.
+     */
+    struct Snapshot
+    {
+        std::vector<OpcodeTraffic> sent; //< Only opcodes with traffic
+        std::vector<OpcodeTraffic> received; //< Only opcodes with traffic
+        HistogramSnapshot          readTime;
+        HistogramSnapshot          writeTime;
+        HistogramSnapshot          connectTime;
+        uint64_t                   connectFailures = 0;
+        uint64_t                   reconnectAttempts = 0;
+        uint64_t                   reconnectSuccesses = 0; //< Reconnect cycles that ended connected
+        uint64_t                   reconnectFailures = 0; //< Reconnect cycles that gave up
+        uint64_t                   shortReads = 0; //< Socket reads that returned less than requested
+        //
+        /**
+         * @brief Writes a human-readable report.
+         */
+        void print(std::ostream& os) const;
+    };
+private:
+    // Opcode slots: requests 600-699, responses 2100-2199, the error response, and everything else
+    static constexpr size_t REQUEST_SLOT_BASE  = 0;
+    static constexpr size_t RESPONSE_SLOT_BASE = 100;
+    static constexpr size_t ERROR_SLOT         = 200;
+    static constexpr size_t OTHER_SLOT         = 201;
+    static constexpr size_t OPCODE_SLOTS       = 202;
+    //
+    struct AtomicTraffic
+    {
+        std::atomic<uint64_t> packets{ 0 };
+        std::atomic<uint64_t> bytes{ 0 };
+    };
+    struct AtomicHistogram
+    {
+        std::atomic<uint64_t>                                count{ 0 };
+        std::atomic<uint64_t>                                totalMicros{ 0 };
+        std::atomic<uint64_t>                                maxMicros{ 0 };
+        std::array<std::atomic<uint64_t>, HISTOGRAM_BUCKETS> buckets{};
+        //
+        void record(std::chrono::steady_clock::duration elapsed);
+        HistogramSnapshot snapshot() const;
+    };
+    //
+    std::atomic<bool>                          m_enabled{ false };
+    std::array<AtomicTraffic, OPCODE_SLOTS>    m_sent;
+    std::array<AtomicTraffic, OPCODE_SLOTS>    m_received;
+    AtomicHistogram                            m_readTime;
+    AtomicHistogram                            m_writeTime;
+    AtomicHistogram                            m_connectTime;
+    std::atomic<uint64_t>                      m_connectFailures{ 0 };
+    std::atomic<uint64_t>                      m_reconnectAttempts{ 0 };
+    std::atomic<uint64_t>                      m_reconnectSuccesses{ 0 };
+    std::atomic<uint64_t>                      m_reconnectFailures{ 0 };
+    std::atomic<uint64_t>                      m_shortReads{ 0 };
+    //
+    static size_t   slotOf(uint16_t code);
+    static uint16_t codeOf(size_t slot);
+    static std::vector<OpcodeTraffic> collect(const std::array<AtomicTraffic, OPCODE_SLOTS>& traffic);
+    //
+    void addTraffic(std::array<AtomicTraffic, OPCODE_SLOTS>& traffic, uint16_t code, uint64_t bytes);
+    void addRead(std::chrono::steady_clock::duration elapsed, bool shortRead);
+    void addWrite(std::chrono::steady_clock::duration elapsed);
+    void addConnect(std::chrono::steady_clock::duration elapsed, bool success);
+    void addReconnectAttempt();
+    void addReconnectOutcome(bool success);
+public:
+    void setEnabled(bool enabled) { m_enabled.store(enabled, std::memory_order_relaxed); }
+    bool isEnabled() const { return TRANSPORT_METRICS_ENABLED && m_enabled.load(std::memory_order_relaxed); }
+    /**
+     * @brief Copies the current values of all metrics.
+     */
+    Snapshot snapshot() const;
+    /**
+     * @brief Resets all metrics to zero.
+     */
+    void reset();
+    //
+    // === Recording (no-ops while disabled) ===
+    void recordSent(uint16_t code, uint64_t bytes) { if (isEnabled()) addTraffic(m_sent, code, bytes); }
+    void recordReceived(uint16_t code, uint64_t bytes) { if (isEnabled()) addTraffic(m_received, code, bytes); }
+    void recordRead(std::chrono::steady_clock::duration elapsed, bool shortRead) { if (isEnabled()) addRead(elapsed, shortRead); }
+    void recordWrite(std::chrono::steady_clock::duration elapsed) { if (isEnabled()) addWrite(elapsed); }
+    void recordConnect(std::chrono::steady_clock::duration elapsed, bool success) { if (isEnabled()) addConnect(elapsed, success); }
+    void recordReconnectAttempt() { if (isEnabled()) addReconnectAttempt(); }
+    void recordReconnectOutcome(bool success) { if (isEnabled()) addReconnectOutcome(success); }
+};
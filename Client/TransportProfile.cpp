@@ -0,0 +1,69 @@
+#include "TransportProfile.h"
+#include <stdexcept>
+
+#define THROUGHPUT_BUFFER_SIZE (4 * 1024 * 1024) // 4 MB
+
+std::optional<TransportProfile> TransportProfile::preset(const std::string& name)
+{
+    TransportProfile profile;
+    profile.name = name;
+    if (name == "low-latency")
+        return profile;
+    if (name == "throughput")
+    {
+        profile.sendBufferSize = THROUGHPUT_BUFFER_SIZE;
+        profile.receiveBufferSize = THROUGHPUT_BUFFER_SIZE;
+        return profile;
+    }
+    if (name == "auto")
+    {
+        profile.autoTune = true;
+        return profile;
+    }
+    if (name == "default")
+    {
+        profile.noDelay = false;
+        profile.quickAck = false;
+        profile.keepAlive = false;
+        profile.keepAliveIdle = std::chrono::seconds(0);
+        return profile;
+    }
+    return std::nullopt;
+}
+//
+bool TransportProfile::setOption(const std::string& key, const std::string& value)
+{
+    try
+    {
+        int number = std::stoi(value);
+        if (number < 0)
+            return false;
+        //
+        if (key == "tcp_nodelay")
+            noDelay = number != 0;
+        else if (key == "quickack")
+            quickAck = number != 0;
+        else if (key == "keepalive")
+            keepAlive = number != 0;
+        else if (key == "keepalive_idle")
+            keepAliveIdle = std::chrono::seconds(number);
+        else if (key == "send_buffer")
+            sendBufferSize = number;
+        else if (key == "recv_buffer")
+            receiveBufferSize = number;
+        else
+            return false;
+        return true;
+    }
+    catch (const std::exception&)
+    {
+        return false;
+    }
+}
+//
+void TransportProbeResult::print(std::ostream& os) const
+{
+    os << "RTT: min " << minRtt.count() << "us, avg " << avgRtt.count() << "us\n"
+        << "Throughput: " << static_cast<uint64_t>(throughput / 1024) << " KB/s\n"
+        << "Suggested socket buffer size: " << suggestedBufferSize << " bytes\n";
+}
@@ -0,0 +1,58 @@
+/*
+    TransportProfile.h
+
+    Socket options applied to every connection (see NetworkManager::setTransportProfile), and the result of
+    measuring the link with NetworkManager::probeTransport.
+
+    Presets, selected with "profile=<name>" in server.info:
+    - default:     operating system defaults.
+    - low-latency: TCP_NODELAY, quick ACKs and keepalive. Every request is a 23-byte header followed by its
+                   payload, which otherwise pays Nagle and delayed-ACK stalls. Used when no profile is configured.
+    - throughput:  low-latency plus 4 MB send/receive buffers for large transfers.
+    - auto:        low-latency, then probes the server after connecting and sizes the buffers from the
+                   measured bandwidth-delay product.
+    Individual options can be overridden after the preset: tcp_nodelay, quickack, keepalive (0/1),
+    keepalive_idle (seconds), send_buffer and recv_buffer (bytes).
+*/
+
+#pragma once
+#include <chrono>
+#include <optional>
+#include <ostream>
+#include <string>
+
+struct TransportProfile
+{
+    std::string          name = "low-latency";
+    bool                 noDelay = true; //< Disable Nagle's algorithm (TCP_NODELAY)
+    bool                 quickAck = true; //< Acknowledge immediately instead of delaying ACKs (TCP_QUICKACK, Linux only)
+    bool                 keepAlive = true; //< Detect dead peers on idle connections (SO_KEEPALIVE)
+    std::chrono::seconds keepAliveIdle{ 60 }; //< Idle time before the first keepalive probe, 0 for the OS default
+    int                  sendBufferSize = 0; //< SO_SNDBUF in bytes, 0 for the OS default
+    int                  receiveBufferSize = 0; //< SO_RCVBUF in bytes, 0 for the OS default
+    bool                 autoTune = false; //< Probe the server after connecting and size the buffers from the result
+    //
+    /**
+     * @brief Looks up a preset by name.
+     * @return The preset, or std::nullopt for an unknown name.
+     */
+    static std::optional<TransportProfile> preset(const std::string& name);
+    /**
+     * @brief Sets one option from its config key.
+     * @return False if the key is unknown or the value is invalid.
+     */
+    bool setOption(const std::string& key, const std::string& value);
+};
+
+/**
+ * Link measurements taken by NetworkManager::probeTransport.
+ */
+struct TransportProbeResult
+{
+    std::chrono::microseconds minRtt{ 0 }; //< Fastest round trip of an empty ping
+    std::chrono::microseconds avgRtt{ 0 }; //< Average round trip of an empty ping
+    double                    throughput = 0.0; //< Bytes per second, both directions of a large echo combined
+    int                       suggestedBufferSize = 0; //< Bandwidth-delay product, rounded up to a power of two
+    //
+    void print(std::ostream& os) const;
+};
@@ -48,6 +48,32 @@ std::string UI::getTargetUsername()
     return targetUsername;
 }
 //
+std::vector<std::string> UI::getTargetUsernames()
+{
+    std::string line;
+    std::cout << "Enter target usernames (comma separated): ";
+    std::getline(std::cin >> std::ws, line);
+    //
+    std::vector<std::string> usernames;
+    size_t start = 0;
+    while (start <= line.size())
+    {
+        size_t end = line.find(',', start);
+        if (end == std::string::npos)
+            end = line.size();
+        //
+        size_t first = line.find_first_not_of(" \t", start);
+        size_t last = line.find_last_not_of(" \t", end - 1);
+        std::string username = (first < end && last != std::string::npos && last >= first)
+            ? line.substr(first, last - first + 1) : "";
+        if (invalidUsername(username))
+            throw std::runtime_error("Invalid username format.\n");
+        usernames.push_back(std::move(username));
+        start = end + 1;
+    }
+    return usernames;
+}
+//
 std::string UI::getUsername()
 {
     std::cout << "Enter username: ";
@@ -5,6 +5,7 @@
 #pragma once
 #include <iostream>
 #include <string>
+#include <vector>
 #include "Utility.h"
 
 class UI
@@ -35,6 +36,12 @@ public:
      * @throws std::runtime_error if username is invalid.
      */
     std::string getTargetUsername();
+    /**
+     * Prompts the user to enter one or more comma-separated target usernames.
+     * @return Validated target usernames, in input order.
+     * @throws std::runtime_error if any username is invalid.
+     */
+    std::vector<std::string> getTargetUsernames();
     /**
      * Prompts the user to enter their username.
      * @return Validated username.
@@ -10,6 +10,8 @@
 
 #define MIN_PORT 1024
 #define MAX_PORT 65535
+#define MAX_CONNECTIONS 8
+#define DEFAULT_METRICS_INTERVAL_SEC 60
 //
 //
 // === Protocol === 
@@ -24,7 +26,9 @@ constexpr size_t  SERVER_HEADER_SIZE = VERSION_LENGTH + CODE_LENGTH + PAYLOAD_SI
 constexpr size_t  SERVER_PAYLOAD_SIZE_OFFSET = VERSION_LENGTH + CODE_LENGTH;
 //
 // Constants
-constexpr uint8_t PROTOCOL_VERSION = 2;
+constexpr uint8_t PROTOCOL_VERSION_LEGACY  = 2; // fixed-size names and sizes in directory and message records
+constexpr uint8_t PROTOCOL_VERSION_COMPACT = 3; // length-prefixed names and varint sizes in directory and message records
+constexpr uint8_t PROTOCOL_VERSION = PROTOCOL_VERSION_COMPACT; // servers answer with min(theirs, ours)
 //
 // Menu Options:
 constexpr uint16_t OPT_EXIT              = 0;
@@ -43,6 +47,14 @@ constexpr uint16_t CODE_REQ_USER_LIST        = 601;
 constexpr uint16_t CODE_REQ_USER_PUBLIC_KEY  = 602;
 constexpr uint16_t CODE_SEND_MESSAGE_TO_USER = 603;
 constexpr uint16_t CODE_REQ_PENDING_MESSAGES = 604;
+constexpr uint16_t CODE_PING                 = 605;
+constexpr uint16_t CODE_BATCH                = 606;
+constexpr uint16_t CODE_REQ_PUBLIC_KEYS      = 607;
+constexpr uint16_t CODE_REQ_PENDING_PAGE     = 608;
+constexpr uint16_t CODE_SYNC_USER_LIST       = 609;
+constexpr uint16_t CODE_HELLO                = 610;
+constexpr uint16_t CODE_WAIT_MESSAGES        = 611;
+constexpr uint16_t CODE_FILE_PROGRESS        = 612;
 //
 // === Response Codes === 
 constexpr uint16_t RESP_CODE_REGISTER_SUCCCESS = 2100;
@@ -50,6 +62,14 @@ constexpr uint16_t RESP_CODE_GET_CLIENT_LIST   = 2101;
 constexpr uint16_t RESP_CODE_GET_PUBLIC_KEY    = 2102;
 constexpr uint16_t RESP_CODE_SEND_MSG_SUCCESS  = 2103;
 constexpr uint16_t RESP_CODE_GET_PENDING_MSGS  = 2104;
+constexpr uint16_t RESP_CODE_PING              = 2105;
+constexpr uint16_t RESP_CODE_BATCH             = 2106;
+constexpr uint16_t RESP_CODE_GET_PUBLIC_KEYS   = 2107;
+constexpr uint16_t RESP_CODE_GET_PENDING_PAGE  = 2108;
+constexpr uint16_t RESP_CODE_SYNC_CLIENT_LIST  = 2109;
+constexpr uint16_t RESP_CODE_HELLO             = 2110;
+constexpr uint16_t RESP_CODE_WAIT_MESSAGES     = 2111;
+constexpr uint16_t RESP_CODE_FILE_PROGRESS     = 2112;
 constexpr uint16_t RESP_CODE_ERROR             = 9000;
 //
 // === Message Types ===
@@ -57,6 +77,30 @@ constexpr uint8_t MSG_TYPE_SYMM_KEY_REQ      = 1;
 constexpr uint8_t MSG_TYPE_SYMM_KEY_RESP     = 2;
 constexpr uint8_t MSG_TYPE_TEXT_MSG          = 3;
 constexpr uint8_t MSG_TYPE_SEND_FILE         = 4;
+// Message flags, carried in the high bits of the message type byte
+constexpr uint8_t MSG_FLAG_COMPRESSED        = 0x80; // content was deflated before encryption
+constexpr uint8_t MSG_FLAG_CHUNKED           = 0x40; // file chunk, content starts with a FileChunkHeader
+constexpr uint8_t MSG_FLAG_SEGMENTED         = 0x20; // file chunk encrypted with SegmentedCipher (AES-CTR) instead of CBC
+constexpr uint8_t MSG_FLAG_AEAD              = 0x10; // content encrypted with AES-GCM (nonce + ciphertext + tag) instead of CBC;
+                                                     // a file chunk is ciphertext + tag, nonce and associated data come from its header
+constexpr uint8_t MSG_TYPE_MASK              = 0x0F;
+//
+// === Capabilities (hello) ===
+constexpr uint32_t CAP_COMPRESSION_DEFLATE       = 0x01;
+constexpr uint32_t CAP_SEGMENTED_CTR             = 0x02; // server stores MSG_FLAG_SEGMENTED, file chunks may use it
+constexpr uint32_t CAP_AEAD_GCM                  = 0x04; // server stores MSG_FLAG_AEAD, messages may use it
+constexpr uint32_t CAP_CHUNKED_FILES             = 0x08; // server keeps resumable transfers, files may be sent in chunks
+constexpr uint32_t DEFAULT_COMPRESSION_THRESHOLD = 512; // smaller contents are sent as is
+constexpr size_t   MAX_DECOMPRESSED_SIZE         = 512 * 1024 * 1024; // guards against decompression bombs
+constexpr size_t   MAX_BUFFERED_MESSAGE_SIZE     = 64 * 1024 * 1024; // received content held in memory; plain files stream to disk
+//
+// === Peer capabilities (symmetric key exchange) ===
+// The same bits, meaning "this client reads the format". Sent as the content of a symmetric key request and after
+// the encrypted key in a response to a client that announced its own; older clients send and expect neither.
+// A message uses a format only if both the server connection and the recipient have the bit.
+constexpr uint32_t PEER_CAPABILITIES             = CAP_COMPRESSION_DEFLATE | CAP_SEGMENTED_CTR | CAP_AEAD_GCM | CAP_CHUNKED_FILES;
+constexpr size_t   PEER_CAPABILITIES_LEN         = 4;
+constexpr size_t   ENCRYPTED_SYMM_KEY_LEN        = 128; // RSA-1024 OAEP ciphertext of the AES key
 //
 // === Payload lengths ===
 // register message:
@@ -67,6 +111,28 @@ constexpr size_t REGISTER_PAYLOAD_LEN    = REGISTER_USERNAME_LEN + REGISTER_PUBL
 constexpr size_t MESSAGE_TYPE_LEN    = 1;
 constexpr size_t MESSAGE_CONTENT_LEN = 4;
 constexpr uint8_t MSG_ID_LEN         = 4;
+// batch request/response
+constexpr size_t BATCH_COUNT_LEN       = 2;
+constexpr size_t BATCH_ITEM_HEADER_LEN = CODE_LENGTH + PAYLOAD_SIZE_LENGTH;
+constexpr size_t MAX_BATCH_ITEMS       = 64;
+// bulk public keys
+constexpr size_t MAX_BULK_PUBLIC_KEYS  = 1024;
+// client list sync
+constexpr size_t DIRECTORY_VERSION_LEN = 4;
+// paged pending messages
+constexpr size_t   PAGE_REQUEST_LEN       = MSG_ID_LEN + 2 + 4; // cursor + max count + max bytes
+constexpr size_t   PAGE_HAS_MORE_LEN      = 1;
+constexpr uint16_t PENDING_PAGE_MAX_COUNT = 256;
+constexpr uint32_t PENDING_PAGE_MAX_BYTES = 4 * 1024 * 1024;
+// long-poll delivery
+constexpr size_t   WAIT_REQUEST_LEN       = PAGE_REQUEST_LEN + 4; // page request + wait timeout (ms)
+constexpr uint32_t DEFAULT_WAIT_TIMEOUT_MS = 30000; // the server caps it at 120 s
+// chunked file transfer
+constexpr size_t   FILE_ID_LEN            = 8;
+constexpr size_t   FILE_CHUNK_HEADER_LEN  = FILE_ID_LEN + 8 + 4 + 8; // file ID + offset + length + total size
+constexpr uint32_t FILE_CHUNK_SIZE        = 1024 * 1024; // plaintext bytes per chunk; smaller files go in one message
+constexpr size_t   FILE_CHUNK_NONCE_LEN   = FILE_ID_LEN + 4; // AES-GCM nonce of a chunk: file ID + chunk index
+constexpr size_t   FILE_PROGRESS_REQUEST_LEN = CLIENT_ID_LENGTH + FILE_ID_LEN;
 //
 constexpr uint8_t USERNAME_MAX_LENGTH = 254; // leaving place for null termination. 
 //
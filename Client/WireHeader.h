@@ -0,0 +1,153 @@
+/*
+    WireHeader.h
+
+    Compile-time description of fixed-size wire headers. A header is declared once as a list of fields
+    (member pointer + byte order), and WireLayout computes the offsets and total size at compile time and
+    generates encode/decode into fixed-size buffers. Every field is copied with shifts whose count is known
+    at compile time, so the generated code has no loops or branches and never depends on the host byte order.
+
+    Example:
+        using Codec = WireLayout<
+            WireField<&Header::id>,
+            WireField<&Header::size, ByteOrder::Little>>;
+        std::array<uint8_t, Codec::size> raw = Codec::encode(header);
+*/
+
+#pragma once
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+
+enum class ByteOrder
+{
+    Big, //< Network byte order
+    Little
+};
+
+namespace wire_detail
+{
+    template <typename T>
+    struct MemberPointer;
+    //
+    template <typename C, typename T>
+    struct MemberPointer<T C::*>
+    {
+        using Class = C;
+        using Value = T;
+    };
+    //
+    template <typename T>
+    struct IsByteArray : std::false_type { };
+    //
+    template <size_t N>
+    struct IsByteArray<std::array<uint8_t, N>> : std::true_type { };
+}
+
+/**
+ * One header field: an unsigned integer with an explicit byte order, or a raw byte array (copied as is).
+ */
+template <auto Member, ByteOrder Order = ByteOrder::Big>
+struct WireField
+{
+    using Header = typename wire_detail::MemberPointer<decltype(Member)>::Class;
+    using Value  = typename wire_detail::MemberPointer<decltype(Member)>::Value;
+    static_assert(std::is_unsigned_v<Value> || wire_detail::IsByteArray<Value>::value,
+        "Wire fields must be unsigned integers or byte arrays");
+    //
+    static constexpr size_t size = sizeof(Value);
+    //
+    static constexpr void encode(const Header& header, uint8_t* out)
+    {
+        encodeBytes(header.*Member, out, std::make_index_sequence<size>{});
+    }
+    static constexpr void decode(Header& header, const uint8_t* in)
+    {
+        header.*Member = decodeBytes(in, std::make_index_sequence<size>{});
+    }
+
+private:
+    // Wire position of the value's I-th least significant byte
+    static constexpr size_t position(size_t i) { return Order == ByteOrder::Big ? size - 1 - i : i; }
+    //
+    template <size_t... I>
+    static constexpr void encodeBytes(const Value& value, uint8_t* out, std::index_sequence<I...>)
+    {
+        if constexpr (wire_detail::IsByteArray<Value>::value)
+            ((out[I] = value[I]), ...);
+        else
+            ((out[position(I)] = static_cast<uint8_t>(value >> (8 * I))), ...);
+    }
+    template <size_t... I>
+    static constexpr Value decodeBytes(const uint8_t* in, std::index_sequence<I...>)
+    {
+        if constexpr (wire_detail::IsByteArray<Value>::value)
+            return Value{ in[I]... };
+        else
+            return static_cast<Value>(((static_cast<Value>(in[position(I)]) << (8 * I)) | ...));
+    }
+};
+
+/**
+ * A header made of consecutive fields, in wire order.
+ */
+template <typename First, typename... Rest>
+struct WireLayout
+{
+    using Header = typename First::Header;
+    static_assert((std::is_same_v<Header, typename Rest::Header> && ...), "All fields must belong to the same header");
+    //
+    static constexpr size_t fieldCount = 1 + sizeof...(Rest);
+    static constexpr size_t size = First::size + (Rest::size + ... + 0);
+    static constexpr std::array<size_t, fieldCount> offsets = []()
+    {
+        std::array<size_t, fieldCount> result{};
+        std::array<size_t, fieldCount> sizes{ First::size, Rest::size... };
+        for (size_t i = 1; i < fieldCount; i++)
+            result[i] = result[i - 1] + sizes[i - 1];
+        return result;
+    }();
+    //
+    /**
+     * @brief Offset of the I-th field from the start of the header.
+     */
+    template <size_t I>
+    static constexpr size_t offsetOf = offsets[I];
+    //
+    static constexpr void encode(const Header& header, uint8_t* out)
+    {
+        encodeFields(header, out, std::make_index_sequence<fieldCount>{});
+    }
+    static constexpr std::array<uint8_t, size> encode(const Header& header)
+    {
+        std::array<uint8_t, size> out{};
+        encode(header, out.data());
+        return out;
+    }
+    /**
+     * @brief Decodes a header from `in`, which must hold at least `size` bytes.
+     */
+    static constexpr Header decode(const uint8_t* in)
+    {
+        Header header{};
+        decodeFields(header, in, std::make_index_sequence<fieldCount>{});
+        return header;
+    }
+
+private:
+    template <size_t I>
+    using Field = std::tuple_element_t<I, std::tuple<First, Rest...>>;
+    //
+    template <size_t... I>
+    static constexpr void encodeFields(const Header& header, uint8_t* out, std::index_sequence<I...>)
+    {
+        (Field<I>::encode(header, out + offsets[I]), ...);
+    }
+    template <size_t... I>
+    static constexpr void decodeFields(Header& header, const uint8_t* in, std::index_sequence<I...>)
+    {
+        (Field<I>::decode(header, in + offsets[I]), ...);
+    }
+};
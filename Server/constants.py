@@ -14,8 +14,11 @@ DEFAULT_PORT    = 1357
 MIN_PORT_VAL    = 1024
 MAX_PORT_VAL    = 65535
 MAX_CONNECTIONS = 10
-SERVER_VERSION  = 2
+SERVER_VERSION  = 3
+LEGACY_VERSION  = 2  # Fixed-size names and sizes in directory and message records
+COMPACT_VERSION = 3  # Length-prefixed names and varint sizes in directory and message records
 CHUNK_SIZE      = 4096
+MAX_PENDING_SEND = 4 * 1024 * 1024  # Queued response bytes per client above which its further requests wait
 
 # === Request Codes ===
 CODE_REGISTER_USER    = 600
@@ -23,6 +26,14 @@ CODE_CLIENT_LIST      = 601
 CODE_PUBLIC_KEY       = 602
 CODE_SEND_MESSAGE     = 603
 CODE_PENDING_MESSAGES = 604
+CODE_PING             = 605
+CODE_BATCH            = 606
+CODE_PUBLIC_KEYS      = 607
+CODE_PENDING_PAGE     = 608
+CODE_CLIENT_LIST_SYNC = 609
+CODE_HELLO            = 610
+CODE_WAIT_MESSAGES    = 611
+CODE_FILE_PROGRESS    = 612
 
 # === Response Codes ===
 CODE_REGISTER_SUCCESS          = 2100
@@ -30,6 +41,14 @@ CODE_CLIENT_LIST_RESPONSE      = 2101
 CODE_PUBLIC_KEY_RESPONSE       = 2102
 CODE_SEND_MESSAGE_RESPONSE     = 2103
 CODE_PENDING_MESSAGES_RESPONSE = 2104
+CODE_PING_RESPONSE             = 2105
+CODE_BATCH_RESPONSE            = 2106
+CODE_PUBLIC_KEYS_RESPONSE      = 2107
+CODE_PENDING_PAGE_RESPONSE     = 2108
+CODE_CLIENT_LIST_SYNC_RESPONSE = 2109
+CODE_HELLO_RESPONSE            = 2110
+CODE_WAIT_MESSAGES_RESPONSE    = 2111
+CODE_FILE_PROGRESS_RESPONSE    = 2112
 CODE_ERROR                     = 9000
 
 # === Protocol Sizes ===
@@ -42,6 +61,52 @@ PUBLIC_KEY_SIZE    = 160
 MESSAGE_ID_SIZE    = 4
 MESSAGE_TYPE_SIZE  = 1
 MESSAGE_SIZE_FIELD = 4
+DIRECTORY_VERSION_SIZE = 4
+NAME_LENGTH_SIZE   = 1  # Compact encoding: length prefix of a username
+
+# === Batch Requests ===
+BATCH_COUNT_SIZE       = 2  # Number of items (big endian)
+BATCH_ITEM_HEADER_SIZE = 6  # Code (2) + Payload Size (4), big endian
+MAX_BATCH_ITEMS        = 64
+BATCHABLE_CODES        = (CODE_CLIENT_LIST, CODE_PUBLIC_KEY, CODE_SEND_MESSAGE, CODE_PENDING_MESSAGES, CODE_PUBLIC_KEYS,
+                          CODE_PENDING_PAGE, CODE_CLIENT_LIST_SYNC, CODE_FILE_PROGRESS)
+MAX_BULK_KEYS          = 1024  # Client IDs per bulk public key request
+SQLITE_MAX_PARAMS      = 900   # Stay under SQLite's default host parameter limit (999)
+
+# === Paged Pending Messages ===
+PAGE_REQUEST_SIZE          = 10  # Cursor (4) + Max Count (2) + Max Bytes (4), big endian
+PAGE_HAS_MORE_SIZE         = 1
+PENDING_RECORD_HEADER_SIZE = CLIENT_ID_SIZE + MESSAGE_ID_SIZE + MESSAGE_TYPE_SIZE + MESSAGE_SIZE_FIELD
+MAX_PAGE_COUNT             = 1024
+MAX_PAGE_BYTES             = 16 * 1024 * 1024
+
+# === Long-Poll Delivery ===
+WAIT_TIMEOUT_SIZE  = 4  # Longest time to hold the request, in milliseconds (big endian)
+WAIT_REQUEST_SIZE  = PAGE_REQUEST_SIZE + WAIT_TIMEOUT_SIZE
+MAX_WAIT_MS        = 120 * 1000
+
+# === Capabilities (hello) ===
+HELLO_PAYLOAD_SIZE        = 8     # Capabilities (4) + Compression Threshold (4), big endian
+CAP_COMPRESSION_DEFLATE   = 0x01  # Message content may be deflated before encryption
+CAP_SEGMENTED_CTR         = 0x02  # File chunks may be encrypted in parallel segments (MSG_FLAG_SEGMENTED)
+CAP_AEAD_GCM              = 0x04  # Message content may be encrypted with AES-GCM (MSG_FLAG_AEAD)
+CAP_CHUNKED_FILES         = 0x08  # Files may be sent as resumable chunked transfers (MSG_FLAG_CHUNKED)
+SERVER_CAPABILITIES       = CAP_COMPRESSION_DEFLATE | CAP_SEGMENTED_CTR | CAP_AEAD_GCM | CAP_CHUNKED_FILES
+MIN_COMPRESSION_THRESHOLD = 128   # Smaller contents are never worth compressing
+
+# === Message Flags ===
+# Carried in the high bits of the message type byte on the wire, stored in the Flags column
+MSG_FLAG_COMPRESSED = 0x80
+MSG_FLAG_CHUNKED    = 0x40  # File chunk: the content starts with a chunk header
+MSG_FLAG_SEGMENTED  = 0x20  # File chunk encrypted in parallel segments (AES-CTR), opaque to the server
+MSG_FLAG_AEAD       = 0x10  # Content encrypted with AES-GCM, opaque to the server
+MSG_TYPE_MASK       = 0x0F
+
+# === Chunked File Transfer ===
+# Chunk header (big endian): File ID (8) + Offset (8) + Length (4) + Total Size (8), in plaintext bytes
+FILE_ID_SIZE               = 8
+CHUNK_HEADER_SIZE          = FILE_ID_SIZE + 8 + 4 + 8
+FILE_PROGRESS_REQUEST_SIZE = CLIENT_ID_SIZE + FILE_ID_SIZE
 
 # === Packet Header Formats (struct) ===
 CLIENT_HEADER_FORMAT = "<16sBHI"
@@ -55,6 +120,7 @@ INDEX_MSG_ID         = 0
 INDEX_FROM_CLIENT    = 1
 INDEX_MSG_TYPE       = 2
 INDEX_MSG_CONTENT    = 3
+INDEX_MSG_FLAGS      = 4
 
 # === Database ===
 DB_FILE = "defensive.db"
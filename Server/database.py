@@ -10,6 +10,7 @@ used by the secure messaging server. It supports:
 - Managing public keys for clients
 - Storing and retrieving encrypted messages between clients
 - Deleting messages after successful delivery
+- Tracking the progress of chunked file transfers
 
 All database operations are wrapped in exception handling with logging for debugging and reliability.
 """
@@ -17,7 +18,7 @@ All database operations are wrapped in exception handling with logging for debug
 import sqlite3
 import os
 import logging
-from constants import DB_FILE
+from constants import DB_FILE, SQLITE_MAX_PARAMS, PENDING_RECORD_HEADER_SIZE
 
 
 class Database:
@@ -27,15 +28,32 @@ class Database:
     - Public key retrieval
     - Storing, retrieving, and deleting messages
     """
+    _schema_checked = False  # Older database files are migrated once per process
+    _FILE_TRANSFERS_SCHEMA = """
+        CREATE TABLE IF NOT EXISTS file_transfers
+        (
+            FromClient TEXT NOT NULL CHECK(LENGTH(FromClient) == 16),
+            ToClient TEXT NOT NULL CHECK(LENGTH(ToClient) == 16),
+            FileID BLOB NOT NULL CHECK(LENGTH(FileID) == 8),
+            Received INTEGER NOT NULL,
+            Total INTEGER NOT NULL,
+            PRIMARY KEY (FromClient, ToClient, FileID)
+        )
+    """
+
     def __init__(self):
         """Initialize database file and tables if needed."""
         db_exists = os.path.exists(DB_FILE)
         if not db_exists:
             logging.info(f"{DB_FILE} file not found. Creating new database.")
             self.create_tables()
+            Database._schema_checked = True
+        elif not Database._schema_checked:
+            self.migrate_tables()
+            Database._schema_checked = True
 
     def create_tables(self):
-        """Create required tables for users and messages."""
+        """Create required tables for users, messages and file transfers."""
         try:
             with sqlite3.connect(DB_FILE) as conn:
                 cursor = conn.cursor()
@@ -45,9 +63,11 @@ class Database:
                         ID TEXT UNIQUE PRIMARY KEY CHECK(LENGTH(ID) == 16), 
                         UserName TEXT UNIQUE NOT NULL CHECK(LENGTH(UserName) <= 255),
                         PublicKey BLOB UNIQUE NOT NULL CHECK(LENGTH(PublicKey) == 160), 
-                        LastSeen DATETIME NOT NULL DEFAULT CURRENT_TIMESTAMP 
+                        LastSeen DATETIME NOT NULL DEFAULT CURRENT_TIMESTAMP,
+                        Version INTEGER NOT NULL DEFAULT 0
                     )
                 """)
+                cursor.execute("CREATE INDEX IF NOT EXISTS clients_version ON clients (Version)")
                 cursor.execute("""
                     CREATE TABLE IF NOT EXISTS messages
                     (
@@ -55,13 +75,40 @@ class Database:
                         ToClient TEXT NOT NULL CHECK(LENGTH(ToClient) == 16),
                         FromClient TEXT TEXT NOT NULL CHECK(LENGTH(FromClient) == 16),
                         Type INTEGER NOT NULL CHECK(Type BETWEEN 1 AND 4),
-                        Content BLOB NOT NULL
+                        Content BLOB NOT NULL,
+                        Flags INTEGER NOT NULL DEFAULT 0
                     )
                 """)
+                cursor.execute(Database._FILE_TRANSFERS_SCHEMA)
                 conn.commit()
         except sqlite3.Error as e:
             logging.error(f"Database error while creating tables: {e}")
 
+    @staticmethod
+    def migrate_tables():
+        """
+        Bring a database file created by an older server up to the current schema.
+        Adds the client directory version, numbering existing clients in registration order,
+        the message flags and the file transfer progress table.
+        """
+        try:
+            with sqlite3.connect(DB_FILE) as conn:
+                cursor = conn.cursor()
+                columns = [row[1] for row in cursor.execute("PRAGMA table_info(clients)")]
+                if "Version" not in columns:
+                    logging.info("Adding Version column to clients table.")
+                    cursor.execute("ALTER TABLE clients ADD COLUMN Version INTEGER NOT NULL DEFAULT 0")
+                    cursor.execute("UPDATE clients SET Version = rowid")
+                cursor.execute("CREATE INDEX IF NOT EXISTS clients_version ON clients (Version)")
+                columns = [row[1] for row in cursor.execute("PRAGMA table_info(messages)")]
+                if "Flags" not in columns:
+                    logging.info("Adding Flags column to messages table.")
+                    cursor.execute("ALTER TABLE messages ADD COLUMN Flags INTEGER NOT NULL DEFAULT 0")
+                cursor.execute(Database._FILE_TRANSFERS_SCHEMA)
+                conn.commit()
+        except sqlite3.Error as e:
+            logging.error(f"Database error while migrating tables: {e}")
+
     def user_exists(self, username: str) -> bool:
         """
         Check if a username exists in the database.
@@ -86,7 +133,8 @@ class Database:
             with sqlite3.connect(DB_FILE) as conn:
                 cursor = conn.cursor()
                 cursor.execute(
-                    "INSERT INTO clients (ID, UserName, PublicKey) VALUES (?,?,?)",
+                    "INSERT INTO clients (ID, UserName, PublicKey, Version) "
+                    "VALUES (?,?,?,(SELECT COALESCE(MAX(Version), 0) + 1 FROM clients))",
                     (client_id, username, public_key)
                 )
                 conn.commit()
@@ -114,6 +162,24 @@ class Database:
             logging.error(f"Database error in get_clients(): {e}")
             return []
 
+    @staticmethod
+    def get_clients_since(exclude_id: bytes, since_version: int) -> tuple[list[tuple], int]:
+        """
+        Get the users added after a directory version, excluding the one with the specified ID.
+        Returns (list of (client_id, username) tuples, current directory version).
+        """
+        try:
+            with sqlite3.connect(DB_FILE) as conn:
+                cursor = conn.cursor()
+                cursor.execute("SELECT COALESCE(MAX(Version), 0) FROM clients")
+                version = cursor.fetchone()[0]
+                cursor.execute("SELECT ID, UserName FROM clients WHERE Version > ? AND Version <= ? AND ID != ?",
+                               (since_version, version, exclude_id))
+                return cursor.fetchall(), version
+        except sqlite3.Error as e:
+            logging.error(f"Database error in get_clients_since(): {e}")
+            return [], since_version
+
     @staticmethod
     def get_public_key(client_id: str) -> bytes | None:
         """
@@ -130,7 +196,27 @@ class Database:
             return None
 
     @staticmethod
-    def save_message(to_client: str, from_client: str, msg_type: int, content: bytes) -> int | None:
+    def get_public_keys(client_ids: list[bytes]) -> list[tuple]:
+        """
+        Get the public keys of several clients with one connection.
+        Returns a list of (client_id, public_key) tuples for the IDs that exist, in no particular order.
+        """
+        try:
+            with sqlite3.connect(DB_FILE) as conn:
+                cursor = conn.cursor()
+                result = []
+                for start in range(0, len(client_ids), SQLITE_MAX_PARAMS):
+                    chunk = client_ids[start:start + SQLITE_MAX_PARAMS]
+                    placeholders = ",".join("?" * len(chunk))
+                    cursor.execute(f"SELECT ID, PublicKey FROM clients WHERE ID IN ({placeholders})", chunk)
+                    result.extend(cursor.fetchall())
+                return result
+        except sqlite3.Error as e:
+            logging.error(f"Database error in get_public_keys(): {e}")
+            return []
+
+    @staticmethod
+    def save_message(to_client: str, from_client: str, msg_type: int, content: bytes, flags: int = 0) -> int | None:
         """
         Save an outgoing message in the database.
         Returns the inserted message ID, or None on error.
@@ -139,8 +225,8 @@ class Database:
             with sqlite3.connect(DB_FILE) as conn:
                 cursor = conn.cursor()
                 cursor.execute(
-                    "INSERT INTO messages (ToClient, FromClient, Type, Content) VALUES (?,?,?,?)",
-                    (to_client, from_client, msg_type,  content)
+                    "INSERT INTO messages (ToClient, FromClient, Type, Content, Flags) VALUES (?,?,?,?,?)",
+                    (to_client, from_client, msg_type,  content, flags)
                 )
                 conn.commit()
                 return cursor.lastrowid  # Return the message ID
@@ -148,17 +234,85 @@ class Database:
             logging.error(f"Database error in save_message(): {e}")
             return None
 
+    @staticmethod
+    def save_chunk(to_client: bytes, from_client: bytes, msg_type: int, content: bytes, flags: int,
+                   file_id: bytes, offset: int, length: int, total: int) -> int | None:
+        """
+        Save one chunk of a file transfer as a message and advance the transfer's progress, in one transaction.
+        Chunks must arrive in order: a chunk the transfer already holds (a retry whose acknowledgement was lost)
+        is accepted without being stored again, a chunk past the received offset is rejected.
+        The transfer's progress row is deleted once the final chunk is stored, so completed transfers do not pile up.
+        Returns the inserted message ID, 0 for a chunk already held, or None if the chunk is rejected or on error.
+        """
+        try:
+            with sqlite3.connect(DB_FILE) as conn:
+                cursor = conn.cursor()
+                cursor.execute(
+                    "SELECT Received, Total FROM file_transfers WHERE FromClient = ? AND ToClient = ? AND FileID = ?",
+                    (from_client, to_client, file_id)
+                )
+                row = cursor.fetchone()
+                received = row[0] if row else 0
+                if row and row[1] != total:
+                    logging.error(f"File transfer size changed from {row[1]} to {total}")
+                    return None
+                if row and offset + length <= received:
+                    return 0
+                if offset != received or offset + length > total:
+                    logging.error(f"Out of order file chunk at offset {offset}, expected {received}")
+                    return None
+
+                cursor.execute(
+                    "INSERT INTO messages (ToClient, FromClient, Type, Content, Flags) VALUES (?,?,?,?,?)",
+                    (to_client, from_client, msg_type, content, flags)
+                )
+                message_id = cursor.lastrowid
+                if offset + length == total:
+                    cursor.execute(
+                        "DELETE FROM file_transfers WHERE FromClient = ? AND ToClient = ? AND FileID = ?",
+                        (from_client, to_client, file_id)
+                    )
+                else:
+                    cursor.execute(
+                        "INSERT OR REPLACE INTO file_transfers (FromClient, ToClient, FileID, Received, Total) VALUES (?,?,?,?,?)",
+                        (from_client, to_client, file_id, offset + length, total)
+                    )
+                conn.commit()
+                return message_id
+        except sqlite3.Error as e:
+            logging.error(f"Database error in save_chunk(): {e}")
+            return None
+
+    @staticmethod
+    def get_transfer_progress(from_client: bytes, to_client: bytes, file_id: bytes) -> tuple[int, int] | None:
+        """
+        Get how far a file transfer got.
+        Returns (received bytes, total bytes), (0, 0) for an unknown transfer, or None on error.
+        """
+        try:
+            with sqlite3.connect(DB_FILE) as conn:
+                cursor = conn.cursor()
+                cursor.execute(
+                    "SELECT Received, Total FROM file_transfers WHERE FromClient = ? AND ToClient = ? AND FileID = ?",
+                    (from_client, to_client, file_id)
+                )
+                row = cursor.fetchone()
+                return (row[0], row[1]) if row else (0, 0)
+        except sqlite3.Error as e:
+            logging.error(f"Database error in get_transfer_progress(): {e}")
+            return None
+
     @staticmethod
     def get_pending_messages(client_id: str) -> list[tuple]:
         """
         Get all pending messages for a given client ID.
-        Returns a list of (msg_id, from_client, type, content) tuples.
+        Returns a list of (msg_id, from_client, type, content, flags) tuples.
         """
         try:
             with sqlite3.connect(DB_FILE) as conn:
                 cursor = conn.cursor()
                 cursor.execute(
-                    "SELECT ID, FromClient, Type, Content FROM messages WHERE ToClient = ?",
+                    "SELECT ID, FromClient, Type, Content, Flags FROM messages WHERE ToClient = ?",
                     (client_id,)
                 )
                 return cursor.fetchall()
@@ -166,6 +320,51 @@ class Database:
             logging.error(f"Database error in get_pending_messages(): {e}")
             return []
 
+    @staticmethod
+    def get_pending_page(client_id: bytes, after_id: int, max_count: int, max_bytes: int) -> tuple[list[tuple], bool]:
+        """
+        Get the next page of pending messages for a given client ID, oldest first, starting after `after_id`.
+        The page holds at most `max_count` messages and stops once their records exceed `max_bytes`
+        (a single oversized message is still returned, so the reader always makes progress).
+        Returns (list of (msg_id, from_client, type, content, flags) tuples, whether more messages follow).
+        """
+        try:
+            with sqlite3.connect(DB_FILE) as conn:
+                cursor = conn.cursor()
+                cursor.execute(
+                    "SELECT ID, FromClient, Type, Content, Flags FROM messages WHERE ToClient = ? AND ID > ? ORDER BY ID LIMIT ?",
+                    (client_id, after_id, max_count)
+                )
+                messages = []
+                page_bytes = 0
+                for row in cursor:  # rows are read one at a time, not fetched all at once
+                    record_bytes = PENDING_RECORD_HEADER_SIZE + len(row[3])
+                    if messages and page_bytes + record_bytes > max_bytes:
+                        break
+                    messages.append(row)
+                    page_bytes += record_bytes
+
+                last_id = messages[-1][0] if messages else after_id
+                cursor.execute("SELECT EXISTS(SELECT 1 FROM messages WHERE ToClient = ? AND ID > ?)",
+                               (client_id, last_id))
+                return messages, bool(cursor.fetchone()[0])
+        except sqlite3.Error as e:
+            logging.error(f"Database error in get_pending_page(): {e}")
+            return [], False
+
+    @staticmethod
+    def acknowledge_messages(client_id: bytes, up_to_id: int) -> None:
+        """
+        Delete every pending message of a given client ID up to and including `up_to_id`.
+        """
+        try:
+            with sqlite3.connect(DB_FILE) as conn:
+                cursor = conn.cursor()
+                cursor.execute("DELETE FROM messages WHERE ToClient = ? AND ID <= ?", (client_id, up_to_id))
+                conn.commit()
+        except sqlite3.Error as e:
+            logging.error(f"Database error in acknowledge_messages(): {e}")
+
     @staticmethod
     def delete_messages(msg_ids: list[int]) -> None:
         """
@@ -18,36 +18,110 @@ class RequestHandler:
     Main request dispatcher. Maps incoming request codes to handler methods.
     """
     def __init__(self):
+        self.new_mail: set[bytes] = set()  # recipients of messages saved since the last take_new_mail
         self.handlers: dict[int, Callable[[RequestPacket, Database], Optional[ResponsePacket]]] = {
             CODE_REGISTER_USER: self.handle_register_req,
             CODE_CLIENT_LIST: self.handle_client_list_req,
             CODE_PUBLIC_KEY: self.handle_public_key_req,
             CODE_SEND_MESSAGE: self.handle_send_msg_req,
             CODE_PENDING_MESSAGES: self.handle_pending_msgs_req,
+            CODE_PING: self.handle_ping_req,
+            CODE_BATCH: self.handle_batch_req,
+            CODE_PUBLIC_KEYS: self.handle_public_keys_req,
+            CODE_PENDING_PAGE: self.handle_pending_page_req,
+            CODE_CLIENT_LIST_SYNC: self.handle_client_list_sync_req,
+            CODE_HELLO: self.handle_hello_req,
+            CODE_WAIT_MESSAGES: self.handle_wait_messages_req,
+            CODE_FILE_PROGRESS: self.handle_file_progress_req,
         }
 
     def handle_request(self, packet: RequestPacket, db: Database) -> tuple:
         """
         Determines and calls the appropriate handler.
         Returns a tuple: (ResponsePacket, list of message IDs to delete if needed)
+        The response is None for a long-poll request with nothing to deliver yet, which the caller holds open.
         """
         handler = self.handlers.get(packet.code, self.handle_invalid_requests)
         try:
             response = handler(packet, db)
+            if response is None and packet.code == CODE_WAIT_MESSAGES:
+                return None, []
 
-            if packet.code == CODE_PENDING_MESSAGES:
+            if packet.code in (CODE_PENDING_MESSAGES, CODE_BATCH):
                 if not isinstance(response, tuple) or len(response) != 2:
-                    raise ValueError("Pending messages handler must return a tuple (ResponsePacket, list)")
-                return response   # Tuple of (ResponsePacket, messages_ids)
+                    raise ValueError("Pending messages and batch handlers must return a tuple (ResponsePacket, list)")
+                response, message_ids = response
+            else:
+                message_ids = []
 
             if not isinstance(response, ResponsePacket):
                 raise ValueError("Handler must return ResponsePacket")
 
-            return response, []
-
         except Exception as e:
             logging.error(f"Error in  handle_request: {e}")
-            return ResponsePacket(CODE_ERROR, b""), []
+            response, message_ids = ResponsePacket(CODE_ERROR, b""), []
+
+        # Answer in the version the payload was encoded for, so older clients keep working
+        response.version = self.negotiate_version(packet)
+        return response, message_ids
+
+    @staticmethod
+    def negotiate_version(packet: RequestPacket) -> int:
+        """
+        Returns the protocol version to answer a request with: the client's version, capped at the server's.
+        """
+        return min(packet.version, SERVER_VERSION)
+
+    @staticmethod
+    def encode_varint(value: int) -> bytes:
+        """
+        Encodes a non-negative integer as an unsigned LEB128 varint: 7 bits per byte, low bits first,
+        high bit set on every byte but the last.
+        """
+        out = bytearray()
+        while value >= 0x80:
+            out.append((value & 0x7F) | 0x80)
+            value >>= 7
+        out.append(value)
+        return bytes(out)
+
+    @staticmethod
+    def encode_client_records(client_list: list[tuple], version: int) -> bytes:
+        """
+        Encodes (client_id, username) tuples as client list records.
+        Legacy: 16-byte ID + 255-byte zero-padded name. Compact: 16-byte ID + 1-byte name length + name.
+        """
+        if version >= COMPACT_VERSION:
+            records = []
+            for cid, name in client_list:
+                encoded = name.encode()
+                records.append(cid + len(encoded).to_bytes(NAME_LENGTH_SIZE, "big") + encoded)
+            return b"".join(records)
+        return b"".join([
+            cid + name.encode().ljust(USERNAME_SIZE, b'\x00')
+            for cid, name in client_list
+        ])
+
+    @staticmethod
+    def encode_pending_records(messages: list[tuple], version: int) -> bytes:
+        """
+        Encodes (msg_id, from_client, type, content, flags) tuples as pending message records:
+        from_client + 4-byte message ID + 1-byte type and flags + content size + content.
+        Legacy: 4-byte content size. Compact: varint (LEB128) content size.
+        """
+        if version >= COMPACT_VERSION:
+            encode_size = RequestHandler.encode_varint
+        else:
+            def encode_size(size: int) -> bytes:
+                return size.to_bytes(MESSAGE_SIZE_FIELD, "big")
+        return b"".join([
+            msg[INDEX_FROM_CLIENT] +  # from_client
+            msg[INDEX_MSG_ID].to_bytes(MESSAGE_ID_SIZE, "big") +  # message_id
+            (msg[INDEX_MSG_TYPE] | msg[INDEX_MSG_FLAGS]).to_bytes(MESSAGE_TYPE_SIZE, "big") +  # message_type and flags
+            encode_size(len(msg[INDEX_MSG_CONTENT])) +  # content size
+            msg[INDEX_MSG_CONTENT]  # message content
+            for msg in messages
+        ])
 
     @staticmethod
     def handle_register_req(packet: RequestPacket, db: Database):
@@ -83,12 +157,26 @@ class RequestHandler:
         if not client_list:
             return ResponsePacket(CODE_CLIENT_LIST_RESPONSE, b"")
 
-        payload = b"".join([
-            cid + name.encode().ljust(USERNAME_SIZE, b'\x00')
-            for cid, name in client_list
-        ])
+        payload = RequestHandler.encode_client_records(client_list, RequestHandler.negotiate_version(packet))
         return ResponsePacket(CODE_CLIENT_LIST_RESPONSE, payload)
 
+    @staticmethod
+    def handle_client_list_sync_req(packet: RequestPacket, db: Database):
+        """
+        Handles request for the clients registered since a directory version (excluding self).
+        Payload: last seen directory version (4 bytes, 0 for the full list)
+        Returns: current directory version (4 bytes) + client records in the client list layout.
+        """
+        if len(packet.payload) != DIRECTORY_VERSION_SIZE:
+            logging.error(f"Invalid client list sync request size: {len(packet.payload)}")
+            return ResponsePacket(CODE_ERROR)
+        since_version = int.from_bytes(packet.payload, "big")
+        client_list, version = db.get_clients_since(packet.client_id, since_version)
+
+        payload = (version.to_bytes(DIRECTORY_VERSION_SIZE, "big") +
+                   RequestHandler.encode_client_records(client_list, RequestHandler.negotiate_version(packet)))
+        return ResponsePacket(CODE_CLIENT_LIST_SYNC_RESPONSE, payload)
+
     @staticmethod
     def handle_public_key_req(packet: RequestPacket, db: Database):
         """
@@ -102,19 +190,50 @@ class RequestHandler:
         return ResponsePacket(CODE_ERROR)
 
     @staticmethod
-    def handle_send_msg_req(packet: RequestPacket, db: Database):
+    def handle_public_keys_req(packet: RequestPacket, db: Database):
+        """
+        Returns the public keys of several clients in one response.
+        Payload: N * 16-byte target client IDs
+        Returns: (16-byte client ID + 160-byte public key) for every requested client that exists.
+        """
+        payload = packet.payload
+        if len(payload) % CLIENT_ID_SIZE != 0 or len(payload) // CLIENT_ID_SIZE > MAX_BULK_KEYS:
+            logging.error(f"Invalid bulk public key request size: {len(payload)}")
+            return ResponsePacket(CODE_ERROR)
+
+        target_ids = list(dict.fromkeys(payload[i:i + CLIENT_ID_SIZE] for i in range(0, len(payload), CLIENT_ID_SIZE)))
+        keys = db.get_public_keys(target_ids)
+        return ResponsePacket(CODE_PUBLIC_KEYS_RESPONSE, b"".join(cid + key for cid, key in keys))
+
+    def handle_send_msg_req(self, packet: RequestPacket, db: Database):
         """
-        Saves an incoming message in the database.
-        Payload: target client ID + message type + 4-byte size + message content
+        Saves an incoming message in the database and notes the recipient, so a waiting long-poll can be answered.
+        Payload: target client ID + message type and flags + 4-byte size + message content
+        File chunks (MSG_FLAG_CHUNKED) start their content with a chunk header and must arrive in order;
+        a chunk that was already stored is acknowledged with message ID 0.
         """
         target_id = packet.payload[:CLIENT_ID_SIZE]
-        message_type = packet.payload[CLIENT_ID_SIZE]
+        message_type = packet.payload[CLIENT_ID_SIZE] & MSG_TYPE_MASK
+        message_flags = packet.payload[CLIENT_ID_SIZE] & ~MSG_TYPE_MASK
         content_size = int.from_bytes(packet.payload[CLIENT_ID_SIZE + MESSAGE_TYPE_SIZE:
                                                      CLIENT_ID_SIZE + MESSAGE_TYPE_SIZE + MESSAGE_SIZE_FIELD], 'big')
         message_content = packet.payload[CLIENT_ID_SIZE + MESSAGE_TYPE_SIZE + MESSAGE_SIZE_FIELD:]
-        message_id = db.save_message(target_id, packet.client_id, message_type, message_content)
+        if message_flags & MSG_FLAG_CHUNKED:
+            if len(message_content) < CHUNK_HEADER_SIZE:
+                logging.error(f"File chunk too short for its header: {len(message_content)}")
+                return ResponsePacket(CODE_ERROR)
+            file_id = message_content[:FILE_ID_SIZE]
+            offset = int.from_bytes(message_content[FILE_ID_SIZE:FILE_ID_SIZE + 8], "big")
+            length = int.from_bytes(message_content[FILE_ID_SIZE + 8:FILE_ID_SIZE + 12], "big")
+            total = int.from_bytes(message_content[FILE_ID_SIZE + 12:CHUNK_HEADER_SIZE], "big")
+            message_id = db.save_chunk(target_id, packet.client_id, message_type, message_content, message_flags,
+                                       file_id, offset, length, total)
+        else:
+            message_id = db.save_message(target_id, packet.client_id, message_type, message_content, message_flags)
         if message_id is None:
             return ResponsePacket(CODE_ERROR)
+        if message_id:
+            self.new_mail.add(bytes(target_id))
         return ResponsePacket(CODE_SEND_MESSAGE_RESPONSE, target_id + message_id.to_bytes(4, "big"))
 
     @staticmethod
@@ -128,17 +247,157 @@ class RequestHandler:
         if not messages:
             return ResponsePacket(CODE_PENDING_MESSAGES_RESPONSE, b""), []
 
-        payload = b"".join([
-            msg[INDEX_FROM_CLIENT] +  # from_client
-            msg[INDEX_MSG_ID].to_bytes(4, "big") +  # message_id
-            msg[INDEX_MSG_TYPE].to_bytes(1, "big") +  # message_type
-            len(msg[INDEX_MSG_CONTENT]).to_bytes(4, "big") +  # content size
-            msg[INDEX_MSG_CONTENT]  # message content
-            for msg in messages
-        ])
+        payload = RequestHandler.encode_pending_records(messages, RequestHandler.negotiate_version(packet))
         db.delete_messages([msg[0] for msg in messages])
         return ResponsePacket(CODE_PENDING_MESSAGES_RESPONSE, payload), [msg[0] for msg in messages]
 
+    @staticmethod
+    def handle_pending_page_req(packet: RequestPacket, db: Database):
+        """
+        Acknowledges the messages the client has processed and returns the next page of pending messages.
+        Payload: cursor (4 bytes, ID of the last processed message, 0 for none) + max count (2 bytes)
+                 + max bytes (4 bytes). A max count of 0 only acknowledges.
+        Returns: has more (1 byte) + pending messages in the same layout as the full pending messages response.
+        Messages are deleted only once acknowledged by a later request, so a dropped connection redelivers
+        at most the page in flight.
+        """
+        if len(packet.payload) != PAGE_REQUEST_SIZE:
+            logging.error(f"Invalid pending page request size: {len(packet.payload)}")
+            return ResponsePacket(CODE_ERROR)
+        cursor = int.from_bytes(packet.payload[:MESSAGE_ID_SIZE], "big")
+        max_count = min(int.from_bytes(packet.payload[MESSAGE_ID_SIZE:MESSAGE_ID_SIZE + 2], "big"), MAX_PAGE_COUNT)
+        max_bytes = min(int.from_bytes(packet.payload[MESSAGE_ID_SIZE + 2:PAGE_REQUEST_SIZE], "big"), MAX_PAGE_BYTES)
+
+        if cursor:
+            db.acknowledge_messages(packet.client_id, cursor)
+        messages, has_more = db.get_pending_page(packet.client_id, cursor, max_count, max_bytes)
+
+        payload = bytes([has_more]) + RequestHandler.encode_pending_records(messages, RequestHandler.negotiate_version(packet))
+        return ResponsePacket(CODE_PENDING_PAGE_RESPONSE, payload)
+
+    @staticmethod
+    def handle_file_progress_req(packet: RequestPacket, db: Database):
+        """
+        Returns how far a chunked file transfer from the requesting client got, so it can resume after a reconnect.
+        Payload: target client ID (16 bytes) + file ID (8 bytes)
+        Returns: received bytes (8 bytes) + total bytes (8 bytes), both 0 for an unknown transfer.
+        """
+        if len(packet.payload) != FILE_PROGRESS_REQUEST_SIZE:
+            logging.error(f"Invalid file progress request size: {len(packet.payload)}")
+            return ResponsePacket(CODE_ERROR)
+        progress = db.get_transfer_progress(packet.client_id, packet.payload[:CLIENT_ID_SIZE],
+                                            packet.payload[CLIENT_ID_SIZE:])
+        if progress is None:
+            return ResponsePacket(CODE_ERROR)
+        received, total = progress
+        return ResponsePacket(CODE_FILE_PROGRESS_RESPONSE, received.to_bytes(8, "big") + total.to_bytes(8, "big"))
+
+    @staticmethod
+    def handle_wait_messages_req(packet: RequestPacket, db: Database):
+        """
+        Long-poll variant of the pending page request.
+        Payload: the pending page request (10 bytes) + longest time to wait in milliseconds (4 bytes)
+        Returns: a response in the pending page layout as soon as there is something to deliver,
+                 or None to have the server hold the request (see Server.park_wait).
+        """
+        if len(packet.payload) != WAIT_REQUEST_SIZE:
+            logging.error(f"Invalid wait messages request size: {len(packet.payload)}")
+            return ResponsePacket(CODE_ERROR)
+        page_request = RequestPacket.from_fields(packet.client_id, packet.version, CODE_PENDING_PAGE,
+                                                 packet.payload[:PAGE_REQUEST_SIZE])
+        page = RequestHandler.handle_pending_page_req(page_request, db)
+        if page.code != CODE_PENDING_PAGE_RESPONSE:
+            return page
+        max_count = int.from_bytes(packet.payload[MESSAGE_ID_SIZE:MESSAGE_ID_SIZE + 2], "big")
+        if page.payload_size == PAGE_HAS_MORE_SIZE and max_count:
+            return None  # Nothing pending yet
+        return ResponsePacket(CODE_WAIT_MESSAGES_RESPONSE, page.payload)
+
+    @staticmethod
+    def wait_timeout_ms(packet: RequestPacket) -> int:
+        """
+        Returns how long a long-poll request may be held, capped at MAX_WAIT_MS.
+        """
+        return min(int.from_bytes(packet.payload[PAGE_REQUEST_SIZE:WAIT_REQUEST_SIZE], "big"), MAX_WAIT_MS)
+
+    @staticmethod
+    def wait_expired(packet: RequestPacket) -> ResponsePacket:
+        """
+        Answers a long-poll request whose wait ran out with an empty page.
+        """
+        response = ResponsePacket(CODE_WAIT_MESSAGES_RESPONSE, bytes([False]))
+        response.version = RequestHandler.negotiate_version(packet)
+        return response
+
+    def take_new_mail(self) -> set[bytes]:
+        """
+        Returns the recipients of the messages saved since the last call, and forgets them.
+        """
+        recipients, self.new_mail = self.new_mail, set()
+        return recipients
+
+    @staticmethod
+    def handle_hello_req(packet: RequestPacket, db: Database):
+        """
+        Negotiates optional features for the connection.
+        Payload: client capabilities (4 bytes) + smallest content size worth compressing (4 bytes)
+        Returns: the capabilities both sides support (4 bytes) + the compression threshold to use (4 bytes).
+        """
+        if len(packet.payload) != HELLO_PAYLOAD_SIZE:
+            logging.error(f"Invalid hello request size: {len(packet.payload)}")
+            return ResponsePacket(CODE_ERROR)
+        capabilities = int.from_bytes(packet.payload[:4], "big") & SERVER_CAPABILITIES
+        threshold = max(int.from_bytes(packet.payload[4:], "big"), MIN_COMPRESSION_THRESHOLD)
+        return ResponsePacket(CODE_HELLO_RESPONSE, capabilities.to_bytes(4, "big") + threshold.to_bytes(4, "big"))
+
+    @staticmethod
+    def handle_ping_req(packet: RequestPacket, db: Database):
+        """
+        Echoes the payload back, so clients can measure round-trip time and throughput.
+        """
+        return ResponsePacket(CODE_PING_RESPONSE, packet.payload)
+
+    def handle_batch_req(self, packet: RequestPacket, db: Database):
+        """
+        Runs several requests in one round trip, in order.
+        Payload: item count (2 bytes) + per item: code (2 bytes) + payload size (4 bytes) + payload
+        Returns: (ResponsePacket, [message_ids]) with the same layout, one response item per request item.
+        A failing item gets an error item; a malformed batch fails as a whole.
+        Delivered messages are deleted once the whole batch response is sent.
+        """
+        payload = packet.payload
+        count = int.from_bytes(payload[:BATCH_COUNT_SIZE], "big")
+        if len(payload) < BATCH_COUNT_SIZE or count > MAX_BATCH_ITEMS:
+            raise ValueError(f"Invalid batch item count: {count}")
+
+        offset = BATCH_COUNT_SIZE
+        items = []
+        message_ids = []
+        for _ in range(count):
+            if offset + BATCH_ITEM_HEADER_SIZE > len(payload):
+                raise ValueError("Truncated batch item header")
+            code = int.from_bytes(payload[offset:offset + CODE_SIZE], "big")
+            size = int.from_bytes(payload[offset + CODE_SIZE:offset + BATCH_ITEM_HEADER_SIZE], "big")
+            offset += BATCH_ITEM_HEADER_SIZE
+            if offset + size > len(payload):
+                raise ValueError("Truncated batch item payload")
+            item = RequestPacket.from_fields(packet.client_id, packet.version, code, payload[offset:offset + size])
+            offset += size
+
+            if code in BATCHABLE_CODES:
+                response, ids = self.handle_request(item, db)
+                message_ids.extend(ids)
+            else:
+                logging.warning(f"Request code {code} is not allowed in a batch")
+                response = ResponsePacket(CODE_ERROR)
+            items.append(response.code.to_bytes(CODE_SIZE, "big") +
+                         response.payload_size.to_bytes(PAYLOAD_SIZE, "big") +
+                         response.payload)
+
+        if offset != len(payload):
+            raise ValueError("Trailing bytes after the last batch item")
+        return ResponsePacket(CODE_BATCH_RESPONSE, count.to_bytes(BATCH_COUNT_SIZE, "big") + b"".join(items)), message_ids
+
     @staticmethod
     def handle_invalid_requests(packet: RequestPacket, db: Database):
         """
@@ -34,6 +34,19 @@ class RequestPacket:
                                                                    raw_data[CLIENT_ID_SIZE:CLIENT_HEADER_SIZE])
         self.payload = raw_data[CLIENT_HEADER_SIZE:]  # Remaining bytes
 
+    @classmethod
+    def from_fields(cls, client_id: bytes, version: int, code: int, payload: bytes) -> "RequestPacket":
+        """
+        Builds a RequestPacket from already parsed fields (batch items, the page part of a long-poll request).
+        """
+        packet = cls.__new__(cls)
+        packet.client_id = client_id
+        packet.version = version
+        packet.code = code
+        packet.payload_size = len(payload)
+        packet.payload = payload
+        return packet
+
     def get_payload(self) -> bytes:
         """Returns the payload section of the packet."""
         return self.payload
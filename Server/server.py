@@ -7,6 +7,7 @@ Handles incoming client connections, parses requests, delegates handling, and se
 import socket
 import logging
 import selectors
+import time
 
 from constants import *
 from database import Database
@@ -23,6 +24,10 @@ class Server:
         self.port = port
         self.selector = selectors.DefaultSelector()
         self.handler = RequestHandler()
+        self.recv_buffers: dict[socket.socket, bytearray] = {}  # partial data received per client socket
+        self.send_buffers: dict[socket.socket, bytearray] = {}  # response bytes the socket did not take yet
+        # Long-poll requests held open, per client socket: (request, monotonic deadline)
+        self.waiting: dict[socket.socket, tuple[RequestPacket, float]] = {}
 
     def start(self):
         """
@@ -38,17 +43,18 @@ class Server:
 
             try:
                 while True:
-                    events = self.selector.select(timeout=None)  # wait for events
-                    for key, _ in events:
+                    events = self.selector.select(timeout=self.next_wait_timeout())  # wait for events
+                    for key, mask in events:
                         callback = key.data
-                        callback(key.fileobj)
+                        callback(key.fileobj, mask)
+                    self.expire_waits()
             except Exception as e:
                 logging.error(f"Server error: {e}")
             finally:
                 logging.info("Shutting down server...")
                 self.cleanup()
 
-    def accept_client(self, server_socket):
+    def accept_client(self, server_socket, mask):
         """
         Accepts a new client connection and registers it for read events.
         """
@@ -56,100 +62,209 @@ class Server:
             client_socket, addr = server_socket.accept()
             logging.info(f"New connection from {addr}")
             client_socket.setblocking(False)
+            # Responses are written whole, so Nagle only delays them
+            client_socket.setsockopt(socket.IPPROTO_TCP, socket.TCP_NODELAY, 1)
+            self.recv_buffers[client_socket] = bytearray()
+            self.send_buffers[client_socket] = bytearray()
             self.selector.register(client_socket, selectors.EVENT_READ, self.handle_client)
         except Exception as e:
             logging.error(f"Error accepting client: {e}")
 
-    def handle_client(self, client_socket):
+    def handle_client(self, client_socket, mask):
         """
         Handles communication with a connected client.
+        Flushes pending response bytes when the socket is writable, then reads whatever data is available
+        and processes every complete request in the buffer, so clients may pipeline several requests
+        without waiting for each response.
         """
         try:
-            db = Database()
-            data = self.recv_full(client_socket)
-            if not data:
+            if mask & selectors.EVENT_WRITE:
+                self.flush_send(client_socket)
+                # Requests held back while the responses were backed up
+                self.process_buffered(client_socket)
+            if not mask & selectors.EVENT_READ or client_socket not in self.recv_buffers:
+                return
+            try:
+                chunk = client_socket.recv(CHUNK_SIZE)
+            except BlockingIOError:
+                return
+            if not chunk:
                 logging.info("Client disconnected.")
                 self.disconnect_client(client_socket)
                 return
 
-            packet = RequestPacket(data)
-            logging.info(f"Received data from {packet.client_id}")
-            db.update_last_seen(packet.client_id)
-            response_packet, message_ids = self.handler.handle_request(packet, db)
-
-            self.send_full(client_socket, response_packet.to_bytes())
-
-            if packet.code == CODE_PENDING_MESSAGES and message_ids:
-                db.delete_messages(message_ids)
-                logging.info(f"Deleted {len(message_ids)} messages for client {packet.client_id}")
+            self.recv_buffers[client_socket].extend(chunk)
+            self.process_buffered(client_socket)
 
         except Exception as e:
             logging.error(f"Error handling client: {e}")
             self.disconnect_client(client_socket)
 
+    def process_buffered(self, client_socket):
+        """
+        Processes every complete request buffered for the client, in order.
+        Stops at a long-poll request that is held open: later requests wait until it is answered,
+        so responses keep the order of the requests. Also stops while more than MAX_PENDING_SEND bytes of
+        responses are queued for the client; the rest are processed as the socket drains.
+        """
+        while client_socket in self.recv_buffers and client_socket not in self.waiting:
+            if len(self.send_buffers[client_socket]) > MAX_PENDING_SEND:
+                return
+            data = self.extract_request(self.recv_buffers[client_socket])
+            if data is None:
+                return
+            self.process_request(client_socket, data)
+
+    def process_request(self, client_socket, data):
+        """
+        Parses a single complete request, dispatches it and sends back the response.
+        """
+        db = Database()
+        packet = RequestPacket(data)
+        logging.info(f"Received data from {packet.client_id}")
+        db.update_last_seen(packet.client_id)
+        response_packet, message_ids = self.handler.handle_request(packet, db)
+
+        if response_packet is None:
+            self.park_wait(client_socket, packet)
+        else:
+            self.queue_send(client_socket, response_packet.to_bytes())
+
+        if message_ids:
+            db.delete_messages(message_ids)
+            logging.info(f"Deleted {len(message_ids)} messages for client {packet.client_id}")
+
+        self.wake_waits(self.handler.take_new_mail())
+
+    def park_wait(self, client_socket, packet: RequestPacket):
+        """
+        Holds a long-poll request open until a message is saved for its client or its wait runs out.
+        """
+        deadline = time.monotonic() + self.handler.wait_timeout_ms(packet) / 1000
+        self.waiting[client_socket] = (packet, deadline)
+        logging.info(f"Holding wait request from {packet.client_id}")
+
+    def wake_waits(self, recipients: set[bytes]):
+        """
+        Answers the long-poll requests of the given clients, which now have messages waiting,
+        then resumes the requests buffered behind them.
+        """
+        if not recipients:
+            return
+        for client_socket, (packet, deadline) in list(self.waiting.items()):
+            # Answering one request may resume others on its socket, so skip entries that changed meanwhile
+            if packet.client_id not in recipients or self.waiting.get(client_socket, (None,))[0] is not packet:
+                continue
+            response_packet, _ = self.handler.handle_request(packet, Database())
+            if response_packet is None:
+                continue  # Already fetched on another connection, keep waiting
+            del self.waiting[client_socket]
+            self.queue_send(client_socket, response_packet.to_bytes())
+            self.process_buffered(client_socket)
+
+    def expire_waits(self):
+        """
+        Answers the long-poll requests whose wait ran out with an empty page,
+        then resumes the requests buffered behind them.
+        """
+        now = time.monotonic()
+        for client_socket, (packet, deadline) in list(self.waiting.items()):
+            if deadline > now or self.waiting.get(client_socket, (None,))[0] is not packet:
+                continue
+            del self.waiting[client_socket]
+            self.queue_send(client_socket, self.handler.wait_expired(packet).to_bytes())
+            self.process_buffered(client_socket)
+
+    def next_wait_timeout(self):
+        """
+        Returns how long the selector may block before the earliest held request expires (None if none is held).
+        """
+        if not self.waiting:
+            return None
+        return max(0.0, min(deadline for _, deadline in self.waiting.values()) - time.monotonic())
+
     def disconnect_client(self, client_socket):
         """
         Unregisters and closes the specified client socket.
         """
         try:
+            self.recv_buffers.pop(client_socket, None)
+            self.send_buffers.pop(client_socket, None)
+            self.waiting.pop(client_socket, None)
             self.selector.unregister(client_socket)
             client_socket.close()
             logging.info("Client disconnected.")
         except Exception as e:
             logging.error(f"Error disconnecting client: {e}")
 
-    def recv_full(self, client_socket):
+    @staticmethod
+    def extract_request(buffer: bytearray):
         """
-        Reads the full request from the client, including header and full payload.
-        Returns the full data as bytes if successful, otherwise None.
+        Removes one complete request (header and full payload) from the front of the buffer.
+        Returns the request as bytes with the header converted to the little endian layout
+        expected by RequestPacket, or None if the buffer does not hold a complete request yet.
         """
-        try:
-            header = client_socket.recv(CLIENT_HEADER_SIZE)
-            if not header or len(header) < CLIENT_HEADER_SIZE:
-                return None
-
-            client_id = header[:CLIENT_ID_SIZE]
-            client_version = header[CLIENT_ID_SIZE]
-            client_code = int.from_bytes(header[CLIENT_ID_SIZE + VERSION_SIZE:CLIENT_ID_SIZE + VERSION_SIZE + CODE_SIZE]
-                                         , byteorder="big")
-            payload_size = int.from_bytes(header[CLIENT_ID_SIZE + VERSION_SIZE + CODE_SIZE:CLIENT_HEADER_SIZE]
-                                          , byteorder='big')
-
-            # Convert header back to little endian format expected by struct
-            little_end_header = (client_id +
-                                 bytes([client_version]) +
-                                 client_code.to_bytes(2, byteorder="little") +
-                                 payload_size.to_bytes(4, byteorder="little")
-                                 )
-
-            data = bytearray(little_end_header)
-
-            while len(data) < CLIENT_HEADER_SIZE + payload_size:
-                chunk = client_socket.recv(CHUNK_SIZE)
-                if not chunk:
-                    break
-                data.extend(chunk)
+        if len(buffer) < CLIENT_HEADER_SIZE:
+            return None
 
-            return bytes(data) if len(data) == CLIENT_HEADER_SIZE + payload_size else None
+        client_id = bytes(buffer[:CLIENT_ID_SIZE])
+        client_version = buffer[CLIENT_ID_SIZE]
+        client_code = int.from_bytes(buffer[CLIENT_ID_SIZE + VERSION_SIZE:CLIENT_ID_SIZE + VERSION_SIZE + CODE_SIZE]
+                                     , byteorder="big")
+        payload_size = int.from_bytes(buffer[CLIENT_ID_SIZE + VERSION_SIZE + CODE_SIZE:CLIENT_HEADER_SIZE]
+                                      , byteorder='big')
 
-        except Exception as e:
-            logging.error(f"Error receiving data: {e}")
+        if len(buffer) < CLIENT_HEADER_SIZE + payload_size:
             return None
 
-    def send_full(self, client_socket, data):
+        # Convert header back to little endian format expected by struct
+        little_end_header = (client_id +
+                             bytes([client_version]) +
+                             client_code.to_bytes(2, byteorder="little") +
+                             payload_size.to_bytes(4, byteorder="little")
+                             )
+
+        payload = bytes(buffer[CLIENT_HEADER_SIZE:CLIENT_HEADER_SIZE + payload_size])
+        del buffer[:CLIENT_HEADER_SIZE + payload_size]
+        return little_end_header + payload
+
+    def queue_send(self, client_socket, data):
+        """
+        Queues `data` for the client and sends as much of it as the socket takes right away.
+        Whatever is left is flushed from the selector when the socket becomes writable, so a client
+        that does not read its responses never blocks the event loop.
         """
-        Sends the entire `data` buffer to the client.
+        buffer = self.send_buffers.get(client_socket)
+        if buffer is None:
+            return  # Disconnected while the request was handled
+        was_empty = not buffer
+        buffer.extend(data)
+        if was_empty:
+            self.flush_send(client_socket)
+
+    def flush_send(self, client_socket):
         """
+        Sends queued response bytes until the socket buffer is full, and keeps the socket registered
+        for write events exactly while bytes remain queued.
+        """
+        buffer = self.send_buffers[client_socket]
         try:
-            total_sent = 0
-            while total_sent < len(data):
-                sent = client_socket.send(data[total_sent:])
+            while buffer:
+                try:
+                    sent = client_socket.send(buffer)
+                except BlockingIOError:
+                    break
                 if sent == 0:
                     raise ConnectionError("Socket connection broken during send.")
-                total_sent += sent
-
+                del buffer[:sent]
         except Exception as e:
             logging.error(f"Error sending data: {e}")
+            self.disconnect_client(client_socket)
+            return
+
+        events = selectors.EVENT_READ | (selectors.EVENT_WRITE if buffer else 0)
+        if self.selector.get_key(client_socket).events != events:
+            self.selector.modify(client_socket, events, self.handle_client)
 
     def cleanup(self):
         """